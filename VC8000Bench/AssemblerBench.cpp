@@ -0,0 +1,265 @@
+//
+//      Assembler scaling benchmark suite.  Generates synthetic assembly sources of increasing
+//      size and times each phase of the assembler on them.
+//
+#include "stdafx.h"
+#include "Bench.h"
+#include "Assembler.h"
+
+#include <memory>
+
+// The shape of a generated source program.
+struct SourceProfile {
+    const char *name;       // The name the results are reported under.
+    int labelEvery;         // One instruction in this many carries a label.
+    int commentEvery;       // One line in this many is a comment or blank line.
+    int errorEvery;         // One line in this many has a deliberate error (0 for none).
+};
+
+// The profiles each size is generated with.
+static const SourceProfile s_profiles[] = {
+    { "sparse_labels", 16, 8, 0 },      // Few labels, the common case for generated code.
+    { "dense_labels",   1, 4, 0 },      // Every statement is labelled: stresses the symbol table.
+    { "with_errors",    4, 8, 25 },     // Frequent errors: stresses error reporting.
+};
+
+// Small deterministic random number generator, so every run sees the same sources.
+class BenchRandom {
+
+public:
+
+    // Returns a number in [0, a_limit).
+    unsigned Next(unsigned a_limit) {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (unsigned)(m_state >> 33) % a_limit;
+    }
+
+private:
+
+    unsigned long long m_state = 0x5EED;    // Current generator state.
+};
+
+/**/
+/*
+NAME
+
+        GenerateSource - writes a synthetic assembly program.
+
+SYNOPSIS
+
+        static long long GenerateSource(const string &a_path, const SourceProfile &a_profile, int a_lines);
+            a_path      --> the file to write the program to.
+            a_profile   --> the shape of the program.
+            a_lines     --> the number of lines to generate.
+
+DESCRIPTION
+
+        This function generates a program of exactly a_lines lines.  It starts with an ORG, ends with
+        an END, and in between mixes register/address and register/register instructions, constants,
+        DS blocks, further ORGs, comment lines, blank lines and trailing comments.  Labels are
+        numbered in the order they are defined.  Address operands refer either to a label already
+        defined or to the next one to be defined, so the program has both backward and forward
+        references.  The last statement before the END defines one more label so that every forward
+        reference resolves.  If the profile asks for errors, a rotating set of invalid statements is
+        mixed in.
+
+RETURNS
+
+        Returns the size of the generated file in bytes.
+
+*/
+/**/
+static long long GenerateSource(const string &a_path, const SourceProfile &a_profile, int a_lines)
+{
+    static const char *regAddrOps[] = { "load", "store", "add", "sub", "mult", "read", "write", "b", "bm", "bz", "bp" };
+    static const char *regRegOps[] = { "addr", "subr", "multr", "divr" };
+    static const char *errorLines[] = {
+        "        frob    1, L0",                // Invalid operation.
+        "        load    12, L0",               // Bad register.
+        "        store   1, nowhere",           // Undefined label.
+        "        halt    1",                    // Extra operands.
+        "        dc      abc",                  // Bad constant.
+    };
+
+    ofstream out(a_path, ios::out | ios::trunc);
+    BenchRandom rng;
+    long long loc = 100;
+    int labels = 0;         // Labels defined so far.
+    int instructions = 0;   // Statements generated so far.
+
+    out << "; Generated benchmark program: " << a_profile.name << ", " << a_lines << " lines.\n";
+    out << "        org     100\n";
+    for (int line = 2; line < a_lines - 2; line++) {
+
+        // Comment and blank lines.
+        if (line % a_profile.commentEvery == 0) {
+            if (rng.Next(4) == 0) out << "\n";
+            else out << "; Comment line " << line << " describing the code that follows.\n";
+            continue;
+        }
+
+        // Deliberate errors.
+        if (a_profile.errorEvery > 0 && line % a_profile.errorEvery == 0) {
+            out << errorLines[(line / a_profile.errorEvery) % 5] << "\n";
+            loc++;
+            continue;
+        }
+
+        // The label field.
+        string label;
+        if (instructions++ % a_profile.labelEvery == 0) label = "L" + to_string(labels++);
+        out << left << setw(7) << label << " ";
+
+        // The occasional change of origin or block of storage.
+        if (line % 5000 == 0) {
+            loc += 1000;
+            out << "org     " << loc << "\n";
+            continue;
+        }
+        if (line % 1000 == 0) {
+            int words = 1 + rng.Next(50);
+            out << "ds      " << words << "\n";
+            loc += words;
+            continue;
+        }
+
+        // An address operand: either a label already defined or the next one.
+        unsigned choice = rng.Next(16);
+        string target = "L" + to_string(labels == 0 || choice < 4 ? labels : rng.Next(labels));
+        if (choice < 11) {
+            out << setw(8) << regAddrOps[choice] << rng.Next(10) << ", " << target;
+        }
+        else if (choice < 14) {
+            out << setw(8) << regRegOps[choice - 11] << rng.Next(10) << ", " << rng.Next(10);
+        }
+        else {
+            out << "dc      " << (int)rng.Next(2'000'000) - 1'000'000;
+        }
+        if (rng.Next(3) == 0) out << "    ; trailing comment";
+        out << "\n";
+        loc++;
+    }
+    out << left << setw(7) << ("L" + to_string(labels)) << " dc      0\n";
+    out << "        end\n";
+    out << right;
+
+    long long bytes = (long long)out.tellp();
+    return bytes;
+}
+/* static long long GenerateSource(const string &a_path, const SourceProfile &a_profile, int a_lines) */
+
+// The measurements of one phase, accumulated over the iterations.
+struct PhaseMeasure {
+    string name;                // The name of the phase, as recorded by the assembler.
+    double bestUs = 0;          // Best wall time in microseconds.
+    double cpuUs = 0;           // CPU time of the best iteration in microseconds.
+    long long allocs = 0;       // Allocations made by the phase.
+    long long allocBytes = 0;   // Bytes requested by those allocations.
+
+    // Records one measurement of the phase.
+    void Record(int a_iter, const Instrument::Phase &a_phase) {
+        if (a_iter == 0 || a_phase.wallUs < bestUs) {
+            bestUs = a_phase.wallUs;
+            cpuUs = a_phase.cpuUs;
+        }
+        allocs = a_phase.allocs;
+        allocBytes = a_phase.allocBytes;
+    }
+};
+
+/**/
+/*
+NAME
+
+        RunAssemblerBench - runs the assembler scaling benchmark suite.
+
+SYNOPSIS
+
+        void RunAssemblerBench(const BenchOptions &a_opts, vector<BenchResult> &a_results);
+            a_opts      --> the options controlling the benchmark run.
+            a_results   --> the vector the results are appended to.
+
+DESCRIPTION
+
+        For each profile and each size from 1,000 lines up to the requested maximum, in powers of ten,
+        this function generates a source file and assembles it the requested number of times.  Pass I
+        (which builds the symbol table), the symbol table display, Pass II and the translation listing
+        are measured separately through the phases the assembler records with Instrument, with the
+        listings written to a discarding stream so that formatting is measured but the console is not.
+        Each iteration also runs the other two engines, each in a fresh assembler: the single pass engine,
+        measured as one phase, and the streaming engine, whose two passes are measured separately and
+        which lists to the discarding stream too.  For each phase it reports the best time, the lines per
+        second that time represents, and the number and size of the heap allocations the phase made.  The
+        generated file is removed afterwards.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void RunAssemblerBench(const BenchOptions &a_opts, vector<BenchResult> &a_results)
+{
+    for (const SourceProfile &profile : s_profiles) {
+        for (long long lines = 1000; lines <= a_opts.maxLines; lines *= 10) {
+            BenchResult res;
+            res.suite = "assembler";
+            res.name = string(profile.name) + "_" + to_string(lines);
+
+            string path = "vc8000_bench_" + res.name + ".txt";
+            long long bytes = GenerateSource(path, profile, (int)lines);
+
+            vector<PhaseMeasure> phases = {
+                { "pass1" }, { "symtab_display" }, { "pass2" }, { "translation_display" }, { "total" },
+                { "single_pass" }, { "stream_pass1" }, { "stream_pass2" }
+            };
+            for (int iter = 0; iter < a_opts.iterations; iter++) {
+                char progName[] = "VC8000Bench";
+                char *args[] = { progName, &path[0] };
+                unique_ptr<Assembler> assem(new Assembler(2, args));
+                Instrument::ClearPhases();
+                {
+                    SilenceOutput silence;
+                    PhaseTimer timer("total");
+                    assem->PassI();
+                    assem->DisplaySymbolTable();
+                    assem->PassII();
+                    assem->DisplayTranslation();
+                }
+
+                // The single pass engine, for comparison with Pass I and Pass II together.
+                assem.reset(new Assembler(2, args));
+                assem->SinglePass();
+
+                // The streaming engine, which lists and loads the translation as it goes.
+                assem.reset(new Assembler(2, args));
+                {
+                    SilenceOutput silence;
+                    assem->StreamPassI();
+                    assem->StreamPassII();
+                }
+
+                // Pick the phases out of what the assembler recorded.
+                for (const Instrument::Phase &recorded : Instrument::GetPhases()) {
+                    for (PhaseMeasure &phase : phases) {
+                        if (phase.name == recorded.name) phase.Record(iter, recorded);
+                    }
+                }
+            }
+            remove(path.c_str());
+
+            res.metrics.push_back({ "lines", (double)lines });
+            res.metrics.push_back({ "bytes", (double)bytes });
+            for (const PhaseMeasure &phase : phases) {
+                res.metrics.push_back({ phase.name + "_ms", phase.bestUs / 1e3 });
+                res.metrics.push_back({ phase.name + "_cpu_ms", phase.cpuUs / 1e3 });
+                res.metrics.push_back({ phase.name + "_lines_per_second", phase.bestUs > 0 ? lines / (phase.bestUs / 1e6) : 0 });
+                res.metrics.push_back({ phase.name + "_allocations", (double)phase.allocs });
+                res.metrics.push_back({ phase.name + "_allocated_bytes", (double)phase.allocBytes });
+            }
+            res.metrics.push_back({ "peak_rss_bytes", (double)Instrument::PeakResidentBytes() });
+            a_results.push_back(res);
+        }
+    }
+}
+/* void RunAssemblerBench(const BenchOptions &a_opts, vector<BenchResult> &a_results) */
@@ -0,0 +1,125 @@
+//
+//      Benchmark driver.  Runs the benchmark suites, prints a summary table and
+//      optionally writes the results as JSON.
+//
+#include "stdafx.h"
+#include "Bench.h"
+
+/**/
+/*
+NAME
+
+        WriteJsonReport - writes the benchmark results as JSON.
+
+SYNOPSIS
+
+        static void WriteJsonReport(ostream &a_out, const vector<BenchResult> &a_results);
+            a_out       --> the stream to write the report to.
+            a_results   --> the results of all benchmarks that were run.
+
+DESCRIPTION
+
+        This function writes one JSON object holding an array of benchmarks.  Each benchmark records
+        its suite, name, whether it completed, and each of its metrics as a number.  Names are plain
+        identifiers chosen by the suites, so no string escaping is required.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+static void WriteJsonReport(ostream &a_out, const vector<BenchResult> &a_results)
+{
+    a_out << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < a_results.size(); i++) {
+        const BenchResult &res = a_results[i];
+        a_out << (i == 0 ? "\n" : ",\n")
+            << "    {\"suite\": \"" << res.suite << "\", \"name\": \"" << res.name << "\", "
+            << "\"ok\": " << (res.ok ? "true" : "false");
+        for (const auto &metric : res.metrics) {
+            a_out << ", \"" << metric.first << "\": " << setprecision(17) << metric.second;
+        }
+        a_out << "}";
+    }
+    a_out << "\n  ]\n}\n";
+}
+/* static void WriteJsonReport(ostream &a_out, const vector<BenchResult> &a_results) */
+
+/**/
+/*
+NAME
+
+        DisplayResults - displays the benchmark results as a table.
+
+SYNOPSIS
+
+        static void DisplayResults(const vector<BenchResult> &a_results);
+            a_results   --> the results of all benchmarks that were run.
+
+DESCRIPTION
+
+        This function prints one block per benchmark, with each metric on its own line.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+static void DisplayResults(const vector<BenchResult> &a_results)
+{
+    for (const BenchResult &res : a_results) {
+        cout << res.suite << "/" << res.name << (res.ok ? "" : "  (FAILED)") << endl;
+        for (const auto &metric : res.metrics) {
+            cout << "    " << left << setw(40) << metric.first << right << fixed << setprecision(3)
+                << metric.second << defaultfloat << endl;
+        }
+    }
+}
+/* static void DisplayResults(const vector<BenchResult> &a_results) */
+
+int main(int argc, char *argv[])
+{
+    BenchOptions opts;
+
+    // Parse the command line.
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--suite" && i + 1 < argc) opts.suite = argv[++i];
+        else if (arg == "--corpus" && i + 1 < argc) opts.corpusDir = argv[++i];
+        else if (arg == "--iterations" && i + 1 < argc) opts.iterations = max(1, atoi(argv[++i]));
+        else if (arg == "--max-lines" && i + 1 < argc) opts.maxLines = max(1000, atoi(argv[++i]));
+        else if (arg == "--json" && i + 1 < argc) opts.jsonPath = argv[++i];
+        else {
+            cerr << "Usage: VC8000Bench [--suite emulator|assembler|all] [--corpus <dir>] [--iterations <n>]"
+                << " [--max-lines <n>] [--json <file>|-]" << endl;
+            return 1;
+        }
+    }
+
+    vector<BenchResult> results;
+    if (opts.suite == "emulator" || opts.suite == "all") RunEmulatorBench(opts, results);
+    if (opts.suite == "assembler" || opts.suite == "all") RunAssemblerBench(opts, results);
+
+    DisplayResults(results);
+
+    // Write the machine readable report if one was requested.
+    if (opts.jsonPath == "-") {
+        WriteJsonReport(cout, results);
+    }
+    else if (!opts.jsonPath.empty()) {
+        ofstream jsonFile(opts.jsonPath);
+        if (!jsonFile) {
+            cerr << "Could not open " << opts.jsonPath << " for the JSON report." << endl;
+            return 1;
+        }
+        WriteJsonReport(jsonFile, results);
+    }
+
+    // Report failure if any of the benchmarks did not complete.
+    for (const BenchResult &res : results) {
+        if (!res.ok) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+//
+//		Benchmark harness shared by the VC8000 benchmark suites.
+//
+#pragma once
+
+#include <chrono>
+
+// Options controlling a benchmark run.
+struct BenchOptions {
+    string suite = "all";               // The suite to run: "emulator", "assembler" or "all".
+    string corpusDir = "Programs";      // Directory holding the benchmark programs.
+    int iterations = 5;                 // Number of timed iterations of each benchmark.
+    int maxLines = 100'000;             // Largest generated source for the assembler suite.
+    string jsonPath;                    // Where to write the JSON report ("-" is stdout, empty is none).
+};
+
+// The measurements taken for one benchmark.
+struct BenchResult {
+    string suite;                               // The suite the benchmark belongs to.
+    string name;                                // The name of the benchmark.
+    bool ok = true;                             // == true if every iteration completed without errors.
+    vector<pair<string, double>> metrics;       // Metric name and value, in reporting order.
+};
+
+// Wall clock stopwatch used to time a single phase.
+class BenchTimer {
+
+public:
+
+    BenchTimer() : m_start(chrono::steady_clock::now()) {}
+
+    // Returns the seconds elapsed since the timer was constructed.
+    double Seconds() const {
+        return chrono::duration<double>(chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+
+    chrono::steady_clock::time_point m_start;   // When the timer was started.
+};
+
+// Discards everything written to cout for as long as it is in scope.  The programs being
+// measured write their listings and output through cout, and we do not want to time the console.
+class SilenceOutput {
+
+public:
+
+    SilenceOutput() : m_saved(cout.rdbuf(&m_null)) {}
+    ~SilenceOutput() { cout.rdbuf(m_saved); }
+
+private:
+
+    // Stream buffer that accepts and drops every character.
+    class NullBuffer : public streambuf {
+    protected:
+        int overflow(int a_c) override { return a_c; }
+        streamsize xsputn(const char *, streamsize a_n) override { return a_n; }
+    };
+
+    NullBuffer m_null;          // The buffer cout writes into while silenced.
+    streambuf *m_saved;         // The buffer cout wrote into before.
+};
+
+// Runs the emulator benchmark suite and appends its results.
+void RunEmulatorBench(const BenchOptions &a_opts, vector<BenchResult> &a_results);
+
+// Runs the assembler scaling benchmark suite and appends its results.
+void RunAssemblerBench(const BenchOptions &a_opts, vector<BenchResult> &a_results);
@@ -0,0 +1,149 @@
+//
+//      Emulator benchmark suite.  Assembles each program of the corpus once and then
+//      times loading and executing it in a fresh emulator.
+//
+#include "stdafx.h"
+#include "Bench.h"
+#include "Assembler.h"
+
+#include <memory>
+
+// A program in the emulator benchmark corpus.
+struct EmulatorProgram {
+    const char *name;       // The name the results are reported under.
+    const char *file;       // The source file, relative to the corpus directory.
+    int inputValues;        // The number of values the program reads from its input.
+};
+
+// The corpus.  Each program exercises a different part of the engine.
+static const EmulatorProgram s_corpus[] = {
+    { "arith_loop",   "arith_loop.txt",   0 },          // Tight register and memory arithmetic loop.
+    { "memory_walk",  "memory_walk.txt",  0 },          // Walks memory by rewriting its own address field.
+    { "branch_heavy", "branch_heavy.txt", 0 },          // Data dependent branches (Collatz sequences).
+    { "io_heavy",     "io_heavy.txt",     200'000 },    // Mostly READ and WRITE.
+};
+
+/**/
+/*
+NAME
+
+        RunEmulatorBench - runs the emulator benchmark suite.
+
+SYNOPSIS
+
+        void RunEmulatorBench(const BenchOptions &a_opts, vector<BenchResult> &a_results);
+            a_opts      --> the options controlling the benchmark run.
+            a_results   --> the vector the results are appended to.
+
+DESCRIPTION
+
+        This function assembles each program of the corpus with its listing output discarded. It then
+        runs the program the requested number of times, each time in a newly constructed emulator so
+        that every run starts from clean memory.  Loading and execution are timed separately.  The
+        console input and output of the program are redirected to memory so that I/O bound programs
+        measure the emulator rather than the terminal.
+
+        The best iteration is reported, along with the mean execution time, since the best time is
+        the least disturbed by the rest of the system.  If VC8000_PERF_COUNTERS is set, the hardware
+        counters of the best execution are reported too, including host cycles per VC8000 instruction.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void RunEmulatorBench(const BenchOptions &a_opts, vector<BenchResult> &a_results)
+{
+    for (const EmulatorProgram &prog : s_corpus) {
+        BenchResult res;
+        res.suite = "emulator";
+        res.name = prog.name;
+
+        // Assemble the program.  The translation listing is not of interest here.
+        string path = a_opts.corpusDir + "/" + prog.file;
+        char progName[] = "VC8000Bench";
+        char *args[] = { progName, &path[0] };
+        Assembler assem(2, args);
+        {
+            SilenceOutput silence;
+            assem.PassI();
+            assem.PassII();
+        }
+
+        // Prepare the input the program will read.
+        string inputText;
+        for (int i = 0; i < prog.inputValues; i++) inputText += to_string(i % 1000) + "\n";
+
+        double bestLoad = 0, bestExec = 0, totalExec = 0;
+        long long instructions = 0;
+        long long bestCounters[PerfCounters::EV_Count] = { -1, -1, -1, -1, -1 };
+        for (int iter = 0; iter < a_opts.iterations; iter++) {
+
+            // A fresh emulator for every run.  Constructing it is not part of the measurement.
+            unique_ptr<emulator> emul(new emulator);
+
+            istringstream input(inputText);
+            streambuf *savedInput = cin.rdbuf(input.rdbuf());
+            cin.clear();
+
+            double loadTime, execTime;
+            bool success;
+            PerfCounters counters;
+            {
+                SilenceOutput silence;
+
+                BenchTimer loadTimer;
+                success = emul->loadProgram(assem.GetTranslation());
+                loadTime = loadTimer.Seconds();
+
+                bool counting = Instrument::CountersEnabled() && counters.Start();
+                BenchTimer execTimer;
+                success = success && emul->executeProgram();
+                execTime = execTimer.Seconds();
+                if (counting) counters.Stop();
+            }
+            cin.rdbuf(savedInput);
+            cin.clear();
+
+            if (!success) {
+                cerr << prog.name << ": program did not terminate successfully:" << endl;
+                emul->getDiagnostics().Display(cout);
+                res.ok = false;
+                break;
+            }
+            instructions = emul->getInstructionCount();
+            if (iter == 0 || loadTime < bestLoad) bestLoad = loadTime;
+            if (iter == 0 || execTime < bestExec) {
+                bestExec = execTime;
+                for (int ev = 0; ev < PerfCounters::EV_Count; ev++) {
+                    bestCounters[ev] = counters.Get((PerfCounters::Event)ev);
+                }
+            }
+            totalExec += execTime;
+        }
+
+        res.metrics.push_back({ "instructions", (double)instructions });
+        res.metrics.push_back({ "load_ms", bestLoad * 1e3 });
+        res.metrics.push_back({ "exec_ms", bestExec * 1e3 });
+        res.metrics.push_back({ "exec_mean_ms", totalExec * 1e3 / a_opts.iterations });
+        res.metrics.push_back({ "instructions_per_second", bestExec > 0 ? instructions / bestExec : 0 });
+        res.metrics.push_back({ "mips", bestExec > 0 ? instructions / bestExec / 1e6 : 0 });
+        res.metrics.push_back({ "ns_per_instruction", instructions > 0 ? bestExec * 1e9 / instructions : 0 });
+        for (int ev = 0; ev < PerfCounters::EV_Count; ev++) {
+            if (bestCounters[ev] < 0) continue;
+            res.metrics.push_back({ PerfCounters::Name((PerfCounters::Event)ev), (double)bestCounters[ev] });
+        }
+        if (instructions > 0 && bestCounters[PerfCounters::EV_Cycles] >= 0) {
+            res.metrics.push_back({ "host_cycles_per_instruction",
+                (double)bestCounters[PerfCounters::EV_Cycles] / instructions });
+        }
+        if (instructions > 0 && bestCounters[PerfCounters::EV_Instructions] >= 0) {
+            res.metrics.push_back({ "host_instructions_per_instruction",
+                (double)bestCounters[PerfCounters::EV_Instructions] / instructions });
+        }
+        res.metrics.push_back({ "peak_rss_bytes", (double)Instrument::PeakResidentBytes() });
+        a_results.push_back(res);
+    }
+}
+/* void RunEmulatorBench(const BenchOptions &a_opts, vector<BenchResult> &a_results) */
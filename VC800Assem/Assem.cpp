@@ -1,34 +1,770 @@
 /*
  * Assembler main program.
  */
-#include "stdafx.h"     // This must be present if you use precompiled headers which you will use. 
+#include "stdafx.h"     // This must be present if you use precompiled headers which you will use.
 #include <stdio.h>
 
+#include <filesystem>
+#include <functional>
+
 #include "Assembler.h"
+#include "ObjectFile.h"
+#include "Linker.h"
+#include "AssemblyCache.h"
+#include "FileWatcher.h"
+#include "Server.h"
 
-int main( int argc, char *argv[] )
+// What the command line asks for.
+struct AssemOptions {
+    vector<string> sources;         // The source files, directories and manifests named.
+    string sourcePath;              // The source file to assemble, or "-" for standard input.
+    string runPath;                 // The object file to run instead of assembling, if any.
+    string objectPath;              // The object file to write the assembled program to, if any.
+    string listingPath;             // The file to write the translation listing to, or empty for standard output.
+    string symbolsPath;             // The file to write the symbol table to, or empty for standard output.
+    string engine;                  // The engine that assembles: "passes", "single" or "stream".
+    bool assembleOnly = false;      // == true if the program is not run.
+    bool listTranslation = true;    // == true if the translation is listed.
+    bool listSymbols = true;        // == true if the symbol table is listed.
+    bool quiet = false;             // == true if nothing but the program's output and errors is shown.
+    bool batch = false;             // == true if the user is never waited for.
+    bool compile = false;           // == true if each source is assembled as a module to be linked.
+    bool link = false;              // == true if the files named are object files to link rather than sources.
+    bool watch = false;             // == true if the source is assembled again each time it changes.
+    string outDir;                  // The directory the files of a batch are written to, or empty for beside each source.
+    unsigned jobs = 0;              // The number of programs of a batch assembled at once, or 0 for the default.
+    string cacheDir;                // The directory of the assembly cache, or empty for none.
+    long long cacheSize = 0;        // The most megabytes the cache holds, or 0 for the default.
+    string servePath;               // The socket to serve jobs on, or empty to assemble the files named.
+    long long maxInstructions = AssemblyServer::DefaultInstructions;    // The most a served program executes.
+    long long maxOutput = AssemblyServer::DefaultOutput;                // The most bytes a served program writes.
+};
+
+// One program of a batch, and how assembling it went.
+struct BatchJob {
+    string sourcePath;              // The source file.
+    string outputBase;              // The path of its output files, without their extension.
+    string failure;                 // Why the program could not be assembled, or empty if it was.
+    size_t errors = 0;              // The number of errors found in the program.
+    bool cached = false;            // == true if its files were written from the assembly cache.
+};
+
+// Displays how the assembler is used.
+static void DisplayUsage( )
+{
+    cerr << "Usage: Assem [options] <source file>\n"
+        << "       Assem [options] --run <object file>\n"
+        << "       Assem [options] <source file | directory | @manifest>...\n"
+        << "       Assem [options] --link <object file>...\n"
+        << "       Assem [options] --serve <socket>\n"
+        << "  -a, --assemble-only      assemble without running the program\n"
+        << "  -r, --run <file>         run the program in an object file without assembling\n"
+        << "  -o, --output <file>      write the assembled program to an object file\n"
+        << "  -l, --listing <file>     write the translation listing to a file\n"
+        << "      --no-listing         do not list the translation\n"
+        << "      --symbols <file>     write the symbol table to a file\n"
+        << "      --no-symbols         do not list the symbol table\n"
+        << "  -q, --quiet              show only the program's output and errors\n"
+        << "  -b, --batch              never pause between phases\n"
+        << "  -e, --engine <name>      passes (the default), single or stream\n"
+        << "  -c, --compile            assemble modules to be linked, without running them\n"
+        << "  -k, --link               link modules and object files into one program, and run it\n"
+        << "  -w, --watch              assemble the source again, in part, each time it changes\n"
+        << "  -d, --out-dir <dir>      write the files of a batch to a directory\n"
+        << "  -j, --jobs <n>           assemble up to n programs of a batch at once\n"
+        << "      --cache <dir>        reuse what unchanged sources assembled to, kept in a directory\n"
+        << "      --cache-size <mb>    keep the cache to this many megabytes (256 by default)\n"
+        << "      --serve <socket>     assemble and run the jobs sent to a Unix domain socket, -j at once\n"
+        << "      --max-instructions <n>   stop a served program after n instructions (0 for no limit)\n"
+        << "      --max-output <bytes>     stop a served program that writes more than this (0 for no limit)\n"
+        << "A file name of - means standard input or output.  Several sources, a directory of .txt and .asm\n"
+        << "files or a manifest listing one source per line assemble a batch: each program gets an object\n"
+        << "file, a listing and a symbol table beside it, and none is run.  The cache serves batches and quiet\n"
+        << "runs that only assemble.  A server takes jobs as Server.h describes, and stops a program after\n"
+        << "100,000,000 instructions or 1 MB of output unless told otherwise." << endl;
+}
+
+/**/
+/*
+NAME
+
+        ParseOptions - reads the command line.
+
+SYNOPSIS
+
+        static bool ParseOptions( int argc, char *argv[], AssemOptions &a_opts );
+            argc        --> the number of arguments passed into the main function.
+            argv        --> the arguments passed into the main function.
+            a_opts      --> set to what the command line asks for.
+
+DESCRIPTION
+
+        An argument that starts with '-', other than "-" alone, is an option; the one other argument is the
+        source file, unless there are several or it is a directory or a manifest, which are a batch.  Run as
+        "Assem <FileName>", the assembler behaves as it always has.  The engine is taken from the
+        VC8000_ENGINE environment variable unless it is given, and the cache directory and its size from
+        VC8000_CACHE and VC8000_CACHE_SIZE.  A server takes no files, since its sources are sent to it.
+
+RETURNS
+
+        Returns false if the command line is not valid, after saying why on cerr.
+
+*/
+/**/
+static bool ParseOptions( int argc, char *argv[], AssemOptions &a_opts )
 {
-    Assembler assem( argc, argv );
+    a_opts.engine = Instrument::GetEnvironment( "VC8000_ENGINE" );
+    if( a_opts.engine.empty() ) a_opts.engine = "passes";
+    a_opts.cacheDir = Instrument::GetEnvironment( "VC8000_CACHE" );
+    a_opts.cacheSize = max( 0, atoi( Instrument::GetEnvironment( "VC8000_CACHE_SIZE" ).c_str() ) );
 
-    // Establish the location of the labels:
-    assem.PassI( );
+    for( int i = 1; i < argc; i++ ) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
 
-    // Display the symbol table.
-    assem.DisplaySymbolTable();
+        if( arg == "-a" || arg == "--assemble-only" ) a_opts.assembleOnly = true;
+        else if( ( arg == "-r" || arg == "--run" ) && hasValue ) a_opts.runPath = argv[++i];
+        else if( ( arg == "-o" || arg == "--output" ) && hasValue ) a_opts.objectPath = argv[++i];
+        else if( ( arg == "-l" || arg == "--listing" ) && hasValue ) a_opts.listingPath = argv[++i];
+        else if( arg == "--no-listing" ) a_opts.listTranslation = false;
+        else if( arg == "--symbols" && hasValue ) a_opts.symbolsPath = argv[++i];
+        else if( arg == "--no-symbols" ) a_opts.listSymbols = false;
+        else if( arg == "-q" || arg == "--quiet" ) a_opts.quiet = true;
+        else if( arg == "-b" || arg == "--batch" ) a_opts.batch = true;
+        else if( ( arg == "-e" || arg == "--engine" ) && hasValue ) a_opts.engine = argv[++i];
+        else if( arg == "-c" || arg == "--compile" ) a_opts.compile = true;
+        else if( arg == "-k" || arg == "--link" ) a_opts.link = true;
+        else if( arg == "-w" || arg == "--watch" ) a_opts.watch = true;
+        else if( ( arg == "-d" || arg == "--out-dir" ) && hasValue ) a_opts.outDir = argv[++i];
+        else if( ( arg == "-j" || arg == "--jobs" ) && hasValue ) a_opts.jobs = (unsigned)max( 0, atoi( argv[++i] ) );
+        else if( arg == "--cache" && hasValue ) a_opts.cacheDir = argv[++i];
+        else if( arg == "--cache-size" && hasValue ) a_opts.cacheSize = max( 0, atoi( argv[++i] ) );
+        else if( arg == "--serve" && hasValue ) a_opts.servePath = argv[++i];
+        else if( arg == "--max-instructions" && hasValue ) a_opts.maxInstructions = max( 0LL, atoll( argv[++i] ) );
+        else if( arg == "--max-output" && hasValue ) a_opts.maxOutput = max( 0LL, atoll( argv[++i] ) );
+        else if( arg.size() > 1 && arg[0] == '-' ) {
+            cerr << "Unknown option or missing value: " << arg << endl;
+            return false;
+        }
+        else a_opts.sources.push_back( arg );
+    }
+    if( a_opts.sources.size() == 1 && a_opts.sources[0][0] != '@'
+        && !std::filesystem::is_directory( a_opts.sources[0] ) ) {
+        a_opts.sourcePath = a_opts.sources[0];
+    }
 
-    // Buffer between PassI and PassII.
-    assem.InterPass();
+    if( a_opts.engine != "passes" && a_opts.engine != "single" && a_opts.engine != "stream" ) {
+        cerr << "Unknown engine: " << a_opts.engine << endl;
+        return false;
+    }
+    if( !a_opts.servePath.empty() ) {
+        if( !a_opts.sources.empty() || !a_opts.runPath.empty() ) {
+            cerr << "A server assembles the sources sent to it, not those named." << endl;
+            return false;
+        }
+        return true;
+    }
+    if( a_opts.runPath.empty() == a_opts.sources.empty() ) {
+        cerr << "Give either a source file to assemble or an object file to run." << endl;
+        return false;
+    }
+    if( !a_opts.runPath.empty() && ( a_opts.assembleOnly || a_opts.compile || a_opts.link ) ) {
+        cerr << "An object file cannot be assembled." << endl;
+        return false;
+    }
+    if( a_opts.link ) {
+        if( a_opts.compile ) {
+            cerr << "Modules are compiled and linked in separate runs." << endl;
+            return false;
+        }
+        a_opts.sourcePath.clear();
+        return true;
+    }
+    if( a_opts.watch ) {
+        if( a_opts.sourcePath.empty() || a_opts.sourcePath == "-" ) {
+            cerr << "Watch mode watches one source file." << endl;
+            return false;
+        }
+        if( a_opts.engine != "passes" ) {
+            cerr << "Watch mode keeps what Pass I and Pass II found, so it needs the passes engine." << endl;
+            return false;
+        }
+        a_opts.assembleOnly = true;
+    }
+    if( a_opts.compile ) {
+        a_opts.assembleOnly = true;
+        if( a_opts.sourcePath == "-" && a_opts.objectPath.empty() ) {
+            cerr << "Name the object file of a module read from standard input." << endl;
+            return false;
+        }
+        if( !a_opts.sourcePath.empty() && a_opts.objectPath.empty() ) {
+            a_opts.objectPath = std::filesystem::path( a_opts.sourcePath ).replace_extension( ".obj" ).string();
+        }
+    }
+    if( a_opts.sourcePath.empty() && !a_opts.sources.empty() ) {
+        if( !a_opts.objectPath.empty() || !a_opts.listingPath.empty() || !a_opts.symbolsPath.empty() ) {
+            cerr << "The files of a batch are named after its sources; use --out-dir to place them." << endl;
+            return false;
+        }
+        a_opts.assembleOnly = true;
+    }
+    return true;
+}
+/* static bool ParseOptions( int argc, char *argv[], AssemOptions &a_opts ) */
 
-    // Output the translation.
-    assem.PassII( );
+// Runs the program in a memory image, as the emulator runs a program it has assembled, and returns the
+// exit status.
+static int RunImage( MemoryImage &a_image, const AssemOptions &a_opts )
+{
+    emulator emul;
+    bool success = emul.adoptImage( a_image ) && emul.runLoadedProgram();
+    if( !success ) emul.getDiagnostics().Display( cout );
+    else if( !a_opts.quiet ) cout << "Program terminated successfully.";
 
-    // Buffer between PassII and Emulation.
-    assem.InterPass();
-    
-    // Run the emulator on the translation of the assembler language program that was generated in Pass II.
-    assem.RunProgramInEmulator();
-   
-    // Terminate indicating all is well.  If there is an unrecoverable error, the 
-    // program will terminate at the point that it occurred with an exit(1) call.
+    Instrument::WriteReportsFromEnvironment();
     return 0;
 }
+
+/**/
+/*
+NAME
+
+        RunObjectFile - runs the program in an object file.
+
+SYNOPSIS
+
+        static int RunObjectFile( const AssemOptions &a_opts );
+            a_opts      --> what the command line asks for.
+
+DESCRIPTION
+
+        The object file is read into a memory image, which the emulator loads and runs, just as it
+        runs a program it has assembled.
+
+RETURNS
+
+        Returns the exit status: 1 if the object file could not be read, and 0 otherwise.
+
+*/
+/**/
+static int RunObjectFile( const AssemOptions &a_opts )
+{
+    MemoryImage image;
+    {
+        PhaseTimer timer( "object_read" );
+        if( !ObjectFile::Read( a_opts.runPath, image ) ) return 1;
+    }
+    return RunImage( image, a_opts );
+}
+/* static int RunObjectFile( const AssemOptions &a_opts ) */
+
+/**/
+/*
+NAME
+
+        LinkObjectFiles - links modules into one program.
+
+SYNOPSIS
+
+        static int LinkObjectFiles( const AssemOptions &a_opts );
+            a_opts      --> what the command line asks for.
+
+DESCRIPTION
+
+        Each file named is a module, or a plain object file, which is linked as a module that stays where
+        it is.  The program the linker builds is written to the object file asked for, if any, and then run
+        unless it is only to be assembled.
+
+RETURNS
+
+        Returns the exit status: 1 if the modules could not be read or linked, or the program could not be
+        written, and 0 otherwise.
+
+*/
+/**/
+static int LinkObjectFiles( const AssemOptions &a_opts )
+{
+    Linker linker;
+    MemoryImage image;
+    {
+        PhaseTimer timer( "link" );
+        for( const string &path : a_opts.sources ) {
+            if( !linker.AddModule( path ) ) return 1;
+        }
+        if( !linker.Link( image ) ) return 1;
+    }
+
+    if( !a_opts.objectPath.empty() ) {
+        PhaseTimer timer( "object_write" );
+        if( !ObjectFile::Write( a_opts.objectPath, image ) ) {
+            cerr << "Could not write the object file " << a_opts.objectPath << endl;
+            return 1;
+        }
+    }
+    if( a_opts.assembleOnly ) {
+        Instrument::WriteReportsFromEnvironment();
+        return 0;
+    }
+    return RunImage( image, a_opts );
+}
+/* static int LinkObjectFiles( const AssemOptions &a_opts ) */
+
+/**/
+/*
+NAME
+
+        Assemble - assembles a program with the engine asked for.
+
+SYNOPSIS
+
+        static void Assemble( Assembler &a_assem, const string &a_engine, const function<void()> &a_interPass );
+            a_assem     --> the assembler, set up with its source and listings.
+            a_engine    --> the engine: "passes", "single" or "stream".
+            a_interPass --> separates the symbol table from the translation.
+
+DESCRIPTION
+
+        The single pass engine and the streaming one, which holds only a batch of the translation at a
+        time, give the same output as the default.  Either way the symbol table and the translation are
+        listed, and the program is left in the memory image.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+static void Assemble( Assembler &a_assem, const string &a_engine, const function<void()> &a_interPass )
+{
+    if( a_engine == "single" ) {
+
+        // Establish the location of the labels and translate the program together.
+        a_assem.SinglePass( );
+        a_assem.DisplaySymbolTable();
+        a_interPass();
+        a_assem.DisplayTranslation( );
+    }
+    else if( a_engine == "stream" ) {
+
+        // Establish the location of the labels, then translate, list and store the program a batch at a time.
+        a_assem.StreamPassI( );
+        a_assem.DisplaySymbolTable();
+        a_interPass();
+        a_assem.StreamPassII( );
+    }
+    else {
+
+        // Establish the location of the labels:
+        a_assem.PassI( );
+
+        // Display the symbol table.
+        a_assem.DisplaySymbolTable();
+
+        // Buffer between PassI and PassII.
+        a_interPass();
+
+        // Translate the program and display the translation.
+        a_assem.PassII( );
+        a_assem.DisplayTranslation( );
+    }
+}
+/* static void Assemble( Assembler &a_assem, const string &a_engine, const function<void()> &a_interPass ) */
+
+// The files of an assembly that the cache keeps: the extension each has in a cache entry, and its path.
+typedef vector<pair<string, string>> CachedFiles;
+
+// Opens the cache the command line asks for, if any.  A directory that cannot be made is reported on cerr,
+// and the run goes on without it.
+static unique_ptr<AssemblyCache> OpenCache( const AssemOptions &a_opts )
+{
+    if( a_opts.cacheDir.empty() ) return nullptr;
+    long long capacity = a_opts.cacheSize > 0 ? a_opts.cacheSize << 20 : AssemblyCache::DefaultCapacity;
+    unique_ptr<AssemblyCache> cache( new AssemblyCache( a_opts.cacheDir, capacity ) );
+    if( cache->IsOpen() ) return cache;
+    cerr << "The cache directory " << a_opts.cacheDir << " could not be made, so it is not used." << endl;
+    return nullptr;
+}
+
+// Makes the key of a source file in the cache, or an empty key if the file cannot be read.  Which files
+// are kept is part of the key, and so is the path of the source if the diagnostics, which name it, are.
+static string MakeCacheKey( const string &a_path, const AssemOptions &a_opts, const CachedFiles &a_files )
+{
+    string source;
+    if( !AssemblyCache::ReadFile( a_path, source ) ) return "";
+
+    string options = "engine=" + a_opts.engine + " module=" + to_string( a_opts.compile )
+        + " max-errors=" + to_string( Diagnostics::GetMaxErrors() ) + " files=";
+    for( const auto &file : a_files ) {
+        options += file.first + ",";
+        if( file.first == "json" ) options += "source=" + a_path + ",";
+    }
+    return AssemblyCache::MakeKey( source, options );
+}
+
+// Writes the files of a source from the cache.  Returns false if the source is not there or a file could
+// not be written, so that the source is assembled after all.
+static bool WriteFromCache( const AssemblyCache &a_cache, const string &a_key, const CachedFiles &a_files,
+    size_t &a_errors )
+{
+    AssemblyCache::Entry entry;
+    if( !a_cache.Lookup( a_key, entry ) ) return false;
+    for( const auto &file : a_files ) {
+        if( entry.files.count( file.first ) == 0 ) return false;
+    }
+    for( const auto &file : a_files ) {
+        if( !AssemblyCache::WriteFile( file.second, entry.files[file.first] ) ) return false;
+    }
+    a_errors = entry.errors;
+    return true;
+}
+
+// Keeps the files a source was assembled to in the cache, reading them back from where they were written.
+static void StoreInCache( AssemblyCache &a_cache, const string &a_key, const CachedFiles &a_files,
+    size_t a_errors )
+{
+    AssemblyCache::Entry entry;
+    entry.errors = a_errors;
+    for( const auto &file : a_files ) {
+        if( !AssemblyCache::ReadFile( file.second, entry.files[file.first] ) ) return;
+    }
+    a_cache.Store( a_key, entry );
+}
+
+/**/
+/*
+NAME
+
+        FindBatchSources - lists the source files of a batch.
+
+SYNOPSIS
+
+        static bool FindBatchSources( const AssemOptions &a_opts, vector<BatchJob> &a_jobs );
+            a_opts      --> what the command line asks for.
+            a_jobs      --> set to a job for each source file, in order.
+
+DESCRIPTION
+
+        Each source named on the command line is a file, a directory, whose .txt and .asm files are taken in
+        order of name, or, after an '@', a manifest, which names a source file on each line.  Blank lines and
+        lines starting with '#' in a manifest are skipped.  The output files of a source are named after it,
+        beside it or in the output directory.
+
+RETURNS
+
+        Returns false if a directory or manifest could not be read, after saying so on cerr.
+
+*/
+/**/
+static bool FindBatchSources( const AssemOptions &a_opts, vector<BatchJob> &a_jobs )
+{
+    namespace fs = std::filesystem;
+    vector<string> paths;
+
+    for( const string &source : a_opts.sources ) {
+        error_code error;
+        if( source[0] == '@' ) {
+            ifstream manifest( source.substr( 1 ) );
+            if( !manifest ) {
+                cerr << "Manifest " << source.substr( 1 ) << " could not be opened." << endl;
+                return false;
+            }
+            string line;
+            while( getline( manifest, line ) ) {
+                size_t first = line.find_first_not_of( " \t\r" );
+                if( first == string::npos || line[first] == '#' ) continue;
+                paths.push_back( line.substr( first, line.find_last_not_of( " \t\r" ) + 1 - first ) );
+            }
+        }
+        else if( fs::is_directory( source, error ) ) {
+            vector<string> files;
+            for( const fs::directory_entry &entry : fs::directory_iterator( source, error ) ) {
+                string extension = entry.path().extension().string();
+                if( entry.is_regular_file( error ) && ( extension == ".txt" || extension == ".asm" ) ) {
+                    files.push_back( entry.path().string() );
+                }
+            }
+            if( error ) {
+                cerr << "Directory " << source << " could not be read." << endl;
+                return false;
+            }
+            sort( files.begin(), files.end() );
+            paths.insert( paths.end(), files.begin(), files.end() );
+        }
+        else paths.push_back( source );
+    }
+
+    for( const string &path : paths ) {
+        fs::path base = fs::path( path ).replace_extension();
+        if( !a_opts.outDir.empty() ) base = fs::path( a_opts.outDir ) / base.filename();
+        BatchJob job;
+        job.sourcePath = path;
+        job.outputBase = base.string();
+        a_jobs.push_back( job );
+    }
+    return true;
+}
+/* static bool FindBatchSources( const AssemOptions &a_opts, vector<BatchJob> &a_jobs ) */
+
+/**/
+/*
+NAME
+
+        AssembleBatch - assembles many programs at once.
+
+SYNOPSIS
+
+        static int AssembleBatch( const AssemOptions &a_opts, AssemblyCache *a_cache );
+            a_opts      --> what the command line asks for.
+            a_cache     --> the assembly cache, or null if there is none.
+
+DESCRIPTION
+
+        Each program gets an assembler of its own, and so its own symbol table, translation and diagnostics,
+        and the programs are assembled on the threads of a pool, as many at once as there are threads.  The
+        passes of each program run on the thread that has it.  For each program an object file is written,
+        with its listing and symbol table unless they are turned off, even in quiet mode, and no emulator
+        is made, since none is run.  A line for each program saying how it went is displayed once they are
+        all done, in the order they were named; in quiet mode only those with problems are.  A program whose
+        source is in the cache has its files written from there, and is not assembled.
+
+RETURNS
+
+        Returns the exit status: 0 if every program was assembled without errors, and 1 otherwise.
+
+*/
+/**/
+static int AssembleBatch( const AssemOptions &a_opts, AssemblyCache *a_cache )
+{
+    vector<BatchJob> jobs;
+    if( !FindBatchSources( a_opts, jobs ) ) return 1;
+
+    if( !a_opts.outDir.empty() ) {
+        error_code error;
+        std::filesystem::create_directories( a_opts.outDir, error );
+    }
+
+    // Assemble each program on its own.
+    auto assembleJob = [&a_opts, &jobs, a_cache]( size_t a_job, unsigned ) {
+        BatchJob &job = jobs[a_job];
+        CachedFiles files{ { "obj", job.outputBase + ".obj" } };
+        if( a_opts.listSymbols ) files.push_back( { "sym", job.outputBase + ".sym" } );
+        if( a_opts.listTranslation ) files.push_back( { "lst", job.outputBase + ".lst" } );
+        string key = a_cache != nullptr ? MakeCacheKey( job.sourcePath, a_opts, files ) : "";
+        if( !key.empty() && WriteFromCache( *a_cache, key, files, job.errors ) ) {
+            job.cached = true;
+            return;
+        }
+
+        bool opened;
+        unique_ptr<Assembler> assem( new Assembler( job.sourcePath, opened ) );
+        if( !opened ) {
+            job.failure = "source file could not be opened";
+            return;
+        }
+        assem->SetBatch( true );
+        assem->SetModule( a_opts.compile );
+        assem->SetSymbolTableListing( a_opts.listSymbols, job.outputBase + ".sym" );
+        assem->SetTranslationListing( a_opts.listTranslation, job.outputBase + ".lst" );
+        Assemble( *assem, a_opts.engine, [] {} );
+        if( !assem->WriteObjectFile( job.outputBase + ".obj" ) ) job.failure = "object file not written";
+        job.errors = assem->GetErrorCount();
+        if( !key.empty() && job.failure.empty() ) StoreInCache( *a_cache, key, files, job.errors );
+    };
+    {
+        PhaseTimer timer( "batch" );
+        if( a_opts.jobs == 0 ) ThreadPool::Shared().ParallelFor( jobs.size(), assembleJob );
+        else ThreadPool( a_opts.jobs ).ParallelFor( jobs.size(), assembleJob );
+        if( a_cache != nullptr ) a_cache->Trim();
+    }
+
+    // Say how each went.
+    size_t failed = 0, withErrors = 0, cached = 0;
+    for( const BatchJob &job : jobs ) {
+        if( job.cached ) cached++;
+        if( !job.failure.empty() ) {
+            failed++;
+            cout << job.sourcePath << ": " << job.failure << "\n";
+        }
+        else if( job.errors > 0 ) {
+            withErrors++;
+            cout << job.sourcePath << ": " << job.errors << ( job.errors == 1 ? " error\n" : " errors\n" );
+        }
+        else if( !a_opts.quiet ) cout << job.sourcePath << ": ok\n";
+    }
+    if( !a_opts.quiet ) {
+        cout << "Assembled " << jobs.size() << " programs: " << withErrors << " with errors, " << failed
+            << " could not be assembled";
+        if( a_cache != nullptr ) cout << ", " << cached << " from the cache";
+        cout << ".\n";
+    }
+    cout.flush();
+
+    Instrument::WriteReportsFromEnvironment();
+    return ( failed == 0 && withErrors == 0 ) ? 0 : 1;
+}
+/* static int AssembleBatch( const AssemOptions &a_opts, AssemblyCache *a_cache ) */
+
+/**/
+/*
+NAME
+
+        WatchSource - assembles the source again each time it changes.
+
+SYNOPSIS
+
+        static int WatchSource( Assembler &a_assem, FileWatcher &a_watcher, const AssemOptions &a_opts );
+            a_assem     --> the assembler, which has assembled the source with the passes engine.
+            a_watcher   --> the watcher of the source, started before it was first assembled.
+            a_opts      --> what the command line asks for.
+
+DESCRIPTION
+
+        Each time the source is saved, the assembler reassembles only what the change affects and lists
+        it, and the object file and diagnostics are written again if they were asked for.  A line saying
+        how much was translated again, how many errors the program has and how long it took follows each
+        change, even in quiet mode, since it is what is being watched for.  The reports asked for describe
+        the last change alone, since the phases of the one before are dropped, so that a long session does
+        not grow.  This runs until the assembler is stopped.  The source is watched from before it was first
+        assembled, so that a save made while it was being assembled is not missed.
+
+RETURNS
+
+        Returns the exit status, 1, if the source can no longer be watched.
+
+*/
+/**/
+static int WatchSource( Assembler &a_assem, FileWatcher &a_watcher, const AssemOptions &a_opts )
+{
+    if( !a_watcher.IsWatching() ) {
+        cerr << "Could not watch " << a_opts.sourcePath << endl;
+        return 1;
+    }
+    if( !a_opts.quiet ) cout << "Watching " << a_opts.sourcePath << " for changes." << endl;
+
+    while( a_watcher.WaitForChange() ) {
+
+        // The phases of the assembly before have been reported, so they are dropped.
+        Instrument::ClearPhases();
+        double start = Instrument::ElapsedUs();
+        Assembler::Reassembly change;
+        if( !a_assem.Reassemble( change ) ) {
+            cerr << "Source file " << a_opts.sourcePath << " could not be read." << endl;
+            continue;
+        }
+        if( !change.changed ) continue;
+
+        if( !a_opts.quiet ) a_assem.ListChanges( change );
+        if( !a_opts.objectPath.empty() ) a_assem.WriteObjectFile( a_opts.objectPath );
+        a_assem.WriteDiagnosticsFromEnvironment();
+
+        size_t errors = a_assem.GetErrorCount();
+        cout << a_opts.sourcePath << ": " << change.translated.size() << " of "
+            << a_assem.GetTranslation().GetStatementCount() << " statements translated again"
+            << ( change.passI ? " after Pass I, " : ", " ) << errors << ( errors == 1 ? " error" : " errors" )
+            << ", in " << fixed << setprecision( 3 ) << ( Instrument::ElapsedUs() - start ) / 1000 << " ms." << endl;
+        Instrument::WriteReportsFromEnvironment();
+    }
+    cerr << "Stopped watching " << a_opts.sourcePath << endl;
+    return 1;
+}
+/* static int WatchSource( Assembler &a_assem, FileWatcher &a_watcher, const AssemOptions &a_opts ) */
+
+// Serves the jobs sent to a socket until it can no longer be listened on, and returns the exit status.
+static int ServeJobs( const AssemOptions &a_opts )
+{
+    AssemblyServer::Limits limits;
+    limits.instructions = a_opts.maxInstructions;
+    limits.output = (size_t)a_opts.maxOutput;
+    AssemblyServer server( a_opts.servePath, a_opts.jobs, limits );
+    if( !server.IsListening() ) {
+        cerr << "Could not listen on " << a_opts.servePath << "; it may be in use, or not a socket." << endl;
+        return 1;
+    }
+    if( !a_opts.quiet ) cout << "Serving jobs on " << a_opts.servePath << "." << endl;
+    server.Serve();
+    cerr << "Stopped serving on " << a_opts.servePath << endl;
+    return 1;
+}
+
+int main( int argc, char *argv[] )
+{
+    AssemOptions opts;
+    if( !ParseOptions( argc, argv, opts ) ) {
+        DisplayUsage();
+        return 1;
+    }
+    if( !opts.servePath.empty() ) return ServeJobs( opts );
+    if( !opts.runPath.empty() ) return RunObjectFile( opts );
+    if( opts.link ) return LinkObjectFiles( opts );
+
+    unique_ptr<AssemblyCache> cache = OpenCache( opts );
+    if( opts.sourcePath.empty() ) return AssembleBatch( opts, cache.get() );
+
+    // A quiet run that only assembles shows nothing, so the files it writes can come from the cache.
+    CachedFiles files;
+    string key;
+    if( cache && opts.quiet && opts.assembleOnly && !opts.watch && opts.sourcePath != "-" ) {
+        string diagnosticsPath = Instrument::GetEnvironment( "VC8000_DIAGNOSTICS" );
+        if( !opts.objectPath.empty() ) files.push_back( { "obj", opts.objectPath } );
+        if( !diagnosticsPath.empty() ) files.push_back( { "json", diagnosticsPath } );
+
+        bool served = false;
+        if( !files.empty() && diagnosticsPath != "-" ) {
+            PhaseTimer timer( "cache_lookup" );
+            size_t errors;
+            key = MakeCacheKey( opts.sourcePath, opts, files );
+            served = !key.empty() && WriteFromCache( *cache, key, files, errors );
+        }
+        if( served ) {
+            Instrument::WriteReportsFromEnvironment();
+            return 0;
+        }
+    }
+
+    // A source that is watched is watched from now, so that a save while it is first assembled is seen.
+    unique_ptr<FileWatcher> watcher;
+    if( opts.watch ) watcher = make_unique<FileWatcher>( opts.sourcePath );
+
+    Assembler assem( opts.sourcePath );
+    if( opts.watch ) assem.KeepSource();
+    assem.SetBatch( opts.batch || opts.quiet || opts.watch );
+    assem.SetModule( opts.compile );
+    assem.SetSymbolTableListing( opts.listSymbols && !opts.quiet, opts.symbolsPath );
+    assem.SetTranslationListing( opts.listTranslation && !opts.quiet, opts.listingPath );
+
+    // The phases are separated by a line, and by a pause when the user is at a terminal, unless quiet.
+    Assemble( assem, opts.engine, [&]() { if( !opts.quiet ) assem.InterPass(); } );
+
+    // Keep the assembled program, if asked to.  It must be written before it is handed to the emulator.
+    int status = 0;
+    if( !opts.objectPath.empty() && !assem.WriteObjectFile( opts.objectPath ) ) status = 1;
+
+    // Keep assembling the source as it changes, if asked to.
+    if( opts.watch ) {
+        assem.WriteDiagnosticsFromEnvironment();
+        Instrument::WriteReportsFromEnvironment();
+        return WatchSource( assem, *watcher, opts );
+    }
+
+    if( !opts.assembleOnly ) {
+
+        // Buffer between PassII and Emulation.
+        if( !opts.quiet ) assem.InterPass();
+
+        // Run the emulator on the translation of the assembler language program that was generated in Pass II.
+        assem.RunProgramInEmulator( opts.quiet );
+    }
+
+    // Write the diagnostics and the performance reports, if they were requested.
+    assem.WriteDiagnosticsFromEnvironment();
+    if( !key.empty() && status == 0 ) {
+        PhaseTimer timer( "cache_store" );
+        StoreInCache( *cache, key, files, assem.GetErrorCount() );
+        cache->Trim();
+    }
+    Instrument::WriteReportsFromEnvironment();
+
+    // Terminate indicating all is well, unless the object file could not be written.  If there is an
+    // unrecoverable error, the program will terminate at the point that it occurred with an exit(1) call.
+    return status;
+}
@@ -3,15 +3,54 @@
 //
 #include "stdafx.h"
 #include "Assembler.h"
-#include "Errors.h"
+#include "Diagnostics.h"
+#include "Instrument.h"
+#include "ObjectFile.h"
+#include "Isa.h"
+#include "LineScanner.h"
+
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
 
 // Constructor for the assembler.  Note: we are passing argc and argv to the file access constructor.
 // See main program.  
 Assembler::Assembler( int argc, char *argv[] )
 : m_facc( argc, argv )
 {
+    m_symbolsPath = Instrument::GetEnvironment( "VC8000_SYMBOLS" );
+    m_listingPath = Instrument::GetEnvironment( "VC8000_LISTING" );
 }  
 
+// Constructor for the assembler, for a source file named by the command line driver.
+Assembler::Assembler( const string &a_fileName )
+: m_facc( a_fileName )
+{
+    m_symbolsPath = Instrument::GetEnvironment( "VC8000_SYMBOLS" );
+    m_listingPath = Instrument::GetEnvironment( "VC8000_LISTING" );
+}
+
+// Constructor for the assembler, for one of the source files of a batch, which goes on without it if it
+// cannot be read.
+Assembler::Assembler( const string &a_fileName, bool &a_opened )
+: m_facc( a_fileName, a_opened )
+{
+    m_symbolsPath = Instrument::GetEnvironment( "VC8000_SYMBOLS" );
+    m_listingPath = Instrument::GetEnvironment( "VC8000_LISTING" );
+}
+
+// Constructor for the assembler, for a source sent to the assembly server, which lists it itself.
+Assembler::Assembler( const string &a_name, string a_text )
+: m_facc( a_name, std::move( a_text ) ), m_batch( true ), m_listSymbols( false ), m_listTranslation( false )
+{
+}
+
 /**/
 /*
 NAME
@@ -24,12 +63,28 @@ SYNOPSIS
 
 DESCRIPTION
 
-        This function reads each line from the source file and parses it to determine the type of instruction.
-        If the instruction is an end statement, the function exits. Otherwise, it handles labels, records them, and
-        computes the location of the next instruction based on the current location.
+        This function parses each line from the source file to determine the type of instruction. Up to the end
+        statement, it handles labels, records them, and computes the location of the next instruction based on the
+        current location.
     
         Labels can only be associated with machine language and assembler language instructions. Comments are skipped.
 
+        Every line, including those after the end statement, is kept in the token cache with its location, so that
+        Pass II does not need to parse it again.
+
+        The location of a line only depends on the lines before it through the location, which each statement either
+        advances or, for an org, replaces.  So the chunks of ChunkLines lines are scanned on the threads of the shared
+        pool, each giving the location after it relative to its start, or absolute if it has an org, and the labels in
+        it located the same way.  The chunks are then combined in order: a running sum of the locations gives the start
+        of each chunk, which fixes the location of its labels, and the labels are added to the symbol table in source
+        order, so a label defined in two chunks is multiply defined just as if the lines were read one after another.
+        Last, the relative locations in the token cache are made absolute, again on the pool.
+
+        An org or ds whose operand is not a number uses the last numeric operand 1 before it, which may come from an
+        earlier chunk.  The few chunks where that happens are scanned again while combining, once it is known.
+
+        The labels exports and imports name are recorded in order with the labels defined, and whether an org places
+        the program and the highest location it reaches are found along the way, for the object file of a module.
 
 RETURNS
 
@@ -39,48 +94,189 @@ RETURNS
 /**/
 void Assembler::PassI( ) 
 {
-    int loc = 0;        // Tracks the location of the instructions to be generated.
+    PhaseTimer timer("pass1");
 
-    // Successively process each line of source code.
-    for( ; ; ) {
+    // Size the symbol table for the labels a source of this length usually has.
+    m_symtab.Reserve( m_facc.GetLineCount() / LinesPerSymbol );
+    const size_t chunkCount = ( m_facc.GetLineCount() + ChunkLines - 1 ) / ChunkLines;
 
-        // Read the next line from the source file.
-        string line; 
-        if( ! m_facc.GetNextLine( line ) ) {
+    ThreadPool &pool = ThreadPool::Shared();
+    vector<Instruction> insts( pool.GetThreadCount() );     // The instruction object of each thread.
+    vector<ChunkScan> scans( chunkCount );                  // What was found in each chunk.
+    m_tokens.Resize( m_facc.GetLineCount() );
 
-            // If there are no more lines, we are missing an end statement.
-            // We will let this error be reported by Pass II.
-            //cout << "missing end statemtn" << endl;
-            break;
-        }
+    // Scan the chunks.
+    pool.ParallelFor( chunkCount, [&]( size_t a_chunk, unsigned a_thread ) {
+        ScanChunk( insts[a_thread], a_chunk, false, scans[a_chunk] );
+    } );
 
-        // Parse the line and get the instruction type.
-        Instruction::InstructionType st =  m_inst.ParseInstruction( line );
+    // Combine the chunks in order.  Labels after the first end statement are not recorded.
+    m_endLine = SIZE_MAX;
+    m_absolute = false;
+    m_highLocation = 0;
+    vector<int> chunkLocs( chunkCount );    // The location at the start of each chunk.
+    int loc = 0;                            // Tracks the location of the instructions to be generated.
+    int operand = 0;                        // The last numeric operand 1.
 
-        // If this is an end statement, there is nothing left to do in pass I.
-        // Pass II will determine if the end is the last statement and report an error if it isn't.
-        if( st == Instruction::InstructionType::ST_End ) break;
+    for( size_t ichunk = 0; ichunk < chunkCount; ichunk++ ) {
+        ChunkScan &scan = scans[ichunk];
+        chunkLocs[ichunk] = loc;
 
-        // Labels can only be on machine language and assembler language
-        // instructions.  So, skip comments.
-        if( st == Instruction::InstructionType::ST_Comment )  
-        {
-        	continue;
-	    }
-        // Handle the case where there is an error.
-        
-        // If the instruction has a label, record it and its location in the
-        // symbol table.
-        if( m_inst.isLabel( ) ) {
+        // Scan the chunk again if its locations depend on the operand before it.
+        if( scan.needsOperand ) {
+            m_inst.SetOperand1Value( operand );
+            ScanChunk( m_inst, ichunk, true, scan );
+        }
 
-            m_symtab.AddSymbol( m_inst.GetLabel( ), loc );
+        // Record the labels and their locations in the symbol table.
+        if( m_endLine == SIZE_MAX ) {
+            for( const ChunkLabel &label : scan.labels ) {
+                RecordLabel( label.label, label.use, label.absolute ? label.loc : loc + label.loc );
+            }
+            m_absolute = m_absolute || scan.hasOrg;
+            m_highLocation = max( { m_highLocation, loc + scan.highRelative, scan.highAbsolute } );
+            m_endLine = scan.endLine;
         }
-        // Compute the location of the next instruction.
-        loc = m_inst.LocationNextInstruction( loc );
+        loc = scan.absolute ? scan.loc : loc + scan.loc;
+        if( scan.hasOperand ) operand = scan.operand;
     }
+
+    // Make the locations of the lines before the first org of each chunk absolute.
+    pool.ParallelFor( chunkCount, [&]( size_t a_chunk, unsigned ) {
+        m_tokens.OffsetLocations( a_chunk * ChunkLines, scans[a_chunk].relativeEnd, chunkLocs[a_chunk] );
+    } );
 }
 /* void Assembler::PassI( ) */
 
+/**/
+/*
+NAME
+
+        Assembler::ScanChunk - scans a chunk of lines for Pass I.
+
+SYNOPSIS
+
+        void Assembler::ScanChunk( Instruction &a_inst, size_t a_chunk, bool a_operandKnown, ChunkScan &a_scan );
+            a_inst          --> the instruction object to parse the lines with.
+            a_chunk         --> the index of the chunk.
+            a_operandKnown  --> true if a_inst holds the operand 1 value of the lines before the chunk.
+            a_scan          --> set to what was found in the chunk.
+
+DESCRIPTION
+
+        This function does the work of Pass I for the lines of one chunk, as if the chunk started at location 0,
+        and keeps each line in the token cache.  Until an org, locations are relative to the start of the chunk;
+        after one they are absolute.  Labels, and the highest location, are only recorded up to an end statement.
+        If the operand value of the lines before the chunk is not known and a location depends on it, that is noted
+        so that the chunk can be scanned again.  It reads only the source and writes only a_inst, a_scan and the
+        chunk's lines of the token cache, so it can be run on several threads at once.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::ScanChunk( Instruction &a_inst, size_t a_chunk, bool a_operandKnown, ChunkScan &a_scan )
+{
+    a_scan = ChunkScan();
+
+    size_t first = a_chunk * ChunkLines;
+    size_t last = min( first + ChunkLines, m_facc.GetLineCount() );
+    a_scan.relativeEnd = last;
+    for( size_t iline = first; iline < last; iline++ ) {
+
+        // Parse the line and keep it with its location.
+        Instruction::InstructionType st = a_inst.ParseInstruction( m_facc.GetLine( iline ) );
+        m_tokens.Store( iline, a_inst.GetTokens(), a_scan.loc );
+
+        // Labels can only be on machine language and assembler language instructions.  So, skip comments.
+        if( st == Instruction::InstructionType::ST_Comment ) continue;
+
+        // Keep track of operand 1, which an org or ds without a numeric operand uses.
+        Instruction::SymbolicOpCode op = a_inst.GetOpCode();
+        if( a_inst.isNumericOperand1() ) {
+            a_scan.hasOperand = true;
+            a_scan.operand = a_inst.GetOperand1Value();
+        }
+        else if( !a_scan.hasOperand && !a_operandKnown
+            && ( op == Instruction::SymbolicOpCode::OC_ORG || op == Instruction::SymbolicOpCode::OC_DS ) ) {
+            a_scan.needsOperand = true;
+        }
+
+        // Labels after the end statement are not recorded.  Pass II will determine if the end is the last statement
+        // and report an error if it isn't.
+        if( st == Instruction::InstructionType::ST_End && a_scan.endLine == SIZE_MAX ) a_scan.endLine = iline;
+
+        // If the instruction has a label, record it and its location.  So too the label an export or import names,
+        // unless it has an error, which Pass II reports.
+        if( a_scan.endLine == SIZE_MAX ) {
+            if( a_inst.isLabel( ) ) {
+                a_scan.labels.push_back( { a_inst.GetLabel( ), LabelUse::Define, a_scan.absolute, a_scan.loc } );
+            }
+            if( ( op == Instruction::SymbolicOpCode::OC_EXPORT || op == Instruction::SymbolicOpCode::OC_IMPORT )
+                && Isa::IsValidLabel( a_inst.GetSymbolOperand( ) ) ) {
+                LabelUse use = op == Instruction::SymbolicOpCode::OC_EXPORT ? LabelUse::Export : LabelUse::Import;
+                a_scan.labels.push_back( { a_inst.GetSymbolOperand( ), use, a_scan.absolute, a_scan.loc } );
+            }
+            if( op == Instruction::SymbolicOpCode::OC_ORG ) a_scan.hasOrg = true;
+        }
+
+        // Compute the location of the next instruction.  An org makes it absolute.
+        if( op == Instruction::SymbolicOpCode::OC_ORG && !a_scan.absolute ) {
+            a_scan.absolute = true;
+            a_scan.relativeEnd = iline + 1;
+        }
+        a_scan.loc = a_inst.LocationNextInstruction( a_scan.loc );
+        if( a_scan.endLine == SIZE_MAX ) {
+            int &high = a_scan.absolute ? a_scan.highAbsolute : a_scan.highRelative;
+            high = max( high, a_scan.loc );
+        }
+    }
+}
+/* void Assembler::ScanChunk( Instruction &a_inst, size_t a_chunk, bool a_operandKnown, ChunkScan &a_scan ) */
+
+/**/
+/*
+NAME
+
+        Assembler::RecordLabel - records a label Pass I found in the symbol table.
+
+SYNOPSIS
+
+        void Assembler::RecordLabel( string_view a_label, LabelUse a_use, int a_loc );
+            a_label     --> the label.
+            a_use       --> what the statement does with it.
+            a_loc       --> the location of the statement.
+
+DESCRIPTION
+
+        A label defined is added at its location, and a label exported is marked so.  A label imported is
+        only marked so in a module; in a whole program there is nothing to import it from, so references to
+        it are not found.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::RecordLabel( string_view a_label, LabelUse a_use, int a_loc )
+{
+    switch( a_use ) {
+        case LabelUse::Define:
+            m_symtab.AddSymbol( a_label, a_loc );
+            break;
+        case LabelUse::Import:
+            if( m_module ) m_symtab.ImportSymbol( m_symtab.InternSymbol( a_label ) );
+            break;
+        case LabelUse::Export:
+            m_symtab.ExportSymbol( m_symtab.InternSymbol( a_label ) );
+            break;
+    }
+}
+/* void Assembler::RecordLabel( string_view a_label, LabelUse a_use, int a_loc ) */
+
 /**/
 /*
 NAME
@@ -94,10 +290,20 @@ SYNOPSIS
 
 DESCRIPTION
 
-        This function processes the second pass of assembly. It reads each line from the source file, parses it to 
-        determine the type of instruction, translates the instruction, and adds it to the translation. If an end statement 
-        is encountered, the function checks if it's the first or multiple end statements, and reports errors accordingly. 
-        If no end statement is found, an error is added. Finally, the entire translation is displayed.
+        This function processes the second pass of assembly. Each line that Pass I kept in the token cache is
+        translated, at the location Pass I found for it, and added to the translation. If an end statement is
+        encountered, the function checks if it's the first or multiple end statements, and reports errors accordingly.
+        If no end statement is found, an error is added. The translation is displayed separately by DisplayTranslation.
+
+        Once Pass I is done the symbol table does not change, and the translation of a line depends only on the line
+        and its location.  So the chunks of lines are translated on the threads of the shared pool, each thread with
+        its own Instruction and so its own error buffer, and the chunks are then added to the translation in source
+        order.  The translation is the same as from translating the lines one after another.
+
+        The machine word of each statement is stored in the memory image as it is translated, so the emulator
+        can take the program over without loading it.  If the segments of the program overlap, a location may be
+        stored more than once and the last statement must win, so the words are then stored in order once the
+        chunks are added instead.  Storing stops at the first word outside memory, as loading does.
 
 RETURNS
 
@@ -107,71 +313,296 @@ RETURNS
 /**/
 void Assembler::PassII() {
 
+    PhaseTimer timer("pass2");
+    const size_t lineCount = m_tokens.GetLineCount();
+    const size_t chunkCount = ( lineCount + ChunkLines - 1 ) / ChunkLines;
+
+    ThreadPool &pool = ThreadPool::Shared();
+    vector<Instruction> insts( pool.GetThreadCount() );    // The instruction object of each thread.
+    vector<Translation> chunks( chunkCount );               // The translation of each chunk.
+    vector<char> stored( chunkCount, true );                // Whether each chunk's words were stored.
+    bool reachedEnd = false;                                // Tracks whether an end statement was reached.
+
+    // Lay out the memory image.  The words are stored with the translation if no location can be stored twice.
+    m_image.Start( FindSegments() );
+    MemoryImage *image = m_image.IsDisjoint() ? &m_image : nullptr;
+
+    // Translate the chunks.  The last one tells whether there was an end statement.
+    pool.ParallelFor( chunkCount, [&]( size_t a_chunk, unsigned a_thread ) {
+        size_t first = a_chunk * ChunkLines;
+        bool chunkReachedEnd = m_endLine < first;
+        stored[a_chunk] = TranslateLines( insts[a_thread], first, min( first + ChunkLines, lineCount ), chunkReachedEnd,
+            chunks[a_chunk], image );
+        if( a_chunk == chunkCount - 1 ) reachedEnd = chunkReachedEnd;
+    } );
+    if( find( stored.begin(), stored.end(), false ) != stored.end() ) m_image.SetFailed();
+
+    // Add the chunks to the translation in order, releasing each as it is added.
+    size_t firstStatement = m_trans.GetStatementCount();
+    m_trans.Reserve( firstStatement + lineCount );
+    for( Translation &chunk : chunks ) m_trans.AddStatements( chunk );
+
+    // Otherwise store the words in order.
+    if( image == nullptr ) StoreWords( firstStatement );
+    if( m_module ) CollectRelocations( firstStatement, nullptr );
+
+    // If there are no more lines, we are missing an end statement.
+    if (!reachedEnd) m_diags.Record(DiagCode::MissingEnd);
+}
+/* void Assembler::PassII() */
+
+/**/
+/*
+NAME
+
+        Assembler::TranslateLines - translates a range of lines for Pass II.
+
+SYNOPSIS
+
+        bool Assembler::TranslateLines( Instruction &a_inst, size_t a_first, size_t a_last, bool &a_reachedEnd,
+            Translation &a_trans, MemoryImage *a_image ) const;
+            a_inst          --> the instruction object to translate the lines with.
+            a_first         --> the index of the first line to translate.
+            a_last          --> the index of the line after the last one to translate.
+            a_reachedEnd    --> true if an end statement comes before the first line; set to whether one
+                                comes before the line after the last one.
+            a_trans         --> the translation the translated statements are added to.
+            a_image         --> the memory image to store the machine words in, or null.
+
+DESCRIPTION
+
+        This function translates each line in turn from its fields in the token cache and adds it, with its
+        errors, to a_trans, and stores its machine word in a_image.  It reads only the token cache, the source and
+        the symbol table, records errors only in a_inst, and stores only the locations of its own lines, so it can
+        be run on several threads at once as long as each has its own a_inst and a_trans and the segments of the
+        program do not overlap.  Once a word cannot be stored, no more are.
+
+RETURNS
+
+        Returns false if a word was outside memory.
+
+*/
+/**/
+bool Assembler::TranslateLines( Instruction &a_inst, size_t a_first, size_t a_last, bool &a_reachedEnd,
+    Translation &a_trans, MemoryImage *a_image ) const
+{
+    bool stored = true;     // == true while every word has been stored.
+    a_trans.Reserve( a_trans.GetStatementCount() + ( a_last - a_first ) );
+    DiagnosticBuffer &errors = a_inst.GetErrors();
+
+    for( size_t iline = a_first; iline < a_last; iline++ ) {
+
+        // Restore the line as Pass I parsed it and get the instruction type.
+        Instruction::InstructionType st = a_inst.SetTokens( m_tokens.Load( iline ), m_facc.GetLine( iline ) );
+
+        // Translate the instruction and add it to the translation and the memory image.
+        TransStmt stmt = a_inst.Translate( m_tokens.GetLocation( iline ), iline, m_symtab );
+        if( a_image != nullptr && stored ) stored = a_image->Store( stmt.GetLocation(), stmt.GetNumContents() );
+        a_trans.AddStatement( stmt );
+
+        if( st == Instruction::InstructionType::ST_End ) {
+            // If we already reached the end, this statement is redundant.
+            if( a_reachedEnd ) errors.Record( DiagCode::MultipleEnd );
+            else a_reachedEnd = true;
+        }
+        else {
+            // Report error if we encounter additional statements after an end statement was reached.
+            // Ignore comments or blank lines.
+            if( a_reachedEnd && st != Instruction::InstructionType::ST_Comment ) {
+                errors.Record( DiagCode::StatementAfterEnd );
+            }
+        }
+
+        // Add all the errors recorded for the line.  The buffer is cleared when the next line is restored.
+        a_trans.AddDiagnostics( errors );
+    }
+    return stored;
+}
+/* bool Assembler::TranslateLines( Instruction &a_inst, size_t a_first, size_t a_last, bool &a_reachedEnd, Translation &a_trans, MemoryImage *a_image ) const */
+
+/**/
+/*
+NAME
+
+        Assembler::FindSegments - finds the segments of the program from the locations Pass I recorded.
+
+SYNOPSIS
+
+        vector<MemoryImage::Segment> Assembler::FindSegments( ) const;
+
+DESCRIPTION
+
+        A segment is a run of lines whose locations do not go down, from the start of the program or an org
+        to the next org.  Only statements that generate a word store anything, and each advances the location,
+        so the words of a segment are at different locations from the first line's up to the last line's.  A
+        ds with a negative size can move the location back, which starts a new segment too.
+
+RETURNS
+
+        Returns the segments, in the order of the lines.
+
+*/
+/**/
+vector<MemoryImage::Segment> Assembler::FindSegments( ) const
+{
+    vector<MemoryImage::Segment> segments;
+    const size_t lineCount = m_tokens.GetLineCount();
+    if( lineCount == 0 ) return segments;
+
+    MemoryImage::Segment segment = { m_tokens.GetLocation( 0 ), m_tokens.GetLocation( 0 ) };
+    for( size_t iline = 1; iline < lineCount; iline++ ) {
+        int loc = m_tokens.GetLocation( iline );
+        bool afterOrg = m_tokens.GetOpCode( iline - 1 ) == Instruction::SymbolicOpCode::OC_ORG;
+        if( afterOrg || loc < segment.last ) {
+            segments.push_back( segment );
+            segment.first = loc;
+        }
+        segment.last = loc;
+    }
+    segments.push_back( segment );
+    return segments;
+}
+/* vector<MemoryImage::Segment> Assembler::FindSegments( ) const */
+
+/**/
+/*
+NAME
+
+        Assembler::SinglePass - establishes the location of the labels and generates the translation in one pass.
+
+SYNOPSIS
+
+        void Assembler::SinglePass( );
+
+DESCRIPTION
+
+        This function does the work of Pass I and Pass II while reading and parsing each line of the source only
+        once.  Labels are recorded in the symbol table as they are defined, up to the first end statement, just
+        as Pass I does.  A statement that refers to a label is translated straight away and its reference is kept
+        in a fixup list for that label.  When the label is defined, the address of each statement referring to it
+        is patched; if it is defined again, they are all marked as referring to a multiply defined symbol instead.
+        At the first end statement the symbol table is final, so any references still unresolved are reported as
+        labels not found, and later references are looked up directly.  The label an export names is referred to
+        in the same way, and a label a module imports is patched with address 0, which the linker fills in.
+
+        The symbol table, translation, memory image and errors are the same as those from Pass I and Pass II.
+        Since a statement may be patched after it is translated, its word is only stored in the memory image
+        once every line has been read.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::SinglePass() {
+
+    PhaseTimer timer("single_pass");
     int loc = 0;                // Tracks the location of the instructions to be generated.
     bool reachedEnd = false;    // Tracks whether an end statement was reached.
 
-    // Rewind the file to the beginning.
-    m_facc.rewind();
-    // Reset error logging to prevent duplicate messages.
-    Errors::InitErrorReporting();
-    
+    m_fixups.clear();
+    m_fixupHeads.clear();
+    m_symtab.Reserve( m_facc.GetLineCount() / LinesPerSymbol );
+    m_absolute = false;
+    m_highLocation = 0;
+
     // Successively process each line of source code.
-    for ( ; ; ) {
+    for (size_t iline = 0; ; iline++) {
 
         // Read the next line from the source file.
-        string line;
+        string_view line;
         if (!m_facc.GetNextLine(line)) {
             // If there are no more lines, we are missing an end statement.
-            if (!reachedEnd) Errors::RecordError("Error: Missing end statement.");
+            if (!reachedEnd) {
+                ResolveFixups();
+                m_diags.Record(DiagCode::MissingEnd);
+            }
             break;
         }
 
         // Parse the line and get the instruction type.
         Instruction::InstructionType st = m_inst.ParseInstruction(line);
 
-        // Translate the instruction and add it to the translation.
-        m_trans.AddStatement(m_inst.Translate(loc, m_symtab));
+        // Until the end statement, record labels as Pass I does.  Labels can only be on machine language
+        // and assembler language instructions, so skip comments.
+        Instruction::SymbolicOpCode op = m_inst.GetOpCode();
+        if (!reachedEnd && st != Instruction::InstructionType::ST_End
+            && st != Instruction::InstructionType::ST_Comment) {
+            if (m_inst.isLabel()) DefineLabel(m_symtab.InternSymbol(m_inst.GetLabel()), loc);
+            bool validSymbol = Isa::IsValidLabel(m_inst.GetSymbolOperand());
+            if (op == Instruction::SymbolicOpCode::OC_IMPORT && m_module && validSymbol) {
+                DefineLabel(m_symtab.InternSymbol(m_inst.GetSymbolOperand()), 0, true);
+            }
+            if (op == Instruction::SymbolicOpCode::OC_EXPORT && validSymbol) {
+                m_symtab.ExportSymbol(m_symtab.InternSymbol(m_inst.GetSymbolOperand()));
+            }
+            if (op == Instruction::SymbolicOpCode::OC_ORG) m_absolute = true;
+        }
+
+        // Translate the instruction and add it to the translation.  Its address label is looked up below.
+        int lookupErr;
+        m_trans.AddStatement(m_inst.TranslateDeferred(loc, iline, lookupErr));
 
+        DiagnosticBuffer &errors = m_inst.GetErrors();
         if (st == Instruction::InstructionType::ST_End) {
             // If we already reached the end, this statement is redundant.
-            if (reachedEnd) Errors::RecordError("Error: Multiple end statements.");
+            if (reachedEnd) errors.Record(DiagCode::MultipleEnd);
             else reachedEnd = true;
         }
         else {
             // Report error if we encounter additional statements after an end statement was reached.
             // Ignore comments or blank lines.
             if (reachedEnd && st != Instruction::InstructionType::ST_Comment) {
-                Errors::RecordError("Error: Additional statement following end statement.");
+                errors.Record(DiagCode::StatementAfterEnd);
             }
         }
 
-        // Add all logged errors and reset the error handler for the next line.
-        m_trans.AddError(Errors::GetErrors());
-        Errors::InitErrorReporting();
+        // Add all the errors recorded for the line.  The buffer is cleared when the next line is parsed.
+        m_trans.AddDiagnostics(errors);
+
+        // Resolve the address label, or the label an export names, or keep the reference until the label is defined.
+        if (lookupErr >= 0) {
+            int operand = op == Instruction::SymbolicOpCode::OC_EXPORT ? 1 : 2;
+            string_view label = operand == 1 ? m_inst.GetSymbolOperand() : m_inst.GetAddressLabel();
+            Diagnostic span = errors.Make(DiagCode::LabelNotFound, label, operand);
+            ReferenceLabel(m_symtab.InternSymbol(label),
+                { m_trans.GetStatementCount() - 1, lookupErr, -1, span.column, span.length, (unsigned char)operand },
+                reachedEnd);
+        }
+
+        // The symbol table is final once the first end statement is reached.
+        if (st == Instruction::InstructionType::ST_End && !m_fixups.empty()) ResolveFixups();
 
         // Compute the location of the next instruction.
         loc = m_inst.LocationNextInstruction(loc);
+        if (!reachedEnd) m_highLocation = max(m_highLocation, loc);
     }
 
-    // Display the entire translation calculated by Pass II.
-    m_trans.DisplayTranslation();
+    // The addresses are final, so store the words in the memory image.
+    m_image.Start({});
+    StoreWords(0);
+    if (m_module) CollectRelocations(0, nullptr);
 }
-/* void Assembler::PassII() */
+/* void Assembler::SinglePass() */
 
 /**/
 /*
 NAME
 
-        Assembler::InterPass - adds a buffer of user confirmation between passes of the assembler.
+        Assembler::StreamPassI - establishes the location of the labels in one read through the source.
 
 SYNOPSIS
 
-        void Assembler::InterPass( );
+        void Assembler::StreamPassI( );
 
 DESCRIPTION
 
-        This function breaks up the passes and printing of assembler information with lines and user input to clearly
-        delineate each section of code.
+        This function does the work of Pass I one line after another, without the token cache or the index of
+        the lines, so that the only memory it keeps is the symbol table.  Up to the first end statement, each
+        label is added to the symbol table at its location, and each label an export or import names is marked
+        as Pass I marks it.  Comments are skipped.  The pages of the source it
+        has read are let go, since StreamPassII reads them again in order.
 
 RETURNS
 
@@ -179,10 +610,1035 @@ RETURNS
 
 */
 /**/
-void Assembler::InterPass() {
-    // Break up the program passes with user input.
-    cout << "__________________________________________________________\n" << endl;
-    cout << "Press Enter to continue...\n" << endl;
-    cin.get();
+void Assembler::StreamPassI( )
+{
+    PhaseTimer timer( "stream_pass1" );
+    int loc = 0;                // Tracks the location of the instructions to be generated.
+
+    m_facc.rewind();
+    m_inst.SetOperand1Value( 0 );
+    m_absolute = false;
+    m_highLocation = 0;
+
+    string_view line;
+    while( m_facc.GetNextLine( line ) ) {
+
+        // Parse the line and get the instruction type.  Labels after the end statement are not recorded.
+        Instruction::InstructionType st = m_inst.ParseInstruction( line );
+        if( st == Instruction::InstructionType::ST_End ) break;
+
+        // Labels can only be on machine language and assembler language instructions.  So, skip comments.
+        if( st == Instruction::InstructionType::ST_Comment ) continue;
+
+        // If the instruction has a label, record it and its location in the symbol table.  So too the label an
+        // export or import names, unless it has an error.
+        Instruction::SymbolicOpCode op = m_inst.GetOpCode();
+        bool validSymbol = Isa::IsValidLabel( m_inst.GetSymbolOperand() );
+        if( m_inst.isLabel() ) m_symtab.AddSymbol( m_inst.GetLabel(), loc );
+        if( op == Instruction::SymbolicOpCode::OC_EXPORT && validSymbol ) {
+            RecordLabel( m_inst.GetSymbolOperand(), LabelUse::Export, loc );
+        }
+        if( op == Instruction::SymbolicOpCode::OC_IMPORT && validSymbol ) {
+            RecordLabel( m_inst.GetSymbolOperand(), LabelUse::Import, loc );
+        }
+        if( op == Instruction::SymbolicOpCode::OC_ORG ) m_absolute = true;
+
+        // Compute the location of the next instruction.
+        loc = m_inst.LocationNextInstruction( loc );
+        m_highLocation = max( m_highLocation, loc );
+    }
+    m_facc.ReleaseReadLines();
+}
+/* void Assembler::StreamPassI( ) */
+
+/**/
+/*
+NAME
+
+        Assembler::StreamPassII - translates, lists and stores the program a batch of lines at a time.
+
+SYNOPSIS
+
+        void Assembler::StreamPassII( );
+
+DESCRIPTION
+
+        This function does the work of Pass II and DisplayTranslation together, for a source too large to keep
+        the whole translation of.  The lines are read in order after StreamPassI has built the symbol table, and
+        each is translated and checked for end statements just as Pass II does.  Every StreamLines lines, the
+        statements translated are listed, their words are stored in the memory image, and they are then cleared,
+        so that the translation, the views of the lines listed and the pages of the source read stay the same size
+        however long the program is.
+
+        The listing is the same as DisplayTranslation writes, and goes to the same place.  The errors are
+        numbered across the batches, so VC8000_MAX_ERRORS leaves out the same ones.  The diagnostics of the
+        statements are only kept if VC8000_DIAGNOSTICS asks for them to be written.  Once a word cannot be
+        stored, no more are and RunProgramInEmulator reports the failure.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::StreamPassII( )
+{
+    PhaseTimer timer( "stream_pass2" );
+    const size_t maxErrors = Diagnostics::GetMaxErrors();
+    const bool keepDiags = !Instrument::GetEnvironment( "VC8000_DIAGNOSTICS" ).empty();
+
+    int loc = 0;                // Tracks the location of the instructions to be generated.
+    bool reachedEnd = false;    // Tracks whether an end statement was reached.
+    size_t errorCount = 0;      // The number of errors in the batches so far.
+    vector<string_view> lines;  // The lines of the batch being translated.
+    lines.reserve( StreamLines );
+
+    m_streamed = true;
+    m_streamDiags.clear();
+    m_trans.Clear();
+    m_image.Start( {} );
+
+    ListingWriter out( cout );
+    const bool listing = m_listTranslation && OpenListing( out, m_listingPath );
+    if( listing ) Translation::DisplayHeader( out );
+
+    // Lists the batch, stores it and clears it, leaving its memory for the next.
+    auto emitBatch = [&]() {
+        if( listing ) errorCount += m_trans.DisplayStatements( out, lines.data(), errorCount, maxErrors );
+        else errorCount += m_trans.GetDiagnosticCount();
+        StoreWords( 0 );
+        if( m_module ) CollectRelocations( 0, lines.data() );
+        if( keepDiags ) {
+            vector<Diagnostic> diags = m_trans.GetDiagnostics();
+            m_streamDiags.insert( m_streamDiags.end(), diags.begin(), diags.end() );
+        }
+        m_trans.Clear();
+        lines.clear();
+        m_facc.ReleaseReadLines();
+    };
+
+    m_facc.rewind();
+    m_inst.SetOperand1Value( 0 );
+
+    string_view line;
+    for( size_t iline = 0; m_facc.GetNextLine( line ); iline++ ) {
+
+        // Parse the line, translate it and add it to the batch.
+        Instruction::InstructionType st = m_inst.ParseInstruction( line );
+        m_trans.AddStatement( m_inst.Translate( loc, iline, m_symtab ) );
+        lines.push_back( line );
+
+        DiagnosticBuffer &errors = m_inst.GetErrors();
+        if( st == Instruction::InstructionType::ST_End ) {
+            // If we already reached the end, this statement is redundant.
+            if( reachedEnd ) errors.Record( DiagCode::MultipleEnd );
+            else reachedEnd = true;
+        }
+        else {
+            // Report error if we encounter additional statements after an end statement was reached.
+            // Ignore comments or blank lines.
+            if( reachedEnd && st != Instruction::InstructionType::ST_Comment ) {
+                errors.Record( DiagCode::StatementAfterEnd );
+            }
+        }
+
+        // Add all the errors recorded for the line.  The buffer is cleared when the next line is parsed.
+        m_trans.AddDiagnostics( errors );
+
+        // Compute the location of the next instruction.
+        loc = m_inst.LocationNextInstruction( loc );
+
+        if( lines.size() == StreamLines ) emitBatch();
+    }
+    emitBatch();
+
+    // If there are no more lines, we are missing an end statement.
+    if( !reachedEnd ) m_diags.Record( DiagCode::MissingEnd );
+
+    // Say how many errors were left out.
+    if( listing ) Translation::DisplayOmitted( out, errorCount, maxErrors );
+    m_streamErrors = errorCount;
+}
+/* void Assembler::StreamPassII( ) */
+
+/**/
+/*
+NAME
+
+        Assembler::DefineLabel - records a label in single pass mode and patches the statements referring to it.
+
+SYNOPSIS
+
+        void Assembler::DefineLabel( int a_id, int a_loc, bool a_import );
+            a_id        --> the symbol table id of the label being defined.
+            a_loc       --> the location of the label.
+            a_import    --> true if the label is imported rather than defined.
+
+DESCRIPTION
+
+        This function adds the label to the symbol table.  If this is the first definition, the statements
+        already referring to the label get its location as their address, and their references are kept in
+        case the label is defined again.  An imported label has address 0 until it is linked, and is not
+        defined, so the exports referring to it are left to be reported as not found.  If it is the second
+        definition, or an import of a label defined, the statements are marked as referring to a multiply
+        defined symbol.  Their references are then dropped, since a multiply defined symbol stays that way and
+        later references see it in the symbol table.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::DefineLabel( int a_id, int a_loc, bool a_import )
+{
+    int prevLoc;
+    bool redefined = m_symtab.LookupSymbol( a_id, prevLoc ) || ( !a_import && m_symtab.IsImported( a_id ) );
+    if( a_import ) m_symtab.ImportSymbol( a_id );
+    else m_symtab.DefineSymbol( a_id, a_loc );
+
+    if( a_id >= (int)m_fixupHeads.size() || m_fixupHeads[a_id] < 0 ) return;
+
+    if( !redefined ) {
+        for( int ref = m_fixupHeads[a_id]; ref >= 0; ref = m_fixups[ref].next ) {
+            if( a_import && m_fixups[ref].operand == 1 ) continue;
+            m_trans.GetStatement( m_fixups[ref].stmt ).SetAddress( a_import ? 0 : a_loc );
+        }
+        return;
+    }
+    for( int ref = m_fixupHeads[a_id]; ref >= 0; ref = m_fixups[ref].next ) {
+        const LabelReference &fixup = m_fixups[ref];
+        m_trans.InvalidateAddress( fixup.stmt, fixup.errIndex, fixup.MakeDiagnostic( DiagCode::MultiplyDefined ) );
+    }
+    m_fixupHeads[a_id] = -1;
+}
+/* void Assembler::DefineLabel( int a_id, int a_loc, bool a_import ) */
+
+/**/
+/*
+NAME
+
+        Assembler::ReferenceLabel - resolves the address label of a statement translated in single pass mode.
+
+SYNOPSIS
+
+        void Assembler::ReferenceLabel( int a_id, const LabelReference &a_ref, bool a_final );
+            a_id        --> the symbol table id of the label the statement refers to.
+            a_ref       --> the reference: the statement, where an error from the lookup belongs among its
+                            diagnostics, and where the label is in it.
+            a_final     --> true if no more labels will be defined.
+
+DESCRIPTION
+
+        If the label is already defined, the statement gets its location, or is marked as referring to a
+        multiply defined symbol.  An address referring to an imported label gets address 0.  Otherwise, if
+        the symbol table is final the label is reported as not found.
+        In the remaining cases the reference is added to the fixup list of the label, since the label may
+        still be defined, or defined again.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::ReferenceLabel( int a_id, const LabelReference &a_ref, bool a_final )
+{
+    int loc;
+    if( m_symtab.LookupSymbol( a_id, loc ) ) {
+        if( loc == m_symtab.multiplyDefinedSymbol ) {
+            m_trans.InvalidateAddress( a_ref.stmt, a_ref.errIndex, a_ref.MakeDiagnostic( DiagCode::MultiplyDefined ) );
+            return;
+        }
+        m_trans.GetStatement( a_ref.stmt ).SetAddress( loc );
+    }
+    else if( a_ref.operand == 2 && m_symtab.IsImported( a_id ) ) {
+        m_trans.GetStatement( a_ref.stmt ).SetAddress( 0 );
+    }
+    else if( a_final ) {
+        m_trans.InvalidateAddress( a_ref.stmt, a_ref.errIndex, a_ref.MakeDiagnostic( DiagCode::LabelNotFound ) );
+        return;
+    }
+    if( a_final ) return;
+
+    // Keep the reference, since the label may still be defined, or defined again.  Ids are given out
+    // in order, so the list heads grow with the symbol table.
+    if( a_id >= (int)m_fixupHeads.size() ) m_fixupHeads.resize( m_symtab.GetSymbolCount(), -1 );
+    m_fixups.push_back( a_ref );
+    m_fixups.back().next = m_fixupHeads[a_id];
+    m_fixupHeads[a_id] = (int)m_fixups.size() - 1;
+}
+/* void Assembler::ReferenceLabel( int a_id, const LabelReference &a_ref, bool a_final ) */
+
+/**/
+/*
+NAME
+
+        Assembler::ResolveFixups - reports the labels still referred to but not defined.
+
+SYNOPSIS
+
+        void Assembler::ResolveFixups( );
+
+DESCRIPTION
+
+        This function is called in single pass mode once the symbol table is final, at the first end statement
+        or at the end of the source.  Every statement referring to a label that was never defined is marked
+        with a label not found error, except the addresses referring to an imported label, which were patched
+        with address 0.  References to defined labels were already patched.  All fixup lists are then
+        discarded.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::ResolveFixups( )
+{
+    for( int id = 0; id < (int)m_fixupHeads.size(); id++ ) {
+        int loc;
+        if( m_fixupHeads[id] < 0 || m_symtab.LookupSymbol( id, loc ) ) continue;
+        bool imported = m_symtab.IsImported( id );
+        for( int ref = m_fixupHeads[id]; ref >= 0; ref = m_fixups[ref].next ) {
+            const LabelReference &fixup = m_fixups[ref];
+            if( imported && fixup.operand == 2 ) continue;
+            m_trans.InvalidateAddress( fixup.stmt, fixup.errIndex, fixup.MakeDiagnostic( DiagCode::LabelNotFound ) );
+        }
+    }
+    m_fixups.clear();
+    m_fixupHeads.clear();
+}
+/* void Assembler::ResolveFixups( ) */
+
+// Returns true if a label means something different in two symbol tables to the statements that refer to it.
+static bool LabelMoved( const SymbolTable &a_before, const SymbolTable &a_after, string_view a_label )
+{
+    int before = 0, after = 0;
+    bool definedBefore = a_before.LookupSymbol( a_label, before );
+    bool definedAfter = a_after.LookupSymbol( a_label, after );
+    return definedBefore != definedAfter || before != after
+        || a_before.IsImported( a_label ) != a_after.IsImported( a_label );
+}
+
+/**/
+/*
+NAME
+
+        Assembler::Reassemble - assembles the program again after its source has changed.
+
+SYNOPSIS
+
+        bool Assembler::Reassemble( Reassembly &a_change );
+            a_change    --> set to what changed and what was done about it.
+
+DESCRIPTION
+
+        The source is read again and compared with the text before, line by line, from the start and from
+        the end; the lines between those the two texts start and end with are the ones that changed.  If
+        they leave the location after them and the labels they record as they were, and any change to the
+        last numeric operand 1 reaches no org or ds, no other line moves and the symbol table stays as it
+        is, so only they are parsed and fitted into the token cache.  Otherwise Pass I is run again over the
+        whole source.
+
+        Then only the statements that may translate differently are translated again: those of the lines
+        that changed and, after Pass I, those whose location moved, those whose place before or after the
+        end statement changed, and those with an operand that names a label whose location changed.  The
+        rest are copied from the translation before, unless most statements are to be translated again, when
+        Pass II is run as it would be the first time.  When Pass I was kept and no location can be stored
+        twice, only the words of the lines that changed are stored in the memory image again; otherwise the
+        image is built again from the translation.
+
+RETURNS
+
+        Returns false if the source could not be read again, in which case nothing changes.
+
+*/
+/**/
+bool Assembler::Reassemble( Reassembly &a_change )
+{
+    PhaseTimer timer( "reassemble" );
+    a_change = Reassembly();
+    if( !m_facc.Reload() ) return false;
+
+    // Find the lines the two texts start and end with.
+    const size_t oldCount = m_facc.GetPreviousLineCount(), newCount = m_facc.GetLineCount();
+    size_t first = 0, common = 0;
+    while( first < oldCount && first < newCount && m_facc.GetPreviousLine( first ) == m_facc.GetLine( first ) ) {
+        first++;
+    }
+    while( common < min( oldCount, newCount ) - first
+        && m_facc.GetPreviousLine( oldCount - 1 - common ) == m_facc.GetLine( newCount - 1 - common ) ) {
+        common++;
+    }
+    if( first == oldCount && first == newCount ) return true;
+    const size_t oldLast = oldCount - common, newLast = newCount - common;
+    a_change.changed = true;
+    a_change.firstChanged = first;
+    a_change.lastChanged = newLast;
+
+    // Find the location of the first line that changed.
+    int loc = 0;
+    bool keep = true;
+    if( first < oldCount ) loc = m_tokens.GetLocation( first );
+    else if( first > 0 ) {
+        m_inst.ParseInstruction( m_facc.GetLine( first - 1 ) );
+        Instruction::SymbolicOpCode op = m_inst.GetOpCode();
+        keep = m_inst.isNumericOperand1()
+            || ( op != Instruction::SymbolicOpCode::OC_ORG && op != Instruction::SymbolicOpCode::OC_DS );
+        loc = m_inst.LocationNextInstruction( m_tokens.GetLocation( first - 1 ) );
+    }
+
+    // Keep Pass I if the lines that changed leave the lines after them where they were, and the labels too.
+    ChunkScan before, after;
+    keep = keep && LocateLines( true, first, oldLast, loc, before );
+    if( keep ) {
+        m_tokens.Replace( first, oldLast - first, newLast - first );
+        keep = LocateLines( false, first, newLast, loc, after ) && before.loc == after.loc
+            && before.hasOperand == after.hasOperand
+            && ( before.operand == after.operand || ( after.hasOperand && CarryOperand( newLast, after.operand ) ) )
+            && equal( before.labels.begin(), before.labels.end(), after.labels.begin(), after.labels.end(),
+                []( const ChunkLabel &a_lhs, const ChunkLabel &a_rhs ) {
+                    return a_lhs.label == a_rhs.label && a_lhs.use == a_rhs.use && a_lhs.loc == a_rhs.loc;
+                } );
+    }
+
+    // Otherwise run Pass I again, keeping the symbol table before to see which labels moved.
+    const size_t oldEndLine = m_endLine;
+    unique_ptr<SymbolTable> previous;
+    bool labelsMoved = false;
+    if( keep ) {
+        if( m_endLine != SIZE_MAX && m_endLine >= oldLast ) m_endLine = m_endLine - oldLast + newLast;
+    }
+    else {
+        previous.reset( new SymbolTable( move( m_symtab ) ) );
+        m_symtab.Clear();
+        PassI();
+        for( int id = 0; id < previous->GetSymbolCount() && !labelsMoved; id++ ) {
+            labelsMoved = LabelMoved( *previous, m_symtab, previous->GetName( id ) );
+        }
+        for( int id = 0; id < m_symtab.GetSymbolCount() && !labelsMoved; id++ ) {
+            labelsMoved = LabelMoved( *previous, m_symtab, m_symtab.GetName( id ) );
+        }
+    }
+
+    // Whether the statement of a line that did not change may translate differently.
+    const vector<TransStmt> &stmts = m_trans.GetStatements();
+    auto oldLine = [&]( size_t a_line ) { return a_line < first ? a_line : a_line - newLast + oldLast; };
+    auto mustTranslate = [&]( size_t a_line ) {
+        if( a_line >= first && a_line < newLast ) return true;
+        if( keep ) return false;
+
+        size_t old = oldLine( a_line );
+        if( m_tokens.GetLocation( a_line ) != stmts[old].GetLocation() ) return true;
+        if( ( oldEndLine < old ) != ( m_endLine < a_line ) || ( oldEndLine == old ) != ( m_endLine == a_line ) ) {
+            return true;
+        }
+        if( !labelsMoved ) return false;
+        Instruction::Tokens tokens = m_tokens.Load( a_line );
+        string_view line = m_facc.GetLine( a_line );
+        return ( !tokens.isNumeric1 && tokens.operand1Length > 0
+                && LabelMoved( *previous, m_symtab, line.substr( tokens.operand1Start, tokens.operand1Length ) ) )
+            || ( !tokens.isNumeric2 && tokens.operand2Length > 0
+                && LabelMoved( *previous, m_symtab, line.substr( tokens.operand2Start, tokens.operand2Length ) ) );
+    };
+
+    // After Pass I, every line must be looked at, so that is done on the pool.  If most of the lines are to be
+    // translated again, Pass II translates them all faster than one thread would.
+    vector<char> retranslate;
+    if( !keep ) {
+        const size_t chunkCount = ( newCount + ChunkLines - 1 ) / ChunkLines;
+        vector<size_t> chunkCounts( chunkCount );
+        retranslate.resize( newCount );
+        ThreadPool::Shared().ParallelFor( chunkCount, [&]( size_t a_chunk, unsigned ) {
+            for( size_t iline = a_chunk * ChunkLines; iline < min( newCount, ( a_chunk + 1 ) * ChunkLines ); iline++ ) {
+                retranslate[iline] = mustTranslate( iline );
+                chunkCounts[a_chunk] += retranslate[iline];
+            }
+        } );
+        size_t count = 0;
+        for( size_t chunk : chunkCounts ) count += chunk;
+        if( count > newCount / 2 ) {
+            m_trans.Clear();
+            m_diags.Clear();
+            m_relocations.clear();
+            PassII();
+            a_change.translated.resize( newCount );
+            for( size_t iline = 0; iline < newCount; iline++ ) a_change.translated[iline] = iline;
+            a_change.passI = true;
+            return true;
+        }
+    }
+    auto translate = [&]( size_t a_line ) { return keep ? mustTranslate( a_line ) : retranslate[a_line] != 0; };
+
+    // Copy the statements that do not change, and translate the others a run of lines at a time.
+    Translation trans;
+    trans.Reserve( newCount );
+    for( size_t iline = 0; iline < newCount; ) {
+        if( !translate( iline ) ) {
+            trans.CopyStatement( m_trans, oldLine( iline ), iline );
+            iline++;
+            continue;
+        }
+        size_t last = iline + 1;
+        while( last < newCount && translate( last ) ) last++;
+        bool reachedEnd = m_endLine < iline;
+        TranslateLines( m_inst, iline, last, reachedEnd, trans, nullptr );
+        for( ; iline < last; iline++ ) a_change.translated.push_back( iline );
+    }
+
+    // Store the words that changed, or all of them.
+    bool storeChanged = keep && m_image.IsDisjoint() && m_image.IsGood();
+    if( storeChanged ) {
+        for( size_t istmt = first; istmt < oldLast; istmt++ ) {
+            if( stmts[istmt].GetNumContents() != 0 ) m_image.Erase( stmts[istmt].GetLocation() );
+        }
+    }
+    m_trans = move( trans );
+    if( storeChanged ) {
+        const vector<TransStmt> &changed = m_trans.GetStatements();
+        for( size_t istmt = first; istmt < newLast && m_image.IsGood(); istmt++ ) {
+            if( !m_image.Store( changed[istmt].GetLocation(), changed[istmt].GetNumContents() ) ) m_image.SetFailed();
+        }
+    }
+    else {
+        m_image.Start( FindSegments() );
+        StoreWords( 0 );
+    }
+
+    // What is about the program as a whole.
+    m_diags.Clear();
+    if( m_endLine == SIZE_MAX ) m_diags.Record( DiagCode::MissingEnd );
+    if( m_module ) {
+        m_relocations.clear();
+        CollectRelocations( 0, nullptr );
+    }
+    a_change.passI = !keep;
+    return true;
+}
+/* bool Assembler::Reassemble( Reassembly &a_change ) */
+
+/**/
+/*
+NAME
+
+        Assembler::LocateLines - finds the locations of a range of lines as Pass I would.
+
+SYNOPSIS
+
+        bool Assembler::LocateLines( bool a_previous, size_t a_first, size_t a_last, int a_loc, ChunkScan &a_scan );
+            a_previous  --> true for the lines of the source before it was reloaded.
+            a_first     --> the index of the first line.
+            a_last      --> the index of the line after the last one.
+            a_loc       --> the location of the first line.
+            a_scan      --> set to the location after the lines, their last numeric operand 1 and their labels.
+
+DESCRIPTION
+
+        This function does what ScanChunk does for the lines that changed, from a location that is known,
+        so that Reassemble can tell whether they move anything.  The lines of the new source are kept in the
+        token cache, which must have room for them.  It stops at the first line whose location cannot be
+        found without the lines before it, or that changes more than the location after it.
+
+RETURNS
+
+        Returns true if the lines were located, and false if Pass I must be run again.
+
+*/
+/**/
+bool Assembler::LocateLines( bool a_previous, size_t a_first, size_t a_last, int a_loc, ChunkScan &a_scan )
+{
+    a_scan = ChunkScan();
+    a_scan.loc = a_loc;
+    for( size_t iline = a_first; iline < a_last; iline++ ) {
+        string_view line = a_previous ? m_facc.GetPreviousLine( iline ) : m_facc.GetLine( iline );
+        Instruction::InstructionType st = m_inst.ParseInstruction( line );
+        if( !a_previous ) m_tokens.Store( iline, m_inst.GetTokens(), a_scan.loc );
+        if( st == Instruction::InstructionType::ST_Comment ) continue;
+
+        Instruction::SymbolicOpCode op = m_inst.GetOpCode();
+        if( st == Instruction::InstructionType::ST_End || op == Instruction::SymbolicOpCode::OC_ORG ) return false;
+        if( m_inst.isNumericOperand1() ) {
+            a_scan.hasOperand = true;
+            a_scan.operand = m_inst.GetOperand1Value();
+        }
+        else if( op == Instruction::SymbolicOpCode::OC_DS ) return false;
+
+        if( m_inst.isLabel() ) a_scan.labels.push_back( { m_inst.GetLabel(), LabelUse::Define, false, a_scan.loc } );
+        if( ( op == Instruction::SymbolicOpCode::OC_EXPORT || op == Instruction::SymbolicOpCode::OC_IMPORT )
+            && Isa::IsValidLabel( m_inst.GetSymbolOperand() ) ) {
+            LabelUse use = op == Instruction::SymbolicOpCode::OC_EXPORT ? LabelUse::Export : LabelUse::Import;
+            a_scan.labels.push_back( { m_inst.GetSymbolOperand(), use, false, a_scan.loc } );
+        }
+        a_scan.loc = m_inst.LocationNextInstruction( a_scan.loc );
+    }
+    return true;
+}
+/* bool Assembler::LocateLines( bool a_previous, size_t a_first, size_t a_last, int a_loc, ChunkScan &a_scan ) */
+
+// Gives the lines up to the next numeric operand 1 a new value of it, unless an org or ds would move with it.
+bool Assembler::CarryOperand( size_t a_line, int a_operand )
+{
+    for( size_t iline = a_line; iline < m_facc.GetLineCount(); iline++ ) {
+        Instruction::Tokens tokens = m_tokens.Load( iline );
+        Instruction::SymbolicOpCode op = tokens.opCode;
+        if( op != Instruction::SymbolicOpCode::OC_COMM && tokens.isNumeric1 ) return true;
+        if( op == Instruction::SymbolicOpCode::OC_ORG || op == Instruction::SymbolicOpCode::OC_DS ) return false;
+        tokens.value1 = a_operand;
+        m_tokens.Store( iline, tokens, m_tokens.GetLocation( iline ) );
+    }
+    return true;
+}
+
+/**/
+/*
+NAME
+
+        Assembler::ListChanges - lists what Reassemble changed.
+
+SYNOPSIS
+
+        void Assembler::ListChanges( const Reassembly &a_change );
+            a_change    --> what Reassemble did.
+
+DESCRIPTION
+
+        A listing sent to a file is written again whole, the symbol table only if Pass I was run again.  A
+        translation listed on standard output is not, since after a small change in a large program it would
+        bury what changed: only the statements of the lines that changed, and those translated again that
+        now have errors, such as references to a label that was removed, are displayed.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::ListChanges( const Reassembly &a_change )
+{
+    if( a_change.passI && m_listSymbols && !m_symbolsPath.empty() ) DisplaySymbolTable();
+    if( !m_listTranslation ) return;
+    if( !m_listingPath.empty() ) {
+        DisplayTranslation();
+        return;
+    }
+
+    Translation changes;
+    vector<string_view> lines;
+    for( size_t istmt : a_change.translated ) {
+        bool inChange = istmt >= a_change.firstChanged && istmt < a_change.lastChanged;
+        if( !inChange && m_trans.GetStatements()[istmt].GetDiagnosticCount() == 0 ) continue;
+        changes.CopyStatement( m_trans, istmt, istmt );
+        lines.push_back( m_facc.GetLine( istmt ) );
+    }
+    ListingWriter out( cout );
+    changes.DisplayStatements( out, lines.data(), 0, Diagnostics::GetMaxErrors() );
+}
+/* void Assembler::ListChanges( const Reassembly &a_change ) */
+
+/**/
+/*
+NAME
+
+        Assembler::DisplaySymbolTable - displays the symbols in the symbol table.
+
+SYNOPSIS
+
+        void Assembler::DisplaySymbolTable( );
+
+DESCRIPTION
+
+        The table is written to standard output, unless SetSymbolTableListing or the VC8000_SYMBOLS
+        environment variable names a file to write it to instead.  Nothing is written if the listing is off.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::DisplaySymbolTable( )
+{
+    PhaseTimer timer( "symtab_display" );
+    ListingWriter out( cout );
+    if( m_listSymbols && OpenListing( out, m_symbolsPath ) ) m_symtab.DisplaySymbolTable( out );
+}
+/* void Assembler::DisplaySymbolTable( ) */
+
+/**/
+/*
+NAME
+
+        Assembler::DisplayTranslation - displays the translation.
+
+SYNOPSIS
+
+        void Assembler::DisplayTranslation( );
+
+DESCRIPTION
+
+        The listing is written to standard output, unless SetTranslationListing or the VC8000_LISTING
+        environment variable names a file to write it to instead, such as a .lst file.  The number of errors
+        listed is limited by VC8000_MAX_ERRORS.  Nothing is written if the listing is off.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::DisplayTranslation( )
+{
+    PhaseTimer timer( "translation_display" );
+    ListingWriter out( cout );
+    if( m_listTranslation && OpenListing( out, m_listingPath ) ) ListTranslation( out );
+}
+/* void Assembler::DisplayTranslation( ) */
+
+// Writes the translation to a listing, with as many errors as VC8000_MAX_ERRORS allows.
+void Assembler::ListTranslation( ListingWriter &a_out ) const
+{
+    m_trans.DisplayTranslation( a_out, m_facc, Diagnostics::GetMaxErrors() );
+}
+
+/**/
+/*
+NAME
+
+        Assembler::OpenListing - sends a listing to a file.
+
+SYNOPSIS
+
+        bool Assembler::OpenListing( ListingWriter &a_out, const string &a_path );
+            a_out       --> the listing.
+            a_path      --> the name of the file, or empty.
+
+DESCRIPTION
+
+        If the path is empty, the listing is left going where it was.  A file that cannot be created is
+        reported on cerr.
+
+RETURNS
+
+        Returns false if the file could not be created, so that the listing should not be written.
+
+*/
+/**/
+bool Assembler::OpenListing( ListingWriter &a_out, const string &a_path )
+{
+    if( a_path.empty() || a_out.Open( a_path ) ) return true;
+    cerr << "Could not create " << a_path << endl;
+    return false;
+}
+/* bool Assembler::OpenListing( ListingWriter &a_out, const string &a_path ) */
+
+// Turn the symbol table listing on or off, and send it to a file if a_path names one.
+void Assembler::SetSymbolTableListing( bool a_on, const string &a_path )
+{
+    m_listSymbols = a_on;
+    if( !a_path.empty() ) m_symbolsPath = a_path;
+}
+
+// Turn the translation listing on or off, and send it to a file if a_path names one.
+void Assembler::SetTranslationListing( bool a_on, const string &a_path )
+{
+    m_listTranslation = a_on;
+    if( !a_path.empty() ) m_listingPath = a_path;
+}
+
+/**/
+/*
+NAME
+
+        Assembler::StoreWords - stores the words of the translation in the memory image, in order.
+
+SYNOPSIS
+
+        void Assembler::StoreWords( size_t a_first );
+            a_first     --> the index of the first statement to store.
+
+DESCRIPTION
+
+        This function stores the machine word of each statement from a_first on at its location, one after
+        another, so that where two statements share a location the later one wins, just as loading the
+        translation into the emulator would.  Once a word is outside memory, the image is marked as failed
+        and no more are stored.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::StoreWords( size_t a_first )
+{
+    if( !m_image.IsGood() ) return;
+
+    const vector<TransStmt> &stmts = m_trans.GetStatements();
+    for( size_t istmt = a_first; istmt < stmts.size(); istmt++ ) {
+        if( !m_image.Store( stmts[istmt].GetLocation(), stmts[istmt].GetNumContents() ) ) {
+            m_image.SetFailed();
+            return;
+        }
+    }
+}
+/* void Assembler::StoreWords( size_t a_first ) */
+
+/**/
+/*
+NAME
+
+        Assembler::CollectRelocations - records the words whose addresses the linker adjusts.
+
+SYNOPSIS
+
+        void Assembler::CollectRelocations( size_t a_first, const string_view *a_lines );
+            a_first     --> the index of the first statement to look at.
+            a_lines     --> the original statements, from that of statement a_first on, or null to take them
+                            from the source.
+
+DESCRIPTION
+
+        A word refers to an address if its statement has a label for an address and no error.  If the label
+        is imported, the word was assembled with address 0, and the linker adds the location of the symbol.
+        Otherwise, if the module is relocatable, the linker adds where it places the module.  The statement
+        is only split into fields again to find which label it is when the module imports some.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::CollectRelocations( size_t a_first, const string_view *a_lines )
+{
+    const bool hasImports = m_symtab.HasImports();
+    if( m_absolute && !hasImports ) return;
+
+    const vector<TransStmt> &stmts = m_trans.GetStatements();
+    for( size_t istmt = a_first; istmt < stmts.size(); istmt++ ) {
+        const TransStmt &stmt = stmts[istmt];
+        const Isa::OpDesc *op = Isa::ByOpCode( stmt.GetOpCode() );
+        if( op == nullptr || op->operand2 != Isa::OperandKind::Label || stmt.GetNumContents() <= 0 ) continue;
+
+        string_view label;
+        if( hasImports ) {
+            string_view line = a_lines != nullptr ? a_lines[istmt - a_first] : m_facc.GetLine( stmt.GetLine() );
+            string_view fields[3];
+            LineScanner::SplitFields( line, fields[0], fields[1], fields[2], label );
+            int loc;
+            if( m_symtab.LookupSymbol( label, loc ) || !m_symtab.IsImported( label ) ) label = string_view();
+        }
+        if( label.empty() && m_absolute ) continue;
+        m_relocations.push_back( { stmt.GetLocation(), string( label ) } );
+    }
+}
+/* void Assembler::CollectRelocations( size_t a_first, const string_view *a_lines ) */
+
+/**/
+/*
+NAME
+
+        Assembler::MakeModule - builds the module the object file holds.
+
+SYNOPSIS
+
+        ObjectFile::Module Assembler::MakeModule( ) const;
+
+DESCRIPTION
+
+        The module has the words of the memory image, the symbols exported and imported, and the
+        relocations Pass II collected, in order of location.  It reaches as far as the program does, or
+        past its last word, whichever is further.
+
+RETURNS
+
+        Returns the module.
+
+*/
+/**/
+ObjectFile::Module Assembler::MakeModule( ) const
+{
+    ObjectFile::Module module;
+    module.relocatable = !m_absolute;
+    for( const pair<string_view, int> &symbol : m_symtab.GetExportedSymbols() ) {
+        module.exports.push_back( { string( symbol.first ), symbol.second } );
+    }
+    for( string_view symbol : m_symtab.GetImportedSymbols() ) module.imports.push_back( string( symbol ) );
+    for( int loc = 0; loc < m_image.GetExtent(); loc++ ) {
+        if( m_image.GetWord( loc ) != 0 ) module.words.push_back( { loc, m_image.GetWord( loc ) } );
+    }
+    module.size = module.words.empty() ? m_highLocation : max( m_highLocation, module.words.back().loc + 1 );
+    module.relocations = m_relocations;
+    stable_sort( module.relocations.begin(), module.relocations.end(),
+        []( const ObjectFile::Relocation &a_lhs, const ObjectFile::Relocation &a_rhs ) {
+            return a_lhs.loc < a_rhs.loc;
+        } );
+    return module;
+}
+/* ObjectFile::Module Assembler::MakeModule( ) const */
+
+/**/
+/*
+NAME
+
+        Assembler::WriteObjectFile - writes the assembled program to an object file.
+
+SYNOPSIS
+
+        bool Assembler::WriteObjectFile( const string &a_path ) const;
+            a_path      --> the name of the object file, or "-" for standard output.
+
+DESCRIPTION
+
+        The program is written from the memory image the passes built, so this must be called before the
+        program is run, which hands the image over to the emulator.  A module is written with what the linker
+        needs to know about it.  A program with a word outside memory cannot be written, and that is reported
+        on cerr, as is a file that cannot be written.
+
+RETURNS
+
+        Returns true if the object file was written, and false otherwise.
+
+*/
+/**/
+bool Assembler::WriteObjectFile( const string &a_path ) const
+{
+    PhaseTimer timer( "object_write" );
+    if( !m_image.IsBuilt() || !m_image.IsGood() ) {
+        cerr << "The program does not fit in memory, so no object file was written." << endl;
+        return false;
+    }
+    bool written = m_module ? ObjectFile::WriteModule( a_path, MakeModule() ) : ObjectFile::Write( a_path, m_image );
+    if( written ) return true;
+    cerr << "Could not write the object file " << a_path << endl;
+    return false;
+}
+/* bool Assembler::WriteObjectFile( const string &a_path ) const */
+
+/**/
+/*
+NAME
+
+        Assembler::RunProgramInEmulator - runs the assembled program.
+
+SYNOPSIS
+
+        bool Assembler::RunProgramInEmulator( bool a_quiet );
+            a_quiet     --> true if success should not be announced.
+
+DESCRIPTION
+
+        The emulator is only made now, so that a program that is only assembled never pays for its memory.
+        It loads the memory image the passes built, as far as the program reaches, rather than the
+        translation statement by statement.  If it stops with an error, the error is displayed.
+        Otherwise "Program terminated successfully." is displayed, unless a_quiet is set.
+
+RETURNS
+
+        Returns true if the program terminated successfully, and false otherwise.
+
+*/
+/**/
+bool Assembler::RunProgramInEmulator( bool a_quiet )
+{
+    if( !m_emul ) m_emul.reset( new emulator );
+
+    bool success;
+    if( m_image.IsBuilt() ) success = m_emul->adoptImage( m_image ) && m_emul->runLoadedProgram();
+    else success = m_emul->runProgram( m_trans );
+
+    if( !success ) m_emul->getDiagnostics().Display( cout );
+    else if( !a_quiet ) cout << "Program terminated successfully.";
+    return success;
+}
+/* bool Assembler::RunProgramInEmulator( bool a_quiet ) */
+
+/**/
+/*
+NAME
+
+        Assembler::InterPass - adds a buffer of user confirmation between passes of the assembler.
+
+SYNOPSIS
+
+        void Assembler::InterPass( );
+
+DESCRIPTION
+
+        This function breaks up the passes and printing of assembler information with lines and user input to clearly
+        delineate each section of code.  The pause only happens when the input is a terminal and the assembler is
+        not in batch mode, so that runs with redirected input are not held up and can be timed end to end.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::InterPass() {
+    // Break up the program passes with user input.
+    cout << "__________________________________________________________\n" << endl;
+    if (m_batch || !isatty(fileno(stdin))) return;
+    cout << "Press Enter to continue...\n" << endl;
+    cin.get();
+}
+/* void Assembler::InterPass() */
+// Get the number of errors found in the program: those of its statements, listed or not, and those
+// about the program as a whole.  Errors from running it are not counted.
+size_t Assembler::GetErrorCount( ) const
+{
+    return ( m_streamed ? m_streamErrors : m_trans.GetDiagnosticCount() ) + m_diags.GetCount();
+}
+
+/**/
+/*
+NAME
+
+        Assembler::WriteDiagnosticsFromEnvironment - writes all the diagnostics as JSON.
+
+SYNOPSIS
+
+        void Assembler::WriteDiagnosticsFromEnvironment( ) const;
+
+DESCRIPTION
+
+        If the VC8000_DIAGNOSTICS environment variable names a file, this function writes the diagnostics of
+        the translation, then those about the program as a whole, then those from running it, to the file as
+        JSON.  The diagnostics of a translation streamed by StreamPassII are those it kept.  A name of "-" writes
+        them to cerr, so that they are kept apart from the listing.  The limit set by VC8000_MAX_ERRORS applies
+        here too.  Failure to write the file is reported on cerr but is not fatal.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Assembler::WriteDiagnosticsFromEnvironment( ) const
+{
+    string path = Instrument::GetEnvironment( "VC8000_DIAGNOSTICS" );
+    if( path.empty() ) return;
+
+    if( path == "-" ) {
+        WriteDiagnostics( cerr );
+        return;
+    }
+    ofstream out( path, ios::out | ios::trunc );
+    if( out ) WriteDiagnostics( out );
+    if( !out ) cerr << "Could not write the diagnostics to " << path << endl;
+}
+/* void Assembler::WriteDiagnosticsFromEnvironment( ) const */
+
+// Writes the diagnostics of the translation, then those about the program as a whole, then those from
+// running it, as JSON, as many as VC8000_MAX_ERRORS allows.
+void Assembler::WriteDiagnostics( ostream &a_out ) const
+{
+    vector<Diagnostic> diags = m_streamed ? m_streamDiags : m_trans.GetDiagnostics();
+    diags.insert( diags.end(), m_diags.GetDiagnostics().begin(), m_diags.GetDiagnostics().end() );
+    if( m_emul ) {
+        const vector<Diagnostic> &runDiags = m_emul->getDiagnostics().GetDiagnostics();
+        diags.insert( diags.end(), runDiags.begin(), runDiags.end() );
+    }
+    Diagnostics::WriteJson( a_out, m_facc, diags, Diagnostics::GetMaxErrors() );
 }
-/* void Assembler::InterPass() */
\ No newline at end of file
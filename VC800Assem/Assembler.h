@@ -4,44 +4,263 @@
 //
 #pragma once 
 
+#include <memory>
+
 #include "SymTab.h"
 #include "Instruction.h"
 #include "FileAccess.h"
 #include "Emulator.h"
 #include "Translation.h"
-#include "Errors.h"
+#include "TokenCache.h"
+#include "Diagnostics.h"
+#include "ListingWriter.h"
+#include "Instrument.h"
+#include "ThreadPool.h"
+#include "ObjectFile.h"
 
 
 class Assembler {
 
 public:
+
+    // What assembling a program again after its source changed did.
+    struct Reassembly {
+        bool changed = false;           // == true if the source had changed.
+        bool passI = false;             // == true if Pass I was run again, since locations or labels changed.
+        size_t firstChanged = 0;        // The index of the first line that changed.
+        size_t lastChanged = 0;         // The index of the line after the last one that changed.
+        vector<size_t> translated;      // The statements translated again, in order.
+    };
+
     Assembler( int argc, char *argv[] );
 
-    // Pass I - establish the locations of the symbols
+    // Assembles the source file a_fileName, or standard input if it is "-".
+    explicit Assembler( const string &a_fileName );
+
+    // Assembles the source file a_fileName, setting a_opened to false, rather than terminating the
+    // program, if it cannot be read.  There is then nothing to assemble.
+    Assembler( const string &a_fileName, bool &a_opened );
+
+    // Assembles a source already in memory, named a_name in its diagnostics.  Nothing is listed unless asked for.
+    Assembler( const string &a_name, string a_text );
+
+    // Pass I - establish the locations of the symbols.  The lines are scanned in chunks on the shared thread pool.
     void PassI( );
 
-    // Pass II - generate a translation
+    // Pass II - generate a translation from the lines Pass I parsed, and store the machine words in the memory
+    // image the emulator runs.  The lines are translated in chunks on the shared thread pool.
     void PassII( );
 
+    // SinglePass - establish the locations of the symbols and generate a translation in one pass
+    // over the source, patching references to labels once they are defined.
+    void SinglePass( );
+
+    // StreamPassI - establish the locations of the symbols, reading the source through once in order and
+    // keeping nothing of it but the symbol table.
+    void StreamPassI( );
+
+    // StreamPassII - translate the source a batch of lines at a time, listing each batch and storing it in the
+    // memory image before the next is read, so that memory does not grow with the size of the program.
+    void StreamPassII( );
+
     // InterPass - adds a buffer of user confirmation between passes of the assembler.
     void InterPass( );
 
-    // Display the symbols in the symbol table.
-    void DisplaySymbolTable() { m_symtab.DisplaySymbolTable(); }
+    // Never wait for the user between passes, even when the input is a terminal.
+    void SetBatch( bool a_batch ) { m_batch = a_batch; }
+
+    // Assemble the program as a module to be linked with others, rather than as a whole program.  Labels it
+    // imports are then left for the linker, and its object file says how to link it.  Set before the passes.
+    void SetModule( bool a_module ) { m_module = a_module; }
+
+    // Turn the symbol table listing on or off, and send it to a file rather than standard output.  An empty
+    // path leaves it where it was, which is the file VC8000_SYMBOLS names, if any.
+    void SetSymbolTableListing( bool a_on, const string &a_path = "" );
+
+    // Turn the translation listing on or off, and send it to a file rather than standard output.  An empty
+    // path leaves it where it was, which is the file VC8000_LISTING names, if any.
+    void SetTranslationListing( bool a_on, const string &a_path = "" );
+
+    // Keep the source in memory of its own, for a program assembled again as it changes.  Set before the passes.
+    void KeepSource( ) { m_facc.Detach(); }
+
+    // Reassemble - assemble the program again after its source has changed, reusing what Pass I and Pass II
+    // found for the lines that did not.  The program must have been assembled by PassI and PassII.
+    bool Reassemble( Reassembly &a_change );
+
+    // List what Reassemble changed: the listings kept in files are written again, and otherwise the
+    // statements of the lines that changed, and those translated again that have errors, are displayed.
+    void ListChanges( const Reassembly &a_change );
+
+    // Get the translation generated by Pass II.
+    Translation &GetTranslation() { return m_trans; }
+
+    // Get the memory image Pass II stored the program in.
+    const MemoryImage &GetImage() const { return m_image; }
+
+    // Display the symbols in the symbol table, or write them to the file set for them.
+    void DisplaySymbolTable();
+
+    // Write the symbol table, or the translation, to a listing of the caller's, whether they are listed or not.
+    void ListSymbolTable( ListingWriter &a_out ) { m_symtab.DisplaySymbolTable( a_out ); }
+    void ListTranslation( ListingWriter &a_out ) const;
+
+    // Display the translation generated by Pass II, or write it to the file set for it.
+    void DisplayTranslation();
+
+    // Write the program in the memory image to an object file.  Returns false if it could not be written.
+    bool WriteObjectFile( const string &a_path ) const;
     
-    // Run emulator on the translation.
-    void RunProgramInEmulator() { 
-        bool success = m_emul.runProgram(m_trans);
-        if (success) cout << "Program terminated successfully.";
-        else Errors::DisplayErrors();
-    }
+    // Run emulator on the program in the memory image.  Returns true if it terminated successfully.
+    bool RunProgramInEmulator( bool a_quiet = false );
+
+    // Get the number of errors found in the program, listed or not.
+    size_t GetErrorCount( ) const;
+
+    // Write all the diagnostics as JSON, if the VC8000_DIAGNOSTICS environment variable names a file.
+    void WriteDiagnosticsFromEnvironment() const;
+
+    // Write all the diagnostics as JSON to a stream.
+    void WriteDiagnostics( ostream &a_out ) const;
 
 private:
 
+    // A reference to a label from a translated statement, kept by single pass mode until the
+    // location of the label is final.  The references to each label form a list through next.
+    struct LabelReference {
+        size_t stmt;            // Index of the referring statement in the translation.
+        int errIndex;           // Where an error from the lookup belongs among the statement's diagnostics.
+        int next;               // Index of the next reference to the same label, or -1.
+        unsigned short column;  // The column of the label in the statement.
+        unsigned short length;  // The length of the label.
+        unsigned char operand;  // The operand the label is: 2 for an address, 1 for the label an export names.
+
+        // The diagnostic for an error in the label.
+        inline Diagnostic MakeDiagnostic( DiagCode a_code ) const {
+            return { a_code, Diagnostics::GetSeverity( a_code ), operand, column, length, Diagnostic::NoLine };
+        }
+    };
+
+    // The number of lines in each chunk that Pass I scans and Pass II translates on its own.
+    static const size_t ChunkLines = 4096;
+
+    // The number of lines in the source for each symbol the symbol table is sized for before a pass.  A line
+    // defines at most one label, but most lines define none, and the table grows if there are more.
+    static const size_t LinesPerSymbol = 16;
+
+    // The number of lines StreamPassII translates before it lists them and loads them into the emulator.
+    static const size_t StreamLines = 4096;
+
+    // What a statement does with a label that Pass I records.
+    enum class LabelUse : unsigned char {
+        Define,             // The label is defined at the statement's location.
+        Import,             // The label is imported from another module.
+        Export              // The label is exported to other modules.
+    };
+
+    // A label found by Pass I in a chunk.
+    struct ChunkLabel {
+        string_view label;  // The label.
+        LabelUse use;       // What the statement does with it.
+        bool absolute;      // == true if loc is absolute, because an org before the label set it.
+        int loc;            // The location of the label, relative to the start of the chunk unless absolute.
+    };
+
+    // What Pass I finds in a chunk of lines, without knowing the lines before it.
+    struct ChunkScan {
+        bool absolute = false;      // == true if an org in the chunk sets the location after it.
+        int loc = 0;                // The location after the chunk, relative to its start unless absolute.
+        size_t relativeEnd = 0;     // The index of the first line whose location is absolute.
+        vector<ChunkLabel> labels;  // The labels defined in the chunk before any end statement, in order.
+        bool hasOperand = false;    // == true if some statement in the chunk has a numeric operand 1.
+        int operand = 0;            // The last numeric operand 1 in the chunk.
+        bool needsOperand = false;  // == true if a location depends on operand 1 of a statement before the chunk.
+        size_t endLine = SIZE_MAX;  // The index of the line with the first end statement in the chunk, if any.
+        bool hasOrg = false;        // == true if the chunk has an org before any end statement.
+        int highRelative = 0;       // The highest location before the first org, relative to the start of the chunk.
+        int highAbsolute = 0;       // The highest location after it, before any end statement.
+    };
+
+    // Scans a chunk of lines for Pass I and keeps them in the token cache.
+    void ScanChunk( Instruction &a_inst, size_t a_chunk, bool a_operandKnown, ChunkScan &a_scan );
+
+    // Translates the lines from a_first up to a_last in order from the token cache, for Pass II, storing their
+    // words in a_image unless it is null.  Returns false if a word could not be stored.
+    bool TranslateLines( Instruction &a_inst, size_t a_first, size_t a_last, bool &a_reachedEnd,
+        Translation &a_trans, MemoryImage *a_image ) const;
+
+    // Records a label Pass I found, in the symbol table.
+    void RecordLabel( string_view a_label, LabelUse a_use, int a_loc );
+
+    // Finds the locations of a range of lines, from a_loc, and the labels they record, as Pass I would, keeping
+    // the lines in the token cache unless they are of the source before it was reloaded.  Returns false if
+    // Pass I must find them, because a line is an org or end, or a ds whose size is an earlier operand.
+    bool LocateLines( bool a_previous, size_t a_first, size_t a_last, int a_loc, ChunkScan &a_scan );
+
+    // Gives the lines from a_line up to the next numeric operand 1 the value a_operand in the token cache, as
+    // Pass I would have.  Returns false if one of them is an org or ds, whose location would move with it.
+    bool CarryOperand( size_t a_line, int a_operand );
+
+    // Finds the segments of the program from the locations Pass I recorded.
+    vector<MemoryImage::Segment> FindSegments( ) const;
+
+    // Records a label defined, or imported, in single pass mode and patches the statements that refer to it.
+    void DefineLabel( int a_id, int a_loc, bool a_import = false );
+
+    // Resolves the address label of a statement translated in single pass mode, or defers it.
+    void ReferenceLabel( int a_id, const LabelReference &a_ref, bool a_final );
+
+    // Reports the labels still referred to but not defined once the symbol table is final.
+    void ResolveFixups( );
+
+    // Sends a listing to a file, if a_path names one.
+    static bool OpenListing( ListingWriter &a_out, const string &a_path );
+
+    // Stores the words of the statements of the translation from a_first on in the memory image, in order.
+    void StoreWords( size_t a_first );
+
+    // Records the words of the statements from a_first on whose addresses the linker adjusts.  The original
+    // statement of statement i is a_lines[i - a_first], or in the source if a_lines is null.
+    void CollectRelocations( size_t a_first, const string_view *a_lines );
+
+    // Builds the module the object file of a module holds.
+    ObjectFile::Module MakeModule( ) const;
+
+    // The translation refers to the source text held by m_facc, so m_facc is declared first and
+    // destroyed last.
     FileAccess m_facc;	    // File Access object
     SymbolTable m_symtab;   // Symbol table object
     Instruction m_inst;	    // Instruction object
     Translation m_trans;    // Translation object
-    emulator m_emul;        // Emulator object
+    unique_ptr<emulator> m_emul;    // Emulator object, made only when the program is run.
+    MemoryImage m_image;    // The memory image Pass II stores the program in.
+    DiagnosticLog m_diags;  // The diagnostics about the program as a whole.
+
+    // Recorded by Pass I for Pass II, so that the lines need not be parsed again.
+    TokenCache m_tokens;                // Every line as parsed by Pass I, with its location.
+    size_t m_endLine = SIZE_MAX;        // The index of the line with the first end statement, if any.
+
+    // The label references kept by single pass mode.  The first reference to each label is found by the
+    // label's symbol table id.
+    vector<LabelReference> m_fixups;    // Label references, in the order they were made.
+    vector<int> m_fixupHeads;           // Index of the latest reference to each label, or -1.
+
+    // Kept by StreamPassII, which does not keep the translation.
+    bool m_streamed = false;            // == true if the translation was streamed by StreamPassII.
+    size_t m_streamErrors = 0;          // The number of errors in the statements it translated.
+    vector<Diagnostic> m_streamDiags;   // The diagnostics of the translation, if VC8000_DIAGNOSTICS asks for them.
+
+    // What the linker needs to know about a module, found by Pass I up to the end statement, and by Pass II.
+    bool m_module = false;              // == true if the program is assembled as a module.
+    bool m_absolute = false;            // == true if an org places the program, so that it cannot be moved.
+    int m_highLocation = 0;             // The highest location the program reaches.
+    vector<ObjectFile::Relocation> m_relocations;   // The words whose addresses the linker adjusts.
+
+    // Where the output goes.
+    bool m_batch = false;               // == true if the user is never waited for.
+    bool m_listSymbols = true;          // == true if the symbol table is listed.
+    bool m_listTranslation = true;      // == true if the translation is listed.
+    string m_symbolsPath;               // The file the symbol table is written to, or empty for standard output.
+    string m_listingPath;               // The file the translation is written to, or empty for standard output.
 };
 
@@ -0,0 +1,327 @@
+//
+//      Implementation of the assembly cache.
+//
+#include "stdafx.h"
+#include "AssemblyCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    // The first line of an entry.
+    const char Header[] = "VC8000 cache 1";
+
+    // Mixes a word into the two halves of a key.  Each half is mixed its own way, so that two inputs that
+    // give the same value for one are not likely to for the other.
+    inline void MixWord( unsigned long long a_word, unsigned long long &a_high, unsigned long long &a_low )
+    {
+        a_high = ( a_high ^ a_word ) * 0x9E3779B97F4A7C15ULL;
+        a_high ^= a_high >> 32;
+        a_low = ( a_low + a_word ) * 0xFF51AFD7ED558CCDULL;
+        a_low ^= a_low >> 29;
+    }
+
+    // Mixes bytes into the two halves of a key, eight at a time, ending with their number so that where
+    // one part of a key ends and the next starts counts too.
+    void MixBytes( string_view a_data, unsigned long long &a_high, unsigned long long &a_low )
+    {
+        size_t i = 0;
+        unsigned long long word;
+        for( ; i + sizeof word <= a_data.size(); i += sizeof word ) {
+            memcpy( &word, a_data.data() + i, sizeof word );
+            MixWord( word, a_high, a_low );
+        }
+        word = 0;
+        memcpy( &word, a_data.data() + i, a_data.size() - i );
+        MixWord( word, a_high, a_low );
+        MixWord( a_data.size(), a_high, a_low );
+    }
+
+    // Finishes one half of a key, so that every bit of it depends on every bit mixed in.
+    inline unsigned long long Finish( unsigned long long a_half )
+    {
+        a_half ^= a_half >> 33;
+        a_half *= 0xC4CEB9FE1A85EC53ULL;
+        a_half ^= a_half >> 33;
+        return a_half;
+    }
+
+    // Describes the assembler that is running by the size and time of its executable, or is empty if
+    // they cannot be found.
+    string ProgramIdentity( )
+    {
+        error_code error;
+#ifdef _WIN32
+        char name[MAX_PATH];
+        fs::path program( string( name, GetModuleFileNameA( nullptr, name, MAX_PATH ) ) );
+#else
+        fs::path program = fs::read_symlink( "/proc/self/exe", error );
+#endif
+        uintmax_t size = fs::file_size( program, error );
+        if( error ) return "";
+        fs::file_time_type time = fs::last_write_time( program, error );
+        if( error ) return "";
+        return to_string( size ) + " " + to_string( time.time_since_epoch().count() );
+    }
+
+    // Takes the next line of a_text from a_pos on, without its newline.  Returns false if there is none.
+    bool NextLine( string_view a_text, size_t &a_pos, string_view &a_line )
+    {
+        size_t end = a_text.find( '\n', a_pos );
+        if( end == string_view::npos ) return false;
+        a_line = a_text.substr( a_pos, end - a_pos );
+        a_pos = end + 1;
+        return true;
+    }
+
+    // Reads a count after a space at the end of a line.  Returns false if there is not one.
+    bool ParseCount( string_view a_line, size_t a_space, size_t &a_count )
+    {
+        if( a_space == string_view::npos || a_space + 1 == a_line.size() ) return false;
+        a_count = 0;
+        for( size_t i = a_space + 1; i < a_line.size(); i++ ) {
+            if( a_line[i] < '0' || a_line[i] > '9' ) return false;
+            a_count = a_count * 10 + ( a_line[i] - '0' );
+        }
+        return true;
+    }
+}
+
+// Uses the cache in a directory, making it if need be.
+AssemblyCache::AssemblyCache( const string &a_dir, long long a_capacity )
+    : m_dir( a_dir ), m_capacity( a_capacity )
+{
+    error_code error;
+    fs::create_directories( m_dir, error );
+    m_open = fs::is_directory( m_dir, error );
+}
+
+/**/
+/*
+NAME
+
+        AssemblyCache::MakeKey - makes the key of a source.
+
+SYNOPSIS
+
+        static string AssemblyCache::MakeKey( string_view a_source, string_view a_options );
+            a_source    --> the bytes of the source.
+            a_options   --> the options the source is assembled under, in any form that tells them apart.
+
+DESCRIPTION
+
+        The key is 128 bits, written in hex, mixed from the options, the size and time of the assembler's
+        executable and then the source, eight bytes at a time so that the source is gone through about as
+        fast as it is read.  It is not a cryptographic hash, since the cache is only shared by those who can
+        write to its directory, but two sources that differ have no practical chance of sharing a key.
+
+RETURNS
+
+        Returns the key.
+
+*/
+/**/
+string AssemblyCache::MakeKey( string_view a_source, string_view a_options )
+{
+    static const string identity = ProgramIdentity();
+
+    unsigned long long high = 0xCBF29CE484222325ULL, low = 0x84222325CBF29CE4ULL;
+    MixBytes( a_options, high, low );
+    MixBytes( identity, high, low );
+    MixBytes( a_source, high, low );
+
+    char key[33];
+    snprintf( key, sizeof key, "%016llx%016llx", Finish( high ), Finish( low ) );
+    return key;
+}
+/* static string AssemblyCache::MakeKey( string_view a_source, string_view a_options ) */
+
+/**/
+/*
+NAME
+
+        AssemblyCache::Lookup - finds what assembling a source produced before.
+
+SYNOPSIS
+
+        bool AssemblyCache::Lookup( const string &a_key, Entry &a_entry ) const;
+            a_key       --> the key of the source.
+            a_entry     --> set to the entry of the key.
+
+DESCRIPTION
+
+        The entry is read whole and checked before any of it is used, and then marked as used now, by its
+        time, so that it is among the last to be removed.  An entry that is not what Store writes is taken
+        as no entry, and so is replaced once the source has been assembled again.
+
+RETURNS
+
+        Returns true if the entry was found, and false if not.
+
+*/
+/**/
+bool AssemblyCache::Lookup( const string &a_key, Entry &a_entry ) const
+{
+    if( !m_open ) return false;
+    string path = EntryPath( a_key );
+    string contents;
+    if( !ReadFile( path, contents ) ) return false;
+
+    string_view text = contents, line;
+    size_t pos = 0, count = 0;
+    if( !NextLine( text, pos, line ) || line != Header ) return false;
+    if( !NextLine( text, pos, line ) || line.substr( 0, 6 ) != "errors" || !ParseCount( line, 6, count ) ) {
+        return false;
+    }
+    a_entry.errors = count;
+    a_entry.files.clear();
+    while( pos < text.size() ) {
+        if( !NextLine( text, pos, line ) ) return false;
+        size_t space = line.find( ' ' );
+        if( !ParseCount( line, space, count ) || count >= text.size() - pos || text[pos + count] != '\n' ) {
+            return false;
+        }
+        a_entry.files[string( line.substr( 0, space ) )] = string( text.substr( pos, count ) );
+        pos += count + 1;
+    }
+
+    error_code error;
+    fs::last_write_time( path, fs::file_time_type::clock::now(), error );
+    return true;
+}
+/* bool AssemblyCache::Lookup( const string &a_key, Entry &a_entry ) const */
+
+/**/
+/*
+NAME
+
+        AssemblyCache::Store - keeps what assembling a source produced.
+
+SYNOPSIS
+
+        void AssemblyCache::Store( const string &a_key, const Entry &a_entry );
+            a_key       --> the key of the source.
+            a_entry     --> what assembling it produced.
+
+DESCRIPTION
+
+        An entry is a line saying what it is, a line with the number of errors, and then each file as a line
+        with its extension and size followed by its contents and a newline.  It is written to a file with a
+        name no other run will pick, and then renamed over the entry of the key, so that anyone reading the
+        entry finds either the old one or the new one whole.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void AssemblyCache::Store( const string &a_key, const Entry &a_entry )
+{
+    if( !m_open ) return;
+    string path = EntryPath( a_key );
+    string temp = path + "." + to_string( random_device()() ) + ".tmp";
+
+    {
+        ofstream out( temp, ios::out | ios::trunc | ios::binary );
+        out << Header << "\nerrors " << a_entry.errors << "\n";
+        for( const auto &file : a_entry.files ) {
+            out << file.first << " " << file.second.size() << "\n";
+            out.write( file.second.data(), file.second.size() );
+            out << "\n";
+        }
+        if( out.flush() ) out.close();
+        if( !out ) {
+            error_code error;
+            fs::remove( temp, error );
+            return;
+        }
+    }
+
+    error_code error;
+    fs::rename( temp, path, error );
+    if( error ) fs::remove( temp, error );
+    else m_stored++;
+}
+/* void AssemblyCache::Store( const string &a_key, const Entry &a_entry ) */
+
+/**/
+/*
+NAME
+
+        AssemblyCache::Trim - keeps the directory to its size.
+
+SYNOPSIS
+
+        void AssemblyCache::Trim( );
+
+DESCRIPTION
+
+        The directory is only looked through by a run that stored something, so that runs served wholly by
+        the cache do no more than they need to.  The entries, and any files left by a run that stopped while
+        writing one, are removed oldest first, by the time they were last used, until the rest fit.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void AssemblyCache::Trim( )
+{
+    if( !m_open || m_stored == 0 ) return;
+
+    struct Item {
+        fs::path path;
+        fs::file_time_type time;
+        long long size;
+    };
+    vector<Item> items;
+    long long total = 0;
+    error_code error;
+    for( const fs::directory_entry &entry : fs::directory_iterator( m_dir, error ) ) {
+        string extension = entry.path().extension().string();
+        if( ( extension != ".entry" && extension != ".tmp" ) || !entry.is_regular_file( error ) ) continue;
+        Item item{ entry.path(), entry.last_write_time( error ), (long long)entry.file_size( error ) };
+        if( error ) continue;
+        items.push_back( item );
+        total += item.size;
+    }
+    if( total <= m_capacity ) return;
+
+    sort( items.begin(), items.end(),
+        []( const Item &a_lhs, const Item &a_rhs ) { return a_lhs.time < a_rhs.time; } );
+    for( const Item &item : items ) {
+        if( total <= m_capacity ) break;
+        if( fs::remove( item.path, error ) ) total -= item.size;
+    }
+}
+/* void AssemblyCache::Trim( ) */
+
+// Reads a whole file, in binary so that what is read is what was written.
+bool AssemblyCache::ReadFile( const string &a_path, string &a_contents )
+{
+    ifstream in( a_path, ios::in | ios::binary );
+    if( !in || !in.seekg( 0, ios::end ) ) return false;
+    a_contents.resize( (size_t)in.tellg() );
+    in.seekg( 0, ios::beg );
+    return (bool)in.read( &a_contents[0], a_contents.size() );
+}
+
+// Writes a whole file, in binary.
+bool AssemblyCache::WriteFile( const string &a_path, string_view a_contents )
+{
+    ofstream out( a_path, ios::out | ios::trunc | ios::binary );
+    out.write( a_contents.data(), a_contents.size() );
+    return (bool)out.flush();
+}
+
+// Gets the path of the entry of a key.
+string AssemblyCache::EntryPath( const string &a_key ) const
+{
+    return ( fs::path( m_dir ) / ( a_key + ".entry" ) ).string();
+}
@@ -0,0 +1,64 @@
+//
+//		Assembly cache, which keeps what assembling a source produced so that it need not be assembled again.
+//
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <string_view>
+
+// A directory of entries, each holding the files one assembly produced and the number of errors it found,
+// named by a key made from the bytes of the source and the options that shape what it assembles to.  A
+// source that has not changed is found by its key and its files are written from the entry, without either
+// pass.  An entry is written to a file of its own first and then renamed, so that a run never reads half
+// an entry, however many runs share the directory.  The entries used least recently are removed when the
+// directory grows past its size.
+class AssemblyCache {
+
+public:
+
+    // What one assembly produced.  The files are named by their extension: "obj", "sym", "lst" or "json".
+    struct Entry {
+        size_t errors = 0;              // The number of errors found in the program.
+        map<string, string> files;      // The contents of each file written.
+    };
+
+    // The most bytes the directory holds if no size is given.
+    static const long long DefaultCapacity = 256LL << 20;
+
+    // Uses the cache in a directory, made if it does not exist, which is kept to at most a_capacity bytes.
+    AssemblyCache( const string &a_dir, long long a_capacity );
+
+    // Returns true if the directory could be made, so that the cache can be used.
+    inline bool IsOpen( ) const { return m_open; }
+
+    // Makes the key of a source assembled under the options described by a_options.  The assembler that
+    // runs is part of it, so that a rebuilt assembler does not use what another one produced.
+    static string MakeKey( string_view a_source, string_view a_options );
+
+    // Looks up the entry of a key.  Returns false if there is none, or it could not be read.
+    bool Lookup( const string &a_key, Entry &a_entry ) const;
+
+    // Stores the entry of a key, replacing any there.  Failure is not reported, since the cache only saves time.
+    void Store( const string &a_key, const Entry &a_entry );
+
+    // Removes the entries used least recently until the directory fits its size, if anything was stored.
+    void Trim( );
+
+    // Reads a whole file.  Returns false if it could not be read.
+    static bool ReadFile( const string &a_path, string &a_contents );
+
+    // Writes a whole file.  Returns false if it could not be written.
+    static bool WriteFile( const string &a_path, string_view a_contents );
+
+private:
+
+    // Gets the path of the entry of a key.
+    string EntryPath( const string &a_key ) const;
+
+    string m_dir;                       // The directory of the entries.
+    long long m_capacity;               // The most bytes the entries may take.
+    bool m_open = false;                // == true if the directory is there.
+    atomic<long long> m_stored{ 0 };    // The number of entries stored by this run.
+};
@@ -0,0 +1,251 @@
+//
+//      Implementation of the diagnostics.
+//
+#include "stdafx.h"
+#include "Diagnostics.h"
+#include "Instrument.h"
+#include "ListingWriter.h"
+
+#include <climits>
+#include <string.h>
+
+namespace {
+
+    // What is known about each code: its name, its severity and its message.  A '#' in a message
+    // stands for the number of the operand.
+    struct DiagInfo {
+        const char *name;
+        Severity severity;
+        const char *message;
+    };
+
+    const DiagInfo Infos[] = {
+        { "extra-operands",         Severity::Error, "Error: extra operands." },
+        { "invalid-operation",      Severity::Error, "Error: invalid operation." },
+        { "missing-operands",       Severity::Error, "Error: missing operands." },
+        { "register-operand",       Severity::Error, "Error: Operand # must be a register number between 0 and 9." },
+        { "label-starts-with-digit", Severity::Error, "Error: Operand # is a label and cannot begin with a digit." },
+        { "label-too-long",         Severity::Error, "Error: Operand # is too long. Labels are a maximum of 10 characters." },
+        { "constant-range",         Severity::Error, "Error: Operand 1 must be a value between -999,999,999 and 999,999,999." },
+        { "storage-range",          Severity::Error, "Error: Operand 1 must be a value between 1 and 999,999." },
+        { "label-not-found",        Severity::Error, "Error: label not found." },
+        { "multiply-defined",       Severity::Error, "Error: multiply defined symbol." },
+        { "multiple-end",           Severity::Error, "Error: Multiple end statements." },
+        { "statement-after-end",    Severity::Error, "Error: Additional statement following end statement." },
+        { "missing-end",            Severity::Error, "Error: Missing end statement." },
+        { "location-out-of-bounds", Severity::Fatal, "Error: location out of bounds." },
+        { "load-failed",            Severity::Fatal, "Program terminated due to error allocating memory." },
+        { "missing-halt",           Severity::Fatal, "Error: missing halt statement. Terminating program." },
+        { "bad-instruction",        Severity::Fatal, "Error: bad instruction reached. Terminating program." },
+        { "division-by-zero",       Severity::Fatal, "Error: division by zero. Terminating program." },
+        { "bad-input",              Severity::Fatal, "Error: input was not an integer between -999,999,999 and 999,999,999. Terminating program." },
+        { "instruction-limit",      Severity::Fatal, "Error: the program ran more instructions than it may. Terminating program." },
+        { "output-limit",           Severity::Fatal, "Error: the program wrote more output than it may. Terminating program." },
+    };
+    static_assert( sizeof( Infos ) / sizeof( Infos[0] ) == (size_t)DiagCode::Count, "Every code must be described." );
+
+    // Writes a string as a JSON string, with its quotes.
+    void WriteJsonString( ostream &a_out, string_view a_str )
+    {
+        a_out << '"';
+        for( char ch : a_str ) {
+            if( ch == '"' || ch == '\\' ) a_out << '\\' << ch;
+            else if( (unsigned char)ch < 0x20 ) {
+                static const char hex[] = "0123456789abcdef";
+                a_out << "\\u00" << hex[( ch >> 4 ) & 0xF] << hex[ch & 0xF];
+            }
+            else a_out << ch;
+        }
+        a_out << '"';
+    }
+}
+
+// Get the severity of a code.
+Severity Diagnostics::GetSeverity( DiagCode a_code )
+{
+    return Infos[(int)a_code].severity;
+}
+
+// Get the short name of a code.
+const char *Diagnostics::GetName( DiagCode a_code )
+{
+    return Infos[(int)a_code].name;
+}
+
+/**/
+/*
+NAME
+
+        Diagnostics::Render - writes the message of a diagnostic.
+
+SYNOPSIS
+
+        void Diagnostics::Render( ostream &a_out, const Diagnostic &a_diag );
+            a_out       --> the stream to write the message to.
+            a_diag      --> the diagnostic.
+
+DESCRIPTION
+
+        This function writes the message of the diagnostic's code, with the number of the operand in
+        place of a '#'.  No newline is written.  The message is written straight to the stream, so
+        rendering it makes no allocations.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Diagnostics::Render( ostream &a_out, const Diagnostic &a_diag )
+{
+    const char *message = Infos[(int)a_diag.code].message;
+    const char *operand = strchr( message, '#' );
+    if( operand == nullptr ) {
+        a_out << message;
+        return;
+    }
+    a_out.write( message, operand - message );
+    a_out << (char)( '0' + a_diag.operand ) << operand + 1;
+}
+/* void Diagnostics::Render( ostream &a_out, const Diagnostic &a_diag ) */
+
+// Write the message of a diagnostic into a listing.
+void Diagnostics::Render( ListingWriter &a_out, const Diagnostic &a_diag )
+{
+    string_view message = Infos[(int)a_diag.code].message;
+    size_t operand = message.find( '#' );
+    if( operand == string_view::npos ) {
+        a_out.Write( message );
+        return;
+    }
+    a_out.Write( message.substr( 0, operand ) );
+    a_out.Write( (char)( '0' + a_diag.operand ) );
+    a_out.Write( message.substr( operand + 1 ) );
+}
+
+/**/
+/*
+NAME
+
+        Diagnostics::GetMaxErrors - gets the largest number of errors to report.
+
+SYNOPSIS
+
+        size_t Diagnostics::GetMaxErrors( );
+
+DESCRIPTION
+
+        The limit is read from the VC8000_MAX_ERRORS environment variable the first time it is needed.
+        It applies to the errors listed with the translation and to the machine-readable output.  A
+        file with thousands of errors then costs little more to list than one without any.
+
+RETURNS
+
+        Returns the limit, or 0 if there is none.
+
+*/
+/**/
+size_t Diagnostics::GetMaxErrors( )
+{
+    static const size_t maxErrors = (size_t)max( 0, atoi( Instrument::GetEnvironment( "VC8000_MAX_ERRORS" ).c_str() ) );
+    return maxErrors;
+}
+/* size_t Diagnostics::GetMaxErrors( ) */
+
+/**/
+/*
+NAME
+
+        Diagnostics::WriteJson - writes diagnostics as JSON.
+
+SYNOPSIS
+
+        void Diagnostics::WriteJson( ostream &a_out, const FileAccess &a_facc, const vector<Diagnostic> &a_diags,
+            size_t a_maxErrors );
+            a_out       --> the stream to write to.
+            a_facc      --> the source file the diagnostics are about.
+            a_diags     --> the diagnostics, in order.
+            a_maxErrors --> the most diagnostics to write, or 0 for all of them.
+
+DESCRIPTION
+
+        This function writes one JSON object holding the name of the source file, the number of
+        diagnostics, the number written, and an array of the diagnostics written.  Each has its code's
+        name, its severity and its message.  One about a statement also has the line and column it
+        starts at, both counted from 1, the length of its span and the text of the span.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Diagnostics::WriteJson( ostream &a_out, const FileAccess &a_facc, const vector<Diagnostic> &a_diags,
+    size_t a_maxErrors )
+{
+    size_t count = ( a_maxErrors == 0 ) ? a_diags.size() : min( a_diags.size(), a_maxErrors );
+
+    a_out << "{\"file\": ";
+    WriteJsonString( a_out, a_facc.GetFileName() );
+    a_out << ", \"count\": " << a_diags.size() << ", \"reported\": " << count << ", \"diagnostics\": [";
+    for( size_t i = 0; i < count; i++ ) {
+        const Diagnostic &diag = a_diags[i];
+        a_out << ( i == 0 ? "\n" : ",\n" ) << "  {\"code\": \"" << GetName( diag.code ) << "\", \"severity\": \""
+            << ( diag.severity == Severity::Fatal ? "fatal" : "error" ) << "\"";
+        if( diag.line != Diagnostic::NoLine ) {
+            a_out << ", \"line\": " << diag.line + 1 << ", \"column\": " << diag.column + 1
+                << ", \"length\": " << diag.length << ", \"text\": ";
+            WriteJsonString( a_out, a_facc.GetLine( diag.line ).substr( diag.column, diag.length ) );
+        }
+        a_out << ", \"message\": \"";
+        Render( a_out, diag );
+        a_out << "\"}";
+    }
+    a_out << "\n]}\n";
+}
+/* void Diagnostics::WriteJson( ostream &a_out, const FileAccess &a_facc, const vector<Diagnostic> &a_diags, size_t a_maxErrors ) */
+
+/**/
+/*
+NAME
+
+        DiagnosticBuffer::Make - makes a diagnostic about a statement.
+
+SYNOPSIS
+
+        Diagnostic DiagnosticBuffer::Make( DiagCode a_code, string_view a_field, int a_operand ) const;
+            a_code      --> what is wrong.
+            a_field     --> the field of the statement it is about, as a view of the statement, or empty
+                            if it is about the whole statement.
+            a_operand   --> the operand the field is, 1 or 2, or 0.
+
+DESCRIPTION
+
+        The span of the diagnostic is where the field is in the statement.  Its line is left for the
+        translation to set.
+
+RETURNS
+
+        Returns the diagnostic.
+
+*/
+/**/
+Diagnostic DiagnosticBuffer::Make( DiagCode a_code, string_view a_field, int a_operand ) const
+{
+    if( a_field.empty() ) a_field = m_statement;
+    size_t column = a_field.data() - m_statement.data();
+    return { a_code, Diagnostics::GetSeverity( a_code ), (unsigned char)a_operand,
+        (unsigned short)min<size_t>( column, USHRT_MAX ), (unsigned short)min<size_t>( a_field.size(), USHRT_MAX ),
+        Diagnostic::NoLine };
+}
+/* Diagnostic DiagnosticBuffer::Make( DiagCode a_code, string_view a_field, int a_operand ) const */
+
+// Displays the messages, one per line.  They are flushed, since a program that fails may not exit cleanly.
+void DiagnosticLog::Display( ostream &a_out ) const
+{
+    for( const Diagnostic &diag : m_diags ) {
+        Diagnostics::Render( a_out, diag );
+        a_out << '\n';
+    }
+    a_out.flush();
+}
@@ -0,0 +1,152 @@
+//
+//		Diagnostics: the errors found while assembling and running a program.
+//
+#pragma once
+
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+#include "FileAccess.h"
+
+class ListingWriter;    // Forward declaration
+
+// The kinds of diagnostic.  Each has a fixed message, so a diagnostic is recorded as its code and the
+// message is only rendered as text when it is printed.
+enum class DiagCode : unsigned char {
+
+    // Errors in a statement.
+    ExtraOperands,              // Error: extra operands.
+    InvalidOperation,           // Error: invalid operation.
+    MissingOperands,            // Error: missing operands.
+    RegisterOperand,            // Error: Operand # must be a register number between 0 and 9.
+    LabelStartsWithDigit,       // Error: Operand # is a label and cannot begin with a digit.
+    LabelTooLong,               // Error: Operand # is too long. Labels are a maximum of 10 characters.
+    ConstantRange,              // Error: Operand 1 must be a value between -999,999,999 and 999,999,999.
+    StorageRange,               // Error: Operand 1 must be a value between 1 and 999,999.
+    LabelNotFound,              // Error: label not found.
+    MultiplyDefined,            // Error: multiply defined symbol.
+    MultipleEnd,                // Error: Multiple end statements.
+    StatementAfterEnd,          // Error: Additional statement following end statement.
+
+    // Errors in the program as a whole.
+    MissingEnd,                 // Error: Missing end statement.
+
+    // Errors while running the program.
+    LocationOutOfBounds,        // Error: location out of bounds.
+    LoadFailed,                 // Program terminated due to error allocating memory.
+    MissingHalt,                // Error: missing halt statement. Terminating program.
+    BadInstruction,             // Error: bad instruction reached. Terminating program.
+    DivisionByZero,             // Error: division by zero. Terminating program.
+    BadInput,                   // Error: input was not an integer between ... Terminating program.
+    InstructionLimit,           // Error: the program ran more instructions than it may. Terminating program.
+    OutputLimit,                // Error: the program wrote more output than it may. Terminating program.
+
+    Count                       // The number of codes.
+};
+
+// How serious a diagnostic is.
+enum class Severity : unsigned char {
+    Error,                      // The statement or program cannot be translated correctly.
+    Fatal                       // The program stopped running.
+};
+
+// One diagnostic.  It refers to the source by line and column, so it holds no text of its own.
+struct Diagnostic {
+
+    static const unsigned NoLine = ~0u;     // The line of a diagnostic about no one statement.
+
+    DiagCode code;              // What is wrong.
+    Severity severity;          // How serious it is.
+    unsigned char operand;      // The operand it is about, 1 or 2, or 0.
+    unsigned short column;      // The column where the span it is about starts, from 0.
+    unsigned short length;      // The length of the span.
+    unsigned line;              // The index of the line, or NoLine.
+};
+
+namespace Diagnostics {
+
+    // Get the severity of a code.
+    Severity GetSeverity( DiagCode a_code );
+
+    // Get the short name of a code, for machine-readable output.
+    const char *GetName( DiagCode a_code );
+
+    // Write the message of a diagnostic.
+    void Render( ostream &a_out, const Diagnostic &a_diag );
+    void Render( ListingWriter &a_out, const Diagnostic &a_diag );
+
+    // Get the largest number of errors to report, from the VC8000_MAX_ERRORS environment variable.
+    // Zero means there is no limit.
+    size_t GetMaxErrors( );
+
+    // Write diagnostics about a source file as JSON.  At most a_maxErrors are written if it is not zero.
+    void WriteJson( ostream &a_out, const FileAccess &a_facc, const vector<Diagnostic> &a_diags,
+        size_t a_maxErrors );
+}
+
+// The diagnostics of one statement.  The room for them is part of the object, so recording one never
+// allocates, and each Instruction has its own, so that statements can be translated on several threads
+// at once.  Spans are given as views of the statement, which is set when the buffer is cleared.
+class DiagnosticBuffer {
+
+public:
+
+    // The most diagnostics one statement can have.
+    static const int Capacity = 8;
+
+    // Clears the diagnostics, for a new statement.
+    inline void Clear( string_view a_statement ) {
+        m_statement = a_statement;
+        m_count = 0;
+    }
+
+    // Records a diagnostic about a field of the statement, or about the whole statement if the field is
+    // empty.  a_operand is the operand the field is, if any.
+    inline void Record( DiagCode a_code, string_view a_field = string_view(), int a_operand = 0 ) {
+        if( m_count < Capacity ) m_diags[m_count++] = Make( a_code, a_field, a_operand );
+    }
+
+    // Makes a diagnostic about a field of the statement without recording it, for one that may be
+    // recorded later.
+    Diagnostic Make( DiagCode a_code, string_view a_field, int a_operand ) const;
+
+    // Returns the number of diagnostics recorded.
+    inline int GetCount( ) const { return m_count; }
+
+    // Returns a diagnostic.  Its line is not set.
+    inline const Diagnostic &Get( int a_index ) const { return m_diags[a_index]; }
+
+private:
+
+    string_view m_statement;            // The statement the spans are in.
+    Diagnostic m_diags[Capacity];       // The diagnostics.
+    int m_count = 0;                    // The number of diagnostics.
+};
+
+// The diagnostics of a run of the assembler or emulator that are not about one statement.
+class DiagnosticLog {
+
+public:
+
+    // Removes all the diagnostics.
+    inline void Clear( ) { m_diags.clear(); }
+
+    // Records a diagnostic that is not about a statement.
+    inline void Record( DiagCode a_code ) {
+        m_diags.push_back( { a_code, Diagnostics::GetSeverity( a_code ), 0, 0, 0, Diagnostic::NoLine } );
+    }
+
+    // Returns the number of diagnostics recorded.
+    inline size_t GetCount( ) const { return m_diags.size(); }
+
+    // Returns the diagnostics, in the order they were recorded.
+    inline const vector<Diagnostic> &GetDiagnostics( ) const { return m_diags; }
+
+    // Displays the messages, one per line.
+    void Display( ostream &a_out ) const;
+
+private:
+
+    vector<Diagnostic> m_diags;         // The diagnostics.
+};
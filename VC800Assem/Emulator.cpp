@@ -1,6 +1,8 @@
 #include "stdafx.h"
-#include "Errors.h"
 #include "Emulator.h"
+#include "Instrument.h"
+#include "Isa.h"
+#include "LineScanner.h"
 
 /**/
 /*
@@ -26,15 +28,16 @@ RETURNS
 */
 /**/
 bool emulator::insertMemory(int a_location, long long a_contents) { 
-    // Check if a_location is within bounds of memory.
-    if (a_location >= emulator::MEMSZ) {
+    // Check if a_location is within bounds of memory.  An org can set a negative location.
+    if (a_location < 0 || a_location >= emulator::MEMSZ) {
         // If not, record the error and return false to indicate failure.
-        Errors::RecordError("Error: location out of bounds.");
+        m_diags.Record(DiagCode::LocationOutOfBounds);
         return false;
     }
 
     // Set the memory location to the contents and indicate success.
     emulator::m_memory[a_location] = a_contents;
+    m_reach = max(m_reach, a_location + 1);
     return true;
 }
 /* bool emulator::insertMemory(int a_location, long long a_contents) */
@@ -43,28 +46,28 @@ bool emulator::insertMemory(int a_location, long long a_contents) {
 /*
 NAME
 
-        emulator::runProgram - emulates the program based on a given translation.
+        emulator::loadProgram - loads a translated program into simulated memory.
 
 SYNOPSIS
 
-        bool emulator::runProgram(Translation &a_trans);
-            a_trans          --> the translated program to emulate.
+        bool emulator::loadProgram(Translation &a_trans);
+            a_trans          --> the translated program to load.
 
 DESCRIPTION
 
-        This function emulates the process of loading the translated program into memory and
-        stepping through each instruction until termination. Any errors are recorded and the
-        program emulation is terminated immediately.
+        This function goes through each translated statement and records its machine code or constant
+        value at the statement's location. Statements without contents are skipped. If any statement
+        cannot be placed in memory, an error is recorded and loading stops.
 
 RETURNS
 
-       Returns true if the program terminated without errors, and false if there was an issue.
+       Returns true if the program was loaded without errors, and false if there was an issue.
 
 */
 /**/
-bool emulator::runProgram(Translation &a_trans) { 
+bool emulator::loadProgram(Translation &a_trans) {
     // Initialize the error recording anew.
-    Errors::InitErrorReporting();
+    m_diags.Clear();
 
     // Go through each translated statement and insert contents.
     for (const TransStmt& stmt : a_trans.GetStatements()) {
@@ -75,10 +78,126 @@ bool emulator::runProgram(Translation &a_trans) {
         bool success = insertMemory(stmt_loc, contents);
 
         if (!success) {
-            Errors::RecordError("Program terminated due to error allocating memory.");
+            m_diags.Record(DiagCode::LoadFailed);
             return false;
         }
     }
+    return true;
+}
+/* bool emulator::loadProgram(Translation &a_trans) */
+
+/**/
+/*
+NAME
+
+        emulator::adoptImage - loads a memory image as the program and frees it.
+
+SYNOPSIS
+
+        bool emulator::adoptImage(MemoryImage &a_image);
+            a_image          --> the image Pass II stored the program in.
+
+DESCRIPTION
+
+        This function does the job of loadProgram for a program whose words Pass II already stored in a
+        memory image.  The words are copied as loadImage copies them, only as far as the program reaches,
+        into memory the constructor has already cleared, so memory is only filled once for a run.  The
+        image is then left empty.  If a word could not be stored, the same errors are recorded as
+        loadProgram records, and the image is left as it is.
+
+RETURNS
+
+       Returns true if the program was loaded, and false if there was an issue.
+
+*/
+/**/
+bool emulator::adoptImage(MemoryImage &a_image) {
+    if (!loadImage(a_image)) return false;
+    a_image.Release();
+    return true;
+}
+/* bool emulator::adoptImage(MemoryImage &a_image) */
+
+/**/
+/*
+NAME
+
+        emulator::loadImage - copies a memory image into memory as the loaded program.
+
+SYNOPSIS
+
+        bool emulator::loadImage(const MemoryImage &a_image);
+            a_image          --> the image the program is stored in, which is left as it is.
+
+DESCRIPTION
+
+        This function does the job of adoptImage for an image that is kept to be run again.  Only the
+        memory the last program could have written is cleared, since the emulator knows how far that is,
+        and then the words of the image are copied, so a small program run after a small program costs
+        little, where filling the whole memory is the largest part of running it.  The registers are
+        cleared too, so that the program starts as it would in a new emulator.
+
+RETURNS
+
+       Returns true if the program was loaded, and false if there was an issue.
+
+*/
+/**/
+bool emulator::loadImage(const MemoryImage &a_image) {
+    PhaseTimer timer("load");
+
+    // Initialize the error recording anew.
+    m_diags.Clear();
+    if (!a_image.IsGood()) {
+        m_diags.Record(DiagCode::LocationOutOfBounds);
+        m_diags.Record(DiagCode::LoadFailed);
+        return false;
+    }
+    int extent = a_image.GetExtent();
+    fill(m_memory.begin() + extent, m_memory.begin() + max(extent, m_reach), 0);
+    for (int loc = 0; loc < extent; loc++) {
+        m_memory[loc] = a_image.GetWord(loc);
+    }
+    fill(m_registers.begin(), m_registers.end(), 0);
+    m_reach = extent;
+    return true;
+}
+/* bool emulator::loadImage(const MemoryImage &a_image) */
+
+// Counts bytes the program writes against the limit on its output, recording an error once it is passed.
+bool emulator::CountOutput(size_t a_bytes) {
+    m_outputBytes += a_bytes;
+    if (m_outputBytes <= m_outputLimit) return true;
+    m_diags.Record(DiagCode::OutputLimit);
+    return false;
+}
+
+/**/
+/*
+NAME
+
+        emulator::executeProgram - executes the program recorded in memory.
+
+SYNOPSIS
+
+        bool emulator::executeProgram();
+
+DESCRIPTION
+
+        This function steps through each instruction in memory, starting at location 100, until the
+        program halts. Any errors are recorded and the program emulation is terminated immediately.
+        The number of instructions executed is recorded for reporting, and a program that executes more
+        than the limit set on them is stopped.
+
+RETURNS
+
+       Returns true if the program terminated without errors, and false if there was an issue.
+
+*/
+/**/
+bool emulator::executeProgram() {
+    m_instructionCount = 0;
+    m_outputBytes = 0;
 
     int loc = 100;
     for (; ; ) {
@@ -88,21 +207,27 @@ bool emulator::runProgram(Translation &a_trans) {
 
         // If there is no instruction here, missing halt statement.
         if (code == 0) {
-            Errors::RecordError("Error: missing halt statement. Terminating program.");
+            m_diags.Record(DiagCode::MissingHalt);
             return false;
         }
         // If the code is negative, there was an error in the instruction.
         else if (code < 0) {
-            Errors::RecordError("Error: bad instruction reached. Terminating program.");
+            m_diags.Record(DiagCode::BadInstruction);
             return false;
         }
 
-        // Extract the opcode.
+        // Extract the opcode.  Only machine language instructions in the instruction set table can be executed.
         Instruction::SymbolicOpCode opcode = (Instruction::SymbolicOpCode)(code / 10000000);
-        if (opcode > Instruction::SymbolicOpCode::OC_HALT || opcode < Instruction::SymbolicOpCode::OC_ADD) {
-            Errors::RecordError("Error: bad instruction reached. Terminating program.");
+        const Isa::OpDesc *op = Isa::ByOpCode(opcode);
+        if (op == nullptr || op->type != Instruction::InstructionType::ST_MachineLanguage) {
+            m_diags.Record(DiagCode::BadInstruction);
             return false;
         }
+        if (m_instructionCount == m_instructionLimit) {
+            m_diags.Record(DiagCode::InstructionLimit);
+            return false;
+        }
+        m_instructionCount++;
 
         // If HALT is reached, program terminates successfully.
         if (opcode == Instruction::SymbolicOpCode::OC_HALT) return true;
@@ -114,8 +239,51 @@ bool emulator::runProgram(Translation &a_trans) {
         if (!success) return success;
     }
 }
+/* bool emulator::executeProgram() */
+
+/**/
+/*
+NAME
+
+        emulator::runProgram - emulates the program based on a given translation.
+
+SYNOPSIS
+
+        bool emulator::runProgram(Translation &a_trans);
+            a_trans          --> the translated program to emulate.
+
+DESCRIPTION
+
+        This function emulates the process of loading the translated program into memory and
+        stepping through each instruction until termination. Any errors are recorded and the
+        program emulation is terminated immediately.  Loading and emulation are recorded as
+        separate phases.
+
+RETURNS
+
+       Returns true if the program terminated without errors, and false if there was an issue.
+
+*/
+/**/
+bool emulator::runProgram(Translation &a_trans) { 
+    // Load the translation into memory.
+    {
+        PhaseTimer timer("load");
+        if (!loadProgram(a_trans)) return false;
+    }
+    return runLoadedProgram();
+}
 /* bool emulator::runProgram(Translation &a_trans) */
 
+// Runs the program already loaded into memory, as the emulation phase.  The instruction count lets the
+// hardware counters be reported per VC8000 instruction.
+bool emulator::runLoadedProgram() {
+    PhaseTimer timer("emulation");
+    bool success = executeProgram();
+    timer.SetEmulatedInstructions(m_instructionCount);
+    return success;
+}
+
 /**/
 /*
 NAME
@@ -131,8 +299,9 @@ SYNOPSIS
 
 DESCRIPTION
 
-        This function switches its functionality based on the extracted opcode. It first extracts required register
-        and address information from the instruction contents, then applies the function for that particular opcode.
+        This function switches its functionality based on the extracted opcode. It first extracts the register
+        and address fields from the instruction contents, as the instruction set table says the instruction is
+        encoded, then applies the function for that particular opcode.
         If any errors are encountered during execution, it returns false.
 
 RETURNS
@@ -142,80 +311,78 @@ RETURNS
 */
 /**/
 bool emulator::ExecuteInstruction(Instruction::SymbolicOpCode a_opcode, long long a_code, int& a_loc) {
-    int reg1;
-    int reg2;
-    int addr;
+    int reg1 = 0;
+    int reg2 = 0;
+    int addr = 0;
+
+    // Extract the fields as the instruction set table says the instruction is encoded.
+    switch (Isa::ByOpCode(a_opcode)->encoding) {
+    case (Isa::Encoding::RegAddr):
+        ExtractRegAddr(a_code, reg1, addr);
+        break;
+    case (Isa::Encoding::RegReg):
+        ExtractRegs(a_code, reg1, reg2);
+        break;
+    default:
+        break;
+    }
 
     // Complete the instruction based on the op code received.
     switch (a_opcode) {
 
-        // Cases with a register and address to extract:
+        // Cases with a register and address:
     case (Instruction::SymbolicOpCode::OC_ADD):     // Add
-        ExtractRegAddr(a_code, reg1, addr);
         Add(reg1, addr, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_SUB):     // Subtract
-        ExtractRegAddr(a_code, reg1, addr);
         Subtract(reg1, addr, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_MULT):    // Multiply
-        ExtractRegAddr(a_code, reg1, addr);
         Multiply(reg1, addr, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_DIV):     // Divide
-        ExtractRegAddr(a_code, reg1, addr);
         if (!Divide(reg1, addr, a_loc)) return false;
     case (Instruction::SymbolicOpCode::OC_LOAD):    // Load
-        ExtractRegAddr(a_code, reg1, addr);
         Load(reg1, addr, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_STORE):   // Store
-        ExtractRegAddr(a_code, reg1, addr);
         Store(reg1, addr, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_BM):      // Branch Minus
-        ExtractRegAddr(a_code, reg1, addr);
         BranchMinus(reg1, addr, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_BZ):      // Branch Zero
-        ExtractRegAddr(a_code, reg1, addr);
         BranchZero(reg1, addr, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_BP):      // Branch Positive
-        ExtractRegAddr(a_code, reg1, addr);
         BranchPositive(reg1, addr, a_loc);
         break;
 
         // Cases with an address and an ignored register:
     case (Instruction::SymbolicOpCode::OC_READ):    // Read
-        ExtractRegAddr(a_code, reg1, addr);
         if (!Read(addr, a_loc)) return false;
         break;
     case (Instruction::SymbolicOpCode::OC_WRITE):   // Write
-        ExtractRegAddr(a_code, reg1, addr);
-        Write(addr, a_loc);
+        if (!Write(addr, a_loc)) return false;
         break;
     case (Instruction::SymbolicOpCode::OC_B):       // Branch
-        ExtractRegAddr(a_code, reg1, addr);
         Branch(addr, a_loc);
         break;
 
         // Cases with two registers.
     case (Instruction::SymbolicOpCode::OC_ADDR):    // Add Reg
-        ExtractRegs(a_code, reg1, reg2);
         AddReg(reg1, reg2, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_SUBR):    // Sub Reg
-        ExtractRegs(a_code, reg1, reg2);
         SubReg(reg1, reg2, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_MULTR):   // Mult Reg
-        ExtractRegs(a_code, reg1, reg2);
         MultReg(reg1, reg2, a_loc);
         break;
     case (Instruction::SymbolicOpCode::OC_DIVR):    // Div Reg
-        ExtractRegs(a_code, reg1, reg2);
         if (!DivReg(reg1, reg2, a_loc)) return false;
+    default:
+        break;
     }
 
     // If the code reached this point, the instruction was executed successfully.
@@ -383,7 +550,7 @@ bool emulator::Divide(int a_reg, int a_addr, int& a_loc) {
 
     // Return false to indicate error if trying to divide by zero.
     if (addr_content == 0) {
-        Errors::RecordError("Error: division by zero. Terminating program.");
+        m_diags.Record(DiagCode::DivisionByZero);
         return false;
     };
 
@@ -465,6 +632,7 @@ void emulator::Store(int a_reg, int a_addr, int& a_loc) {
 
     // Set the address content and next instruction location.
     m_memory[a_addr] = reg_content;
+    m_reach = max(m_reach, a_addr + 1);
     a_loc += 1;
 }
 /* void emulator::Store(int a_reg, int a_addr, int& a_loc); */
@@ -629,7 +797,7 @@ bool emulator::DivReg(int a_reg1, int a_reg2, int& a_loc) {
 
     // Return false to indicate error if trying to divide by zero.
     if (reg2_content == 0) {
-        Errors::RecordError("Error: division by zero. Terminating program.");
+        m_diags.Record(DiagCode::DivisionByZero);
         return false;
     }
 
@@ -659,9 +827,10 @@ SYNOPSIS
 
 DESCRIPTION
 
-        This function prints "? " and awaits a line of input. After receiving a line, it parses it into
-        a number and stores the value at the provided memory location. If the input was invalid, an error is recorded 
-        and the function exits early. The location is updated to the adjacent address in preparation for executing 
+        This function prints "? " and awaits a line of input, from the input set for the program. After receiving a
+        line, it parses it into a number with the line scanner and stores the value at the provided memory location.
+        If the input was invalid, or the prompt passes the limit on output, an error is recorded and the function
+        exits early. The location is updated to the adjacent address in preparation for executing 
         the next instruction.
 
 RETURNS
@@ -673,24 +842,22 @@ RETURNS
 bool emulator::Read(int a_addr, int& a_loc) {
 
     // Print ? to indicate waiting for line input to read.
-    cout << "? ";
+    if (!CountOutput(2)) return false;
+    *m_out << "? ";
 
     // Take and process input into a long long.
     string input;
-    cin >> input;
+    *m_in >> input;
     // Error if not a number, or if out of bounds.
-    if (!isStrNumber(input)) {
-        Errors::RecordError("Error: input was not an integer between -999,999,999 and 999,999,999. Terminating program.");
-        return false;
-    }
-    long long val = stoll(input);
-    if (val > 999'999'999 || val < -999'999'999) {
-        Errors::RecordError("Error: input was not an integer between -999,999,999 and 999,999,999. Terminating program.");
+    int val;
+    if (!LineScanner::ParseNumber(input, val) || val > 999'999'999 || val < -999'999'999) {
+        m_diags.Record(DiagCode::BadInput);
         return false;
     }
 
     // Store the value and set next instruction location.
     m_memory[a_addr] = val;
+    m_reach = max(m_reach, a_addr + 1);
     a_loc += 1;
     return true;
 }
@@ -704,33 +871,36 @@ NAME
 
 SYNOPSIS
 
-        void emulator::Write(int a_addr, int& a_loc);
+        bool emulator::Write(int a_addr, int& a_loc);
             a_addr          --> the address to get the value from.
             a_loc           --> the address of the location to update.
 
 DESCRIPTION
 
-        This function retrieves the contents of a specified memory location and prints them to the console. The location is 
-        then updated to the adjacent address in preparation for executing the next instruction.
+        This function retrieves the contents of a specified memory location and prints them to the console, or the
+        output set for the program. The location is then updated to the adjacent address in preparation for executing
+        the next instruction.
 
 RETURNS
 
-       This function does not return any value.
+       Returns true if the contents were displayed, and false if they would pass the limit on the program's output.
 
 */
 /**/
-void emulator::Write(int a_addr, int& a_loc) {
+bool emulator::Write(int a_addr, int& a_loc) {
     
     // Get the contents of the address.
-    long long addr_content = m_memory[a_addr];
+    string addr_content = to_string(m_memory[a_addr]);
 
     // Display the contents.
-    cout << to_string(addr_content) << endl;
+    if (!CountOutput(addr_content.size() + 1)) return false;
+    *m_out << addr_content << endl;
 
     // Set next instruction location.
     a_loc += 1;
+    return true;
 }
-/* void emulator::Write(int a_addr, int& a_loc); */
+/* bool emulator::Write(int a_addr, int& a_loc); */
 
 /**/
 /*
@@ -870,46 +1040,3 @@ void emulator::BranchPositive(int a_reg, int a_addr, int& a_loc) {
     else a_loc += 1;
 }
 /* void emulator::BranchPositive(int a_reg, int a_addr, int& a_loc); */
-
-/**/
-/*
-NAME
-
-        emulator::isStrNumber - checks if a string represents a number.
-
-SYNOPSIS
-
-        bool emulator::isStrNumber(const string& a_str);
-            a_str          --> the string to be checked.
-
-DESCRIPTION
-
-        This function checks whether the provided string represents a numeric value. It first checks if the string is empty and returns false if so.
-        Then, it examines the string characters, allowing for a leading '-' or '+' sign. If a sign is present, it ensures that there are more
-        characters following it. Finally, the function verifies that all remaining characters are digits.
-
-RETURNS
-
-       Returns true if the provided string represents a numeric value, and false otherwise.
-
-*/
-/**/
-bool emulator::isStrNumber(const string& a_str)
-{
-    if (a_str.empty()) return false;
-
-    // If there is a - or a plus, make sure there are more characters.
-    int ichar = 0;
-    if (a_str[0] == '-' || a_str[0] == '+')
-    {
-        ichar++;
-        if (a_str.length() < 2) return false;
-    }
-    // Make sure that the remaining characters are all digits
-    for (; ichar < a_str.length(); ichar++)
-    {
-        if (!isdigit(a_str[ichar])) return false;
-    }
-    return true;
-}
-/* bool emulator::isStrNumber(const string& a_str) */
\ No newline at end of file
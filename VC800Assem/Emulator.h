@@ -4,13 +4,16 @@
 #ifndef _EMULATOR_H      // UNIX way of preventing multiple inclusions.
 #define _EMULATOR_H
 
+#include <climits>
+
 #include "Translation.h"
+#include "MemoryImage.h"
 
 class emulator {
 
 public:
 
-    const static int MEMSZ = 1'000'000;	// The size of the memory of the VC8000.
+    const static int MEMSZ = MemoryImage::Size;	// The size of the memory of the VC8000.
     const static int REGSZ = 10;        // The number of registers for the VC8000.
 
     emulator() {
@@ -20,14 +23,57 @@ public:
     }
     // Records instructions and data into simulated memory.
     bool insertMemory(int a_location, long long a_contents);
+
+    // Loads the translated program into simulated memory.
+    bool loadProgram(Translation &a_trans);
+
+    // Loads the program of an image Pass II built, and frees the image, which is not needed again.
+    bool adoptImage(MemoryImage &a_image);
+
+    // Copies the words of an image into memory as the loaded program, clearing what the last program left, so
+    // that one emulator can run program after program without filling all of memory each time.
+    bool loadImage(const MemoryImage &a_image);
+
+    // Reads the program's input from a_in and writes its output to a_out, rather than the console.
+    void setStreams(istream &a_in, ostream &a_out) { m_in = &a_in; m_out = &a_out; }
+
+    // Stops a program that executes more than a_instructions instructions, or writes more than a_outputBytes
+    // bytes, recording an error.  Zero is no limit, which is how an emulator starts.
+    void setLimits(long long a_instructions, size_t a_outputBytes) {
+        m_instructionLimit = a_instructions > 0 ? a_instructions : LLONG_MAX;
+        m_outputLimit = a_outputBytes > 0 ? a_outputBytes : SIZE_MAX;
+    }
+
+    // Executes the program recorded in memory, starting at location 100.
+    bool executeProgram();
     
     // Runs the program recorded in memory.
     bool runProgram(Translation &a_trans);
 
+    // Runs the program already loaded into memory.
+    bool runLoadedProgram();
+
+    // Returns the number of VC8000 instructions executed by the last run.
+    long long getInstructionCount() const { return m_instructionCount; }
+
+    // Returns the diagnostics of the last run.
+    const DiagnosticLog &getDiagnostics() const { return m_diags; }
+
 private:
 
     vector<long long> m_memory;  	      // Memory for the VC8000
     vector<long long> m_registers;        // Registers for the VC8000
+    long long m_instructionCount = 0;     // Instructions executed by the last run.
+    DiagnosticLog m_diags;                // The errors of the last run.
+    int m_reach = 0;                      // Memory from here on is known to be zero.
+    istream *m_in = &cin;                 // Where the program's input is read from.
+    ostream *m_out = &cout;               // Where the program's output is written to.
+    long long m_instructionLimit = LLONG_MAX;   // The most instructions a run may execute.
+    size_t m_outputLimit = SIZE_MAX;      // The most bytes a run may write.
+    size_t m_outputBytes = 0;             // The bytes written by the last run.
+
+    // Counts bytes of output against the limit.  Returns false, recording an error, if it is passed.
+    bool CountOutput(size_t a_bytes);
 
     // Extract a register and address from a machine language instruction.
     void ExtractRegAddr(long long a_code, int& a_reg, int& a_addr) {
@@ -44,9 +90,6 @@ private:
     // Extract required information from machine code and execute the instruction.
     bool ExecuteInstruction(Instruction::SymbolicOpCode a_opcode, long long a_code, int& a_loc);
 
-    // Check if a string contains a number. 
-    bool isStrNumber(const string& a_str);
-
 
     // Functions for each operation.
 
@@ -84,7 +127,7 @@ private:
     bool Read(int a_addr, int& a_loc);
 
     // Display the contents of the specified address.
-    void Write(int a_addr, int& a_loc);
+    bool Write(int a_addr, int& a_loc);
 
     // Go to the specified address for the next instruction.
     void Branch(int a_addr, int& a_loc);
@@ -1,5 +0,0 @@
-#include "stdafx.h"
-
-#include "Errors.h"
-
-vector<string> Errors::m_ErrorMsgs;
\ No newline at end of file
@@ -4,6 +4,16 @@
 #include "stdafx.h"
 #include "FileAccess.h"
 
+#include <string.h>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /**/
 /*
 NAME
@@ -31,18 +41,258 @@ FileAccess::FileAccess( int argc, char *argv[] )
         cerr << "Usage: Assem <FileName>" << endl;
         exit( 1 );
     }
-    // Open the file.  One might question if this is the best place to open the file.
-    // One might also question whether we need a file access class.
-    m_sfile.open( argv[1], ios::in );
+    Open( argv[1] );
+}
+/* FileAccess::FileAccess( int argc, char *argv[] ) */
+
+// Opens the file, terminating the program if it cannot be read.
+FileAccess::FileAccess( const string &a_fileName )
+{
+    Open( a_fileName );
+}
+
+// Opens the file, reporting through a_opened whether it could be read, for a caller that has other work
+// to carry on with if it cannot be.
+FileAccess::FileAccess( const string &a_fileName, bool &a_opened )
+{
+    a_opened = OpenSource( a_fileName );
+}
+
+// Takes a source that is already in memory, such as one sent to the assembly server.
+FileAccess::FileAccess( const string &a_fileName, string a_text )
+    : m_fileName( a_fileName ), m_buffer( std::move( a_text ) )
+{
+    m_text = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+/**/
+/*
+NAME
+
+        FileAccess::Open - gets the source text.
+
+SYNOPSIS
+
+        void FileAccess::Open( const string &a_fileName );
+            a_fileName  --> the name of the source file, or "-" for standard input.
+
+DESCRIPTION
+
+        The source is got by OpenSource.  If the file cannot be opened, the error is reported and the
+        program is terminated.
 
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void FileAccess::Open( const string &a_fileName )
+{
     // If the open failed, report the error and terminate.
-    if( ! m_sfile ) {
+    if( ! OpenSource( a_fileName ) ) {
         cerr << "Source file could not be opened, assembler terminated."
             << endl;
-        exit( 1 ); 
+        exit( 1 );
     }
 }
-/* FileAccess::FileAccess( int argc, char *argv[] ) */
+/* void FileAccess::Open( const string &a_fileName ) */
+
+/**/
+/*
+NAME
+
+        FileAccess::OpenSource - gets the source text, reporting whether it could.
+
+SYNOPSIS
+
+        bool FileAccess::OpenSource( const string &a_fileName );
+            a_fileName  --> the name of the source file, or "-" for standard input.
+
+DESCRIPTION
+
+        A regular file is mapped into memory, so it is never copied.  Anything that cannot be mapped,
+        such as a pipe, and standard input when the file name is "-", is read into memory once instead.
+        Either way, lines are handed out as views of the text, and rewinding costs nothing.  A directory
+        can be opened as a stream on some systems but has no text to read, so it is not a source.
+
+RETURNS
+
+        Returns true if the source text was got, and false if the file could not be opened.
+
+*/
+/**/
+bool FileAccess::OpenSource( const string &a_fileName )
+{
+    // Get the source text.  A file that cannot be mapped is read instead.
+    m_fileName = a_fileName;
+    if( a_fileName == "-" ) {
+        ReadStream( cin );
+        return true;
+    }
+    if( MapFile( a_fileName.c_str() ) ) return true;
+
+    error_code error;
+    if( std::filesystem::is_directory( a_fileName, error ) ) return false;
+    ifstream sfile( a_fileName, ios::in | ios::binary );
+    if( ! sfile ) return false;
+    ReadStream( sfile );
+    return true;
+}
+/* bool FileAccess::OpenSource( const string &a_fileName ) */
+
+// Releases the source text.  Views handed out by GetNextLine are no longer valid afterwards.
+FileAccess::~FileAccess()
+{
+    Unmap();
+}
+
+// Releases a mapped source text.
+void FileAccess::Unmap( )
+{
+    if( ! m_mapped ) return;
+#ifdef _WIN32
+    UnmapViewOfFile( m_text );
+#else
+    munmap( (void *)m_text, m_size );
+#endif
+    m_mapped = false;
+}
+
+/**/
+/*
+NAME
+
+        FileAccess::MapFile - maps the source file into memory.
+
+SYNOPSIS
+
+        bool FileAccess::MapFile( const char *a_fileName );
+            a_fileName  --> the name of the source file.
+
+DESCRIPTION
+
+        This function maps the whole file read only.  Only regular, non-empty files are mapped; pipes and
+        devices cannot be, and an empty file has nothing to map.  The file itself is closed again once
+        it is mapped, since the mapping keeps it open.
+
+RETURNS
+
+        Returns true if the file was mapped, and false if it should be read instead.
+
+*/
+/**/
+bool FileAccess::MapFile( const char *a_fileName )
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA( a_fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( file == INVALID_HANDLE_VALUE ) return false;
+
+    LARGE_INTEGER size;
+    if( GetFileType( file ) != FILE_TYPE_DISK || ! GetFileSizeEx( file, &size ) || size.QuadPart == 0 ) {
+        CloseHandle( file );
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    CloseHandle( file );
+    if( mapping == NULL ) return false;
+
+    void *view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    CloseHandle( mapping );
+    if( view == NULL ) return false;
+
+    m_size = (size_t)size.QuadPart;
+#else
+    int fd = open( a_fileName, O_RDONLY );
+    if( fd < 0 ) return false;
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || ! S_ISREG( st.st_mode ) || st.st_size == 0 ) {
+        close( fd );
+        return false;
+    }
+    void *view = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( view == MAP_FAILED ) return false;
+
+    // The source is read from start to finish, twice at most.
+    madvise( view, (size_t)st.st_size, MADV_SEQUENTIAL );
+    m_size = (size_t)st.st_size;
+#endif
+    m_text = (const char *)view;
+    m_mapped = true;
+    return true;
+}
+/* bool FileAccess::MapFile( const char *a_fileName ) */
+
+/**/
+/*
+NAME
+
+        FileAccess::ReadStream - reads the whole of a stream into memory.
+
+SYNOPSIS
+
+        void FileAccess::ReadStream( istream &a_in );
+            a_in        --> the stream to read the source from.
+
+DESCRIPTION
+
+        This function is used for sources that cannot be mapped.  The stream is read to its end in large
+        blocks, so it works for pipes, which cannot be sized or rewound.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void FileAccess::ReadStream( istream &a_in )
+{
+    char block[65536];
+    while( a_in.read( block, sizeof( block ) ) || a_in.gcount() > 0 ) {
+        m_buffer.append( block, (size_t)a_in.gcount() );
+    }
+    m_text = m_buffer.data();
+    m_size = m_buffer.size();
+}
+/* void FileAccess::ReadStream( istream &a_in ) */
+
+/**/
+/*
+NAME
+
+        FileAccess::IndexLines - records the offset of the start of each line.
+
+SYNOPSIS
+
+        void FileAccess::IndexLines( );
+
+DESCRIPTION
+
+        This function finds each newline with memchr.  Every newline ends a line, and text after the last
+        newline is a line of its own, so a file that ends with a newline does not get an empty line at the
+        end.  It is run once, the first time the lines are needed by index.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void FileAccess::IndexLines( ) const
+{
+    size_t pos = 0;
+    while( pos < m_size ) {
+        m_lineStarts.push_back( pos );
+        const void *newline = memchr( m_text + pos, '\n', m_size - pos );
+        if( newline == nullptr ) break;
+        pos = (const char *)newline - m_text + 1;
+    }
+}
+/* void FileAccess::IndexLines( ) const */
 
 /**/
 /*
@@ -52,14 +302,14 @@ NAME
 
 SYNOPSIS
 
-        bool FileAccess::GetNextLine( string &a_line )
-            a_line      --> a reference to a string where the next line from the file will be stored.
+        bool FileAccess::GetNextLine( string_view &a_line )
+            a_line      --> set to a view of the next line of the file.
 
 DESCRIPTION
 
-        This function retrieves the next line from the file. It first checks if there is no more data in the file. If the end of the file (eof) is reached,
-        it returns false to indicate that there are no more lines to read. Otherwise, it reads the next line from the file and stores it in the string parameter
-        passed by reference (a_line). Upon successful retrieval of the line, the function returns true.
+        This function retrieves the next line from the file as a view of the source text, without copying
+        it, and moves the file pointer past it.  The end of the line is found with memchr, so reading the
+        source through does not need the start of every line to be recorded.
 
 
 RETURNS
@@ -68,34 +318,154 @@ RETURNS
 
 */
 /**/
-bool FileAccess::GetNextLine( string &a_line )
+bool FileAccess::GetNextLine( string_view &a_line )
 {
     // If there is no more data, return false.
-    if( m_sfile.eof() ) {
-    
+    if( m_nextOffset >= m_size ) {
+
         return false;
     }
-    getline( m_sfile, a_line );
-    
+    size_t start = m_nextOffset;
+    const void *newline = memchr( m_text + start, '\n', m_size - start );
+    size_t end = newline == nullptr ? m_size : (size_t)( (const char *)newline - m_text );
+    m_nextOffset = newline == nullptr ? m_size : end + 1;
+    if( end > start && m_text[end - 1] == '\r' ) end--;
+    a_line = string_view( m_text + start, end - start );
+
     // Return indicating success.
     return true;
 }
-/* bool FileAccess::GetNextLine( string &a_line ) */
+/* bool FileAccess::GetNextLine( string_view &a_line ) */
 
 /**/
 /*
 NAME
 
-        FileAccess::rewind - rewinds the file to the beginning.
+        FileAccess::GetLine - retrieves a line of the file by its index.
 
 SYNOPSIS
 
-        void FileAccess::rewind( )
+        string_view FileAccess::GetLine( size_t a_index ) const
+            a_index     --> the index of the line, from 0.  It must be less than GetLineCount().
 
 DESCRIPTION
 
-        This function rewinds the file to the beginning. It clears all file flags and sets the file pointer to the beginning of the file (offset 0). 
-        By doing so, it allows subsequent reading operations to start from the beginning of the file.
+        This function returns a view of the line in the source text.  The newline is not part of the
+        line, nor is a carriage return before it, so files with Windows line endings read the same
+        everywhere.
+
+RETURNS
+
+       This function returns the line.
+
+*/
+/**/
+string_view FileAccess::GetLine( size_t a_index ) const
+{
+    call_once( m_indexed, [this] { IndexLines(); } );
+    return LineOf( m_text, m_size, m_lineStarts, a_index );
+}
+/* string_view FileAccess::GetLine( size_t a_index ) const */
+
+// Gets a line of the text before the last reload.
+string_view FileAccess::GetPreviousLine( size_t a_index ) const
+{
+    return LineOf( m_previousText.data(), m_previousText.size(), m_previousStarts, a_index );
+}
+
+// Gets a line of a text, without its newline or a carriage return before it.
+string_view FileAccess::LineOf( const char *a_text, size_t a_size, const vector<size_t> &a_starts, size_t a_index )
+{
+    size_t start = a_starts[a_index];
+    size_t end = a_index + 1 < a_starts.size() ? a_starts[a_index + 1] - 1 : a_size;
+    if( end > start && a_text[end - 1] == '\n' ) end--;
+    if( end > start && a_text[end - 1] == '\r' ) end--;
+    return string_view( a_text + start, end - start );
+}
+
+// Copies a mapped source into memory of its own.  An editor may write the file in place, which would
+// change a mapping of it under the assembler.
+void FileAccess::Detach( )
+{
+    if( ! m_mapped ) return;
+    string text( m_text, m_size );
+    Unmap();
+    m_buffer.swap( text );
+    m_text = m_buffer.data();
+}
+
+/**/
+/*
+NAME
+
+        FileAccess::Reload - reads the file again, after it has changed.
+
+SYNOPSIS
+
+        bool FileAccess::Reload( );
+
+DESCRIPTION
+
+        The file is read into memory rather than mapped, since it is read again because it changes.  The
+        text before is kept, with the start of each of its lines, so that the lines that changed can be
+        found.  The lines of the new text are indexed straight away, so that the index is never built from
+        a mix of the two texts, and the file pointer is put back to the beginning.  The new text is read
+        into memory of its own, and nothing that is kept is touched until the whole of it has been read.
+
+RETURNS
+
+        Returns true if the file was read, and false if it could not be, in which case the text and its
+        lines are as they were.
+
+*/
+/**/
+bool FileAccess::Reload( )
+{
+    ifstream sfile( m_fileName, ios::in | ios::binary | ios::ate );
+    if( m_fileName == "-" || ! sfile ) return false;
+
+    // Read the new text before anything kept is changed, so that a failed read leaves it all as it was.
+    streamoff size = sfile.tellg();
+    if( size < 0 ) return false;
+    string text( (size_t)size, '\0' );
+    sfile.seekg( 0, ios::beg );
+    if( ! sfile.read( &text[0], text.size() ) ) return false;
+
+    // Keep the text before, and its lines.
+    GetLineCount();
+    Detach();
+    m_previousText.swap( m_buffer );
+    m_previousStarts.swap( m_lineStarts );
+
+    // Take the new text, and index its lines.
+    m_buffer.swap( text );
+    m_text = m_buffer.data();
+    m_size = m_buffer.size();
+    m_lineStarts.clear();
+    m_lineStarts.reserve( m_previousStarts.size() + 1 );
+    IndexLines();
+    m_nextOffset = 0;
+    m_released = 0;
+    return true;
+}
+/* bool FileAccess::Reload( ) */
+
+/**/
+/*
+NAME
+
+        FileAccess::ReleaseReadLines - lets the pages of the source already read be dropped from memory.
+
+SYNOPSIS
+
+        void FileAccess::ReleaseReadLines( );
+
+DESCRIPTION
+
+        This function is for reading through a large source once, line after line, in bounded memory.  The
+        whole pages of a mapping before the file pointer are given back to the system, which reads them from
+        the file again if they are touched.  Views of the lines in them stay valid.  A source that was read
+        into memory cannot be released, and neither can a mapping on Windows.
 
 RETURNS
 
@@ -103,10 +473,16 @@ RETURNS
 
 */
 /**/
-void FileAccess::rewind( )
+void FileAccess::ReleaseReadLines( )
 {
-    // Clean all file flags and go back to the beginning of the file.
-    m_sfile.clear();
-    m_sfile.seekg( 0, ios::beg );
+#ifndef _WIN32
+    if( ! m_mapped ) return;
+
+    const size_t pageSize = (size_t)sysconf( _SC_PAGESIZE );
+    size_t end = m_nextOffset / pageSize * pageSize;
+    if( end <= m_released ) return;
+    madvise( (void *)( m_text + m_released ), end - m_released, MADV_DONTNEED );
+    m_released = end;
+#endif
 }
-/* void FileAccess::rewind() */
\ No newline at end of file
+/* void FileAccess::ReleaseReadLines( ) */
@@ -4,33 +4,114 @@
 #ifndef _FILEACCESS_H  // This is the way that multiple inclusions are defended against often used in UNIX
 #define _FILEACCESS_H  // We use pragmas in Visual Studio and g++.  See other include files
 
-#include <fstream>
 #include <stdlib.h>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
+// The whole source is held in memory, either mapped from the file or read in once, and lines are
+// handed out as views of it.  The views stay valid for as long as this object exists.  The start of
+// each line is only recorded the first time a line is asked for by its index, so a source that is
+// only read through once, line after line, takes no memory for it.
 class FileAccess {
 
 public:
 
-    // Opens the file.
+    // Opens the file named on the command line.  A file name of "-" reads the source from standard input.
     FileAccess( int argc, char *argv[] );
 
-    // Closes the file.
-    ~FileAccess()
-    {
-        // Not that necessary in that the file will be closed when the program terminates, but good form.
-        m_sfile.close();
-    }
+    // Opens the file.
+    explicit FileAccess( const string &a_fileName );
+
+    // Opens the file, setting a_opened to false, with the source left empty, if it cannot be read rather
+    // than terminating the program.
+    FileAccess( const string &a_fileName, bool &a_opened );
+
+    // Takes a source that is already in memory, named a_fileName in what is reported about it.
+    FileAccess( const string &a_fileName, string a_text );
+
+    // Releases the source text.
+    ~FileAccess();
+
+    // The views handed out point into the source text, so it must not be copied.
+    FileAccess( const FileAccess & ) = delete;
+    FileAccess &operator=( const FileAccess & ) = delete;
 
     // Get the next line from the source file.  Returns true if there was one.
-    bool GetNextLine( string &a_line );
+    bool GetNextLine( string_view &a_line );
 
     // Put the file pointer back to the beginning of the file.
-    void rewind( );
+    void rewind( ) { m_nextOffset = 0; }
+
+    // Let the pages of a mapped source before the file pointer be dropped from memory.  They are read
+    // from the file again if they are needed.
+    void ReleaseReadLines( );
+
+    // Get the name of the source file, which is "-" for standard input.
+    const string &GetFileName( ) const { return m_fileName; }
+
+    // Get the number of lines in the source file.
+    size_t GetLineCount( ) const {
+        call_once( m_indexed, [this] { IndexLines(); } );
+        return m_lineStarts.size();
+    }
+
+    // Get a line of the source file by its index, from 0.  This does not move the file pointer, so
+    // several threads can get lines at once.
+    string_view GetLine( size_t a_index ) const;
+
+    // Copy a mapped source into memory of its own, so that the text does not change if the file does.
+    void Detach( );
+
+    // Read the file again, after it has changed.  The text read before is kept, until the next reload, so
+    // that it can be compared with the new text; views of it from before are no longer valid.  Returns false,
+    // leaving the text as it was, if the file could not be read.
+    bool Reload( );
+
+    // Get the number of lines in the text before the last reload.
+    size_t GetPreviousLineCount( ) const { return m_previousStarts.size(); }
+
+    // Get a line of the text before the last reload by its index, from 0.
+    string_view GetPreviousLine( size_t a_index ) const;
 
 private:
 
-    ifstream m_sfile;		// Source file object.
+    string m_fileName;              // The name of the source file.
+    const char *m_text = nullptr;   // The source text.
+    size_t m_size = 0;              // The size of the source text in bytes.
+    bool m_mapped = false;          // == true if m_text is a memory mapping of the file.
+    string m_buffer;                // The source text when it could not be mapped.
+    size_t m_nextOffset = 0;        // The offset of the next line to return.
+    size_t m_released = 0;          // The offset up to which the pages of a mapping have been released.
+
+    // The offset of the start of each line, recorded the first time it is needed.
+    mutable vector<size_t> m_lineStarts;
+    mutable once_flag m_indexed;
+
+    // The text before the last reload, and the start of each of its lines.
+    string m_previousText;
+    vector<size_t> m_previousStarts;
+
+    // Maps the file into memory.  Returns false if it cannot be mapped.
+    bool MapFile( const char *a_fileName );
+
+    // Reads the whole of a stream into the buffer.
+    void ReadStream( istream &a_in );
+
+    // Gets the source text, terminating the program if the file cannot be read.
+    void Open( const string &a_fileName );
+
+    // Gets the source text.  Returns false if the file cannot be read.
+    bool OpenSource( const string &a_fileName );
+
+    // Records the offset of the start of each line.
+    void IndexLines( ) const;
+
+    // Releases a mapped source text.
+    void Unmap( );
+
+    // Gets a line of a text from the start of each of its lines.
+    static string_view LineOf( const char *a_text, size_t a_size, const vector<size_t> &a_starts, size_t a_index );
 };
 #endif
-
@@ -0,0 +1,106 @@
+//
+//      Implementation of the file watcher.
+//
+#include "stdafx.h"
+#include "FileWatcher.h"
+
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Starts watching a file, through its directory where inotify is available.
+FileWatcher::FileWatcher( const string &a_path )
+    : m_path( a_path ), m_name( fs::path( a_path ).filename().string() )
+{
+    error_code error;
+    m_written = fs::last_write_time( m_path, error );
+#ifdef __linux__
+    string dir = fs::path( a_path ).parent_path().string();
+    m_fd = inotify_init1( IN_CLOEXEC );
+    if( m_fd >= 0 && inotify_add_watch( m_fd, dir.empty() ? "." : dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO ) < 0 ) {
+        close( m_fd );
+        m_fd = -1;
+    }
+#endif
+}
+
+// Stops watching.
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if( m_fd >= 0 ) close( m_fd );
+#endif
+}
+
+// Returns true if the file can be watched: through inotify where there is one, and otherwise if it is there.
+bool FileWatcher::IsWatching( ) const
+{
+#ifdef __linux__
+    return m_fd >= 0;
+#else
+    error_code error;
+    return fs::exists( m_path, error );
+#endif
+}
+
+/**/
+/*
+NAME
+
+        FileWatcher::WaitForChange - waits until the file has changed.
+
+SYNOPSIS
+
+        bool FileWatcher::WaitForChange( );
+
+DESCRIPTION
+
+        With inotify, the events of the directory are read until one is about the file.  Those already
+        waiting after it are read too, so that a save that writes the file more than once is one change.
+        Otherwise the time the file was last written is looked at every PollMilliseconds until it moves;
+        a file that is missing for a moment, while an editor replaces it, is waited for.
+
+RETURNS
+
+        Returns true once the file has changed, and false if it can no longer be watched.
+
+*/
+/**/
+bool FileWatcher::WaitForChange( )
+{
+#ifdef __linux__
+    alignas( inotify_event ) char buffer[4096];
+    bool changed = false;
+    while( true ) {
+        pollfd pending = { m_fd, POLLIN, 0 };
+        if( changed && poll( &pending, 1, 0 ) <= 0 ) return true;
+
+        ssize_t size = read( m_fd, buffer, sizeof( buffer ) );
+        if( size < 0 && errno == EINTR ) continue;
+        if( size <= 0 ) return changed;
+        for( char *next = buffer; next < buffer + size; ) {
+            const inotify_event *event = (const inotify_event *)next;
+            if( event->len > 0 && m_name == event->name ) changed = true;
+            next += sizeof( inotify_event ) + event->len;
+        }
+    }
+#else
+    while( true ) {
+        this_thread::sleep_for( chrono::milliseconds( PollMilliseconds ) );
+        error_code error;
+        fs::file_time_type written = fs::last_write_time( m_path, error );
+        if( error || written == m_written ) continue;
+        m_written = written;
+        return true;
+    }
+#endif
+}
+/* bool FileWatcher::WaitForChange( ) */
@@ -0,0 +1,42 @@
+//
+//		File watcher, which waits for the source file to change.
+//
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+// Waits for a file to be written.  On Linux the directory of the file is watched with inotify, since most
+// editors save by writing a new file and renaming it over the old one, which a watch on the file itself
+// would lose; a change is a file of that name being closed after writing or renamed into place.  Elsewhere
+// the time the file was last written is polled.
+class FileWatcher {
+
+public:
+
+    // Starts watching a file.
+    explicit FileWatcher( const string &a_path );
+
+    // Stops watching.
+    ~FileWatcher();
+
+    FileWatcher( const FileWatcher & ) = delete;
+    FileWatcher &operator=( const FileWatcher & ) = delete;
+
+    // Returns true if the file can be watched.
+    bool IsWatching( ) const;
+
+    // Waits until the file has changed.  Changes made together, such as by one save, are taken as one.
+    // Returns false if the file can no longer be watched.
+    bool WaitForChange( );
+
+private:
+
+    // How long to wait between looks at a file that is polled, in milliseconds.
+    static const int PollMilliseconds = 100;
+
+    string m_path;                              // The file.
+    string m_name;                              // The name of the file in its directory.
+    int m_fd = -1;                              // The inotify descriptor, or -1 if the file is polled.
+    std::filesystem::file_time_type m_written;  // When a polled file was last written.
+};
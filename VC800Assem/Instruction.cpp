@@ -3,7 +3,9 @@
 #include "Instruction.h"
 #include "SymTab.h"
 #include "TransStmt.h"
-#include "Errors.h"
+#include "Diagnostics.h"
+#include "Isa.h"
+#include "LineScanner.h"
 
 /**/
 /*
@@ -20,8 +22,8 @@ DESCRIPTION
 
         This function computes the location of the next instruction based on the current instruction's OpCode and operands. If the current instruction is an "org"
         (origin) instruction, it sets the location to the value specified by its operand. If it is a "ds" (define storage) instruction, it adds the value of its
-        operand to the current location to determine the next location. Comments and end statements do not consume any space, so their location remains the same
-        as the current location. For all other instructions, the location of the next instruction is one word ahead of the current location.
+        operand to the current location to determine the next location. Comments, end statements, exports and imports do not consume any space, so their location
+        remains the same as the current location. For all other instructions, the location of the next instruction is one word ahead of the current location.
 
 
 RETURNS
@@ -47,8 +49,9 @@ int Instruction::LocationNextInstruction(int a_loc) const {
         return a_loc + m_Operand1NumericValue;
     }
 
-    // Comments and end statements do not take up any space.
-    else if (m_NumOpCode == SymbolicOpCode::OC_COMM || m_NumOpCode == SymbolicOpCode::OC_END) {
+    // Comments, end statements, exports and imports do not take up any space.
+    else if (m_NumOpCode == SymbolicOpCode::OC_COMM || m_NumOpCode == SymbolicOpCode::OC_END
+        || m_NumOpCode == SymbolicOpCode::OC_EXPORT || m_NumOpCode == SymbolicOpCode::OC_IMPORT) {
         return a_loc;
     }
 
@@ -65,16 +68,19 @@ NAME
 
 SYNOPSIS
 
-        Instruction::InstructionType Instruction::ParseInstruction(string a_line);
-            a_line   --> the instruction string to be parsed, passed by value.
+        Instruction::InstructionType Instruction::ParseInstruction(string_view a_line);
+            a_line   --> the instruction to be parsed, as a view of the source text.
 
 DESCRIPTION
 
-        This function parses the instruction provided in the string 'a_line'. It records the original statement, deletes any comment from the line, and
-        records the label, opcode, and operands. Any formatting errors are flagged by the 'isFormatError' boolean variable. If opcode or formatting
-        errors are found, the instruction's error message variable is updated. The function returns the type of the instruction, which is determined
+        This function parses the instruction provided in the string 'a_line'. It records the original statement and
+        records the label, opcode, and operands, ignoring any comment. Any formatting errors are flagged by the 'isFormatError' boolean variable. If opcode or formatting
+        errors are found, they are recorded in the instruction's own error buffer, which is cleared first. The function returns the type of the instruction, which is determined
         based on its opcode and operands. The instruction type is handled within the RecordFields function.
 
+        The original statement and its fields are kept as views rather than copies, so the source text must outlive the
+        translation.  Parsing a line makes no heap allocations unless it has errors to record.
+
 
 
 RETURNS
@@ -83,27 +89,155 @@ RETURNS
 
 */
 /**/
-Instruction::InstructionType Instruction::ParseInstruction(string a_line)
+Instruction::InstructionType Instruction::ParseInstruction(string_view a_line)
 {
     // Record the original statement.  This will be needed in the second pass.
     m_instruction = a_line;
 
-    // Delete any comment from the line.
-    DeleteComment( a_line );
+    // Start the errors of this statement afresh.
+    m_Errors.Clear(a_line);
 
-    // Record label, opcode, and operands.  Up to you to deal with formatting errors.
-    bool isFormatError = RecordFields( a_line );
+    // Record label, opcode, and operands, ignoring any comment.  Up to you to deal with formatting errors.
+    m_IsFormatError = RecordFields( a_line );
+    RecordParseErrors();
+    
+    // Return the instruction type.  This has to be handled in the code.
+    return m_type;
+}
+/* Instruction::InstructionType Instruction::ParseInstruction(string_view a_line) */
 
+/**/
+/*
+NAME
+
+        Instruction::RecordParseErrors - records the errors found while parsing the statement.
+
+SYNOPSIS
+
+        void Instruction::RecordParseErrors();
+
+DESCRIPTION
+
+        This function reports extra fields and an invalid operation, in that order.
+
+RETURNS
+
+       This function does not return any value.
+
+*/
+/**/
+void Instruction::RecordParseErrors()
+{
     // If there was a format error, this means there were extra operands.
-    if (isFormatError) Errors::RecordError("Error: extra operands.");
+    if (m_IsFormatError) m_Errors.Record(DiagCode::ExtraOperands);
 
     // If the opcode is set as an error, report it.
-    if (m_type == InstructionType::ST_Error) Errors::RecordError("Error: invalid operation.");
-    
-    // Return the instruction type.  This has to be handled in the code.
+    if (m_type == InstructionType::ST_Error) m_Errors.Record(DiagCode::InvalidOperation);
+}
+/* void Instruction::RecordParseErrors() */
+
+/**/
+/*
+NAME
+
+        Instruction::GetTokens - gets the fields of the statement last parsed.
+
+SYNOPSIS
+
+        Instruction::Tokens Instruction::GetTokens() const;
+
+DESCRIPTION
+
+        This function returns the fields that the translation of the statement needs, for the token cache.
+        The operands are given by where they are in the line rather than as views, so that they take less
+        room.  The label and op code text are not needed once the op code is known.
+
+RETURNS
+
+       Returns the fields of the statement.
+
+*/
+/**/
+Instruction::Tokens Instruction::GetTokens() const
+{
+    Tokens tokens;
+    tokens.opCode = m_NumOpCode;
+    tokens.formatError = m_IsFormatError;
+
+    // A comment has no operands.  The numeric values of one are left from the statement before.
+    if (m_NumOpCode == SymbolicOpCode::OC_COMM) return tokens;
+
+    tokens.isNumeric1 = m_IsNumericOperand1;
+    tokens.isNumeric2 = m_IsNumericOperand2;
+    tokens.value1 = m_Operand1NumericValue;
+    tokens.value2 = m_Operand2NumericValue;
+    tokens.operand1Start = m_Operand1.empty() ? 0 : (unsigned)(m_Operand1.data() - m_instruction.data());
+    tokens.operand1Length = (unsigned)m_Operand1.size();
+    tokens.operand2Start = m_Operand2.empty() ? 0 : (unsigned)(m_Operand2.data() - m_instruction.data());
+    tokens.operand2Length = (unsigned)m_Operand2.size();
+    return tokens;
+}
+/* Instruction::Tokens Instruction::GetTokens() const */
+
+/**/
+/*
+NAME
+
+        Instruction::SetTokens - restores the fields of a statement parsed before.
+
+SYNOPSIS
+
+        Instruction::InstructionType Instruction::SetTokens(const Tokens &a_tokens, string_view a_line);
+            a_tokens    --> the fields of the statement, from GetTokens.
+            a_line      --> the statement, as a view of the source text.
+
+DESCRIPTION
+
+        This function sets up the instruction as ParseInstruction did when it parsed the line, including the
+        errors it recorded, without parsing the line again.  The instruction can then be translated.  The label
+        and op code text are not restored.
+
+RETURNS
+
+       Returns the instruction's type.
+
+*/
+/**/
+Instruction::InstructionType Instruction::SetTokens(const Tokens &a_tokens, string_view a_line)
+{
+    m_instruction = a_line;
+    m_Errors.Clear(a_line);
+
+    m_Label = m_OpCode = string_view();
+    m_Operand1 = a_line.substr(a_tokens.operand1Start, a_tokens.operand1Length);
+    m_Operand2 = a_line.substr(a_tokens.operand2Start, a_tokens.operand2Length);
+    m_IsNumericOperand1 = a_tokens.isNumeric1;
+    m_IsNumericOperand2 = a_tokens.isNumeric2;
+    m_Operand1NumericValue = a_tokens.value1;
+    m_Operand2NumericValue = a_tokens.value2;
+
+    // Reset error flags
+    m_InvalidOpCode = false;
+    m_InvalidAddr = false;
+    m_InvalidReg1 = false;
+    m_InvalidReg2 = false;
+    m_InvalidValue = false;
+
+    // The type follows from the op code.
+    m_NumOpCode = a_tokens.opCode;
+    const Isa::OpDesc *op = Isa::ByOpCode(m_NumOpCode);
+    if (op != nullptr) m_type = op->type;
+    else if (m_NumOpCode == SymbolicOpCode::OC_COMM) m_type = InstructionType::ST_Comment;
+    else {
+        m_type = InstructionType::ST_Error;
+        m_InvalidOpCode = true;
+    }
+
+    m_IsFormatError = a_tokens.formatError;
+    RecordParseErrors();
     return m_type;
 }
-/* Instruction::InstructionType Instruction::ParseInstruction(string a_line) */
+/* Instruction::InstructionType Instruction::SetTokens(const Tokens &a_tokens, string_view a_line) */
 
 /**/
 /*
@@ -113,14 +247,14 @@ NAME
 
 SYNOPSIS
 
-        bool Instruction::RecordFields(const string& a_line);
-            a_line   --> the instruction string to be parsed.
+        bool Instruction::RecordFields(string_view a_line);
+            a_line   --> the instruction to be parsed.
 
 DESCRIPTION
 
-        This function parses the instruction provided in the string 'a_line' and records the fields that make up the instruction, including the label, opcode, and operands.
-        It also determines whether the operands are numeric and their corresponding values if they are. The opcode is converted to uppercase for comparison.
-        The function uses a map to map opcode labels to their numeric values as defined in the Instruction.h file. If the opcode string cannot be found in the map,
+        This function parses the instruction provided in 'a_line' and records the fields that make up the instruction, including the label, opcode, and operands.
+        The line is split into fields and the operands are converted by the vectorized scanner in LineScanner.h. It also determines whether the operands are numeric and their corresponding values if they are. The opcode is looked up without regard to case
+        in the instruction set table defined in Isa.h, through its perfect hash. If the opcode string cannot be found in the table,
         it indicates an opcode error. Based on the opcode, the function sets the instruction type, indicating whether it is a machine language instruction,
         an assembler instruction, or an end instruction. The function returns a boolean value indicating whether there was a format error while parsing the instruction.
 
@@ -130,7 +264,7 @@ RETURNS
 
 */
 /**/
-bool Instruction::RecordFields(const string& a_line)
+bool Instruction::RecordFields(string_view a_line)
 {
     // Reset error flags
     m_InvalidOpCode = false;
@@ -140,7 +274,7 @@ bool Instruction::RecordFields(const string& a_line)
     m_InvalidValue = false;
 
     // Get the fields that make up the instruction.
-    bool isFormatError = ParseLineIntoFields(a_line, m_Label, m_OpCode, m_Operand1, m_Operand2);
+    bool isFormatError = LineScanner::SplitFields(a_line, m_Label, m_OpCode, m_Operand1, m_Operand2);
 
     // If there was a comment, record the opcode and type before returning.
     if (m_OpCode.empty() && m_Label.empty()) {
@@ -150,177 +284,108 @@ bool Instruction::RecordFields(const string& a_line)
     }
 
     // Record whether the operands are numeric and their value if they are.
-    m_IsNumericOperand1 = isStrNumber(m_Operand1);
-    if (m_IsNumericOperand1) m_Operand1NumericValue = stoi(m_Operand1);
+    m_IsNumericOperand1 = LineScanner::ParseNumber(m_Operand1, m_Operand1NumericValue);
+    m_IsNumericOperand2 = LineScanner::ParseNumber(m_Operand2, m_Operand2NumericValue);
 
-    m_IsNumericOperand2 = isStrNumber(m_Operand2);
-    if (m_IsNumericOperand2) m_Operand2NumericValue = stoi(m_Operand2);
-
-    // For the sake of comparing, convert the op code to upper case.
-    for (char& c : m_OpCode)
-    {
-        c = toupper(c);
-    }
-
-    // Declare a map of the opcode label to the numeric values as defined in Instruction.h.
-    map<string, SymbolicOpCode> opCodeMap = {
-        {"ADD", SymbolicOpCode::OC_ADD},
-        {"SUB", SymbolicOpCode::OC_SUB},
-        {"MULT", SymbolicOpCode::OC_MULT},
-        {"DIV", SymbolicOpCode::OC_DIV},
-        {"LOAD", SymbolicOpCode::OC_LOAD},
-        {"STORE", SymbolicOpCode::OC_STORE},
-        {"ADDR", SymbolicOpCode::OC_ADDR},
-        {"SUBR", SymbolicOpCode::OC_SUBR},
-        {"MULTR", SymbolicOpCode::OC_MULTR},
-        {"DIVR", SymbolicOpCode::OC_DIVR},
-        {"READ", SymbolicOpCode::OC_READ},
-        {"WRITE", SymbolicOpCode::OC_WRITE},
-        {"B", SymbolicOpCode::OC_B},
-        {"BM", SymbolicOpCode::OC_BM},
-        {"BZ", SymbolicOpCode::OC_BZ},
-        {"BP", SymbolicOpCode::OC_BP},
-        {"HALT", SymbolicOpCode::OC_HALT},
-        {"ORG", SymbolicOpCode::OC_ORG},
-        {"DC", SymbolicOpCode::OC_DC},
-        {"DS", SymbolicOpCode::OC_DS},
-        {"END", SymbolicOpCode::OC_END}
-    };
+    // Look up the op code in the instruction set table.  The lookup ignores case.
+    const Isa::OpDesc *op = Isa::Find(m_OpCode);
 
     // If the opcode string cannot be found, this is an opcode error.
-    if (opCodeMap.find(m_OpCode) == opCodeMap.end()) {
+    if (op == nullptr) {
         m_NumOpCode = SymbolicOpCode::OC_ERR;
         m_type = InstructionType::ST_Error;
         m_InvalidOpCode = true;
         return isFormatError;
     }
 
-    // Set m_NumOpCode based on the mapping.
-    m_NumOpCode = opCodeMap[m_OpCode];
-
-    // If the opcode designates a machine language instruction:
-    if (m_NumOpCode <= SymbolicOpCode::OC_HALT) m_type = InstructionType::ST_MachineLanguage;
-
-    // Otherwise, it is either an end instruction or other assembly instruction.
-    else if (m_NumOpCode == SymbolicOpCode::OC_END) m_type = InstructionType::ST_End;
-    else m_type = InstructionType::ST_AssemblerInstr;
+    // Record the op code and the type of instruction: machine language, assembler instruction, or end.
+    m_NumOpCode = op->opCode;
+    m_type = op->type;
 
     // Return whether there was a format error.
     return isFormatError;
 }
-/* bool Instruction::RecordFields(const string& a_line) */
+/* bool Instruction::RecordFields(string_view a_line) */
 
 /**/
 /*
 NAME
 
-        Instruction::ParseLineIntoFields - parse the instruction into fields for label, opcode, and operands.
+        Instruction::Translate - translates an instruction into a machine code statement.
 
 SYNOPSIS
 
-        bool Instruction::ParseLineIntoFields(string a_line, string& a_label, string& a_OpCode, string& a_Operand1, string& a_Operand2);
-            a_line         --> the input line to be parsed.
-            a_label        --> the label of the instruction.
-            a_OpCode       --> the opcode of the instruction.
-            a_Operand1     --> the first operand of the instruction.
-            a_Operand2     --> the second operand of the instruction.
-            a_ErrorMsg     --> the error messages for this instruction.
+        TransStmt Instruction::Translate(int a_loc, size_t a_line, const SymbolTable& a_st);
+            a_loc            --> the location of the instruction.
+            a_line           --> the index of the line of the instruction in the source file.
+            a_st             --> the symbol table used for looking up symbols.
 
 DESCRIPTION
 
-        This function parses the input instruction line into its individual fields, including the label, opcode, and operands. It initializes the provided 
-        string references to empty strings and then extracts the label, opcode, operand1, and operand2 from the input line. The function handles cases where 
-        the input line has no labels and removes any commas. It returns true if there is extra data after parsing, indicating a format error.
+        This function translates the given instruction into a machine code statement using the specified location and symbol table. 
+        The work is done by TranslateFields.
 
 RETURNS
 
-       Returns true if there is extra data after parsing, indicating a format error. Otherwise, returns false.
+       Returns a TransStmt object representing the translated machine code statement.
 
 */
 /**/
-bool Instruction::ParseLineIntoFields(string a_line, string& a_label, string& a_OpCode,
-    string& a_Operand1, string& a_Operand2)
+TransStmt Instruction::Translate(int a_loc, size_t a_line, const SymbolTable& a_st)
 {
-    // Initialize the statement elements to empty strings.
-    a_label = a_OpCode = a_Operand1 = a_Operand2 = "";
-
-    // If this is an empty string, return indicating that it is OK.
-    if (a_line.empty()) return false;
-
-    // Get rid of any commas from the line.
-    replace(a_line.begin(), a_line.end(), ',', ' ');
-
-    // Get the elements of the line.  That is the label, op code, operand1, and operand2.
-    string endStr;
-    istringstream ins(a_line);
-    if (a_line[0] == ' ' || a_line[0] == '\t')
-    {
-        a_label = "";
-        ins >> a_OpCode >> a_Operand1 >> a_Operand2 >> endStr;
-    }
-    else
-    {
-        ins >> a_label >> a_OpCode >> a_Operand1 >> a_Operand2 >> endStr;
-    }
-    // If there is extra data, return true.
-    return ! endStr.empty();
+    int lookupErr;
+    return TranslateFields(a_loc, a_line, &a_st, lookupErr);
 }
-/* bool Instruction::ParseLineIntoFields(string a_line, string& a_label, string& a_OpCode, string& a_Operand1, string& a_Operand2); */
+/* TransStmt Instruction::Translate(int a_loc, size_t a_line, const SymbolTable& a_st); */
 
 /**/
 /*
 NAME
 
-        Instruction::isStrNumber - checks if a string represents a number.
+        Instruction::TranslateDeferred - translates an instruction without looking up its address label.
 
 SYNOPSIS
 
-        bool Instruction::isStrNumber(const string& a_str);
-            a_str          --> the string to be checked.
+        TransStmt Instruction::TranslateDeferred(int a_loc, size_t a_line, int &a_lookupErr);
+            a_loc            --> the location of the instruction.
+            a_line           --> the index of the line of the instruction in the source file.
+            a_lookupErr      --> set to the position among the statement's errors where an error from looking up
+                                 the address label belongs, or -1 if there is no label to look up.
 
 DESCRIPTION
 
-        This function checks whether the provided string represents a numeric value. It first checks if the string is empty and returns false if so. 
-        Then, it examines the string characters, allowing for a leading '-' or '+' sign. If a sign is present, it ensures that there are more 
-        characters following it. Finally, the function verifies that all remaining characters are digits.
+        This function is used by the single pass assembler, which may see a reference to a label before the label
+        is defined.  The instruction is translated as by Translate, but a valid address label is left for the caller
+        to look up with GetAddressLabel.  Until then the statement's address is left unset.  Any error the lookup
+        produces should be inserted at a_lookupErr, so that the errors appear in the same order as from Translate.
 
 RETURNS
 
-       Returns true if the provided string represents a numeric value, and false otherwise.
+       Returns a TransStmt object representing the translated machine code statement.
 
 */
 /**/
-bool Instruction::isStrNumber(const string& a_str)
+TransStmt Instruction::TranslateDeferred(int a_loc, size_t a_line, int &a_lookupErr)
 {
-    if (a_str.empty()) return false;
-
-    // If there is a - or a plus, make sure there are more characters.
-    int ichar = 0;
-    if (a_str[0] == '-' || a_str[0] == '+')
-    {
-        ichar++;
-        if (a_str.length() < 2) return false;
-    }
-    // Make sure that the remaining characters are all digits
-    for (; ichar < a_str.length(); ichar++)
-    {
-        if (!isdigit(a_str[ichar])) return false;
-    }
-    return true;
+    return TranslateFields(a_loc, a_line, nullptr, a_lookupErr);
 }
-/* bool Instruction::isStrNumber(const string& a_str) */
+/* TransStmt Instruction::TranslateDeferred(int a_loc, size_t a_line, int &a_lookupErr) */
 
 /**/
 /*
 NAME
 
-        Instruction::Translate - translates an instruction into a machine code statement.
+        Instruction::TranslateFields - translates the recorded fields into a machine code statement.
 
 SYNOPSIS
 
-        TransStmt Instruction::Translate(int a_loc, SymbolTable& a_st);
+        TransStmt Instruction::TranslateFields(int a_loc, size_t a_line, const SymbolTable *a_st, int &a_lookupErr);
             a_loc            --> the location of the instruction.
-            a_st             --> the symbol table used for looking up symbols.
+            a_line           --> the index of the line of the instruction in the source file.
+            a_st             --> the symbol table used for looking up symbols, or nullptr to leave the lookup
+                                 of the address label to the caller.
+            a_lookupErr      --> set to the position among the statement's errors where an error from looking up
+                                 the address label belongs, or -1 if the label was looked up here or there is none.
 
 DESCRIPTION
 
@@ -335,102 +400,86 @@ RETURNS
 
 */
 /**/
-TransStmt Instruction::Translate(int a_loc, SymbolTable& a_st)
+TransStmt Instruction::TranslateFields(int a_loc, size_t a_line, const SymbolTable *a_st, int &a_lookupErr)
 {
+    a_lookupErr = -1;
+
     // Initialize registers, address, and constant value to -1.
     int reg1 = -1;
     int reg2 = -1;
     int addr = -1;
     int val = -1;
 
-    // Handle register and address assignment based on opcode.
-    switch (m_NumOpCode) {
-
-        // Cases with a register and an address.
-        case (Instruction::SymbolicOpCode::OC_ADD):
-        case (Instruction::SymbolicOpCode::OC_SUB):
-        case (Instruction::SymbolicOpCode::OC_MULT):
-        case (Instruction::SymbolicOpCode::OC_DIV):
-        case (Instruction::SymbolicOpCode::OC_LOAD):
-        case (Instruction::SymbolicOpCode::OC_STORE):
-        case (Instruction::SymbolicOpCode::OC_BM):
-        case (Instruction::SymbolicOpCode::OC_BZ):
-        case (Instruction::SymbolicOpCode::OC_BP):
-        // Cases with an address and an ignored register.
-        case (Instruction::SymbolicOpCode::OC_READ):
-        case (Instruction::SymbolicOpCode::OC_WRITE):
-        case (Instruction::SymbolicOpCode::OC_B):
-            // Record any errors with the operands and set Register 1.
-            RecordErrRegisterAddress();
-            reg1 = m_Operand1NumericValue;
-            // Look up the symbol and indicate if it is missing.
-            if (!m_InvalidAddr && !a_st.LookupSymbol(m_Operand2, addr)) {
-                Errors::RecordError("Error: label not found.");
-                m_InvalidAddr = true;
-            }
-            // Also indicate if the symbol is multiply defined.
-            if (addr == a_st.multiplyDefinedSymbol) {
-                Errors::RecordError("Error: multiply defined symbol.");
-                m_InvalidAddr = true;
-            }
-            break;
-
-        // Cases with two registers.
-        case (Instruction::SymbolicOpCode::OC_ADDR):
-        case (Instruction::SymbolicOpCode::OC_SUBR):
-        case (Instruction::SymbolicOpCode::OC_MULTR):
-        case (Instruction::SymbolicOpCode::OC_DIVR):
-            // Record any errors with the operands and set register values.
-            RecordErrRegisterRegister();
-            reg1 = m_Operand1NumericValue;
-            reg2 = m_Operand2NumericValue;
-            break;
-
-        // Halt case: register and address both ignored.
-        case (Instruction::SymbolicOpCode::OC_HALT):
-            // Record errors if there are unnecessary operands.
-            RecordErrHalt();
-            // Set values to zero for translation.
-            reg1 = 0;
-            addr = 0;
-            break;
-
-        // Define constant case: Set the memory address to a particular value.
-        case (Instruction::SymbolicOpCode::OC_DC):
-            // Record errors with the operands and set the value.
-            RecordErrDC();
-            val = m_Operand1NumericValue;
-            break;
-
-        // Define storage case: Record any errors with the operands.
-        case (Instruction::SymbolicOpCode::OC_DS):
-            RecordErrDS();
-            break;
+    // Check the operands and set the fields of the machine language instruction, as the instruction set
+    // table describes them.  Comments and invalid op codes have no descriptor.
+    const Isa::OpDesc *op = Isa::ByOpCode(m_NumOpCode);
+    if (op != nullptr) {
+        RecordOperandErrors(*op);
+
+        switch (op->encoding) {
+
+            // Cases with a register and an address.
+            case Isa::Encoding::RegAddr:
+                // An instruction without operands (halt) is encoded with a zero register and address.
+                if (op->operand2 != Isa::OperandKind::Label) {
+                    reg1 = 0;
+                    addr = 0;
+                    break;
+                }
+                reg1 = m_Operand1NumericValue;
+                LookupLabel(a_st, m_Operand2, 2, true, addr, a_lookupErr);
+                break;
+
+            // Cases with two registers.
+            case Isa::Encoding::RegReg:
+                reg1 = m_Operand1NumericValue;
+                reg2 = m_Operand2NumericValue;
+                break;
+
+            // Define constant: set the memory address to a particular value.
+            case Isa::Encoding::Constant:
+                val = m_Operand1NumericValue;
+                break;
+
+            // Assembler instructions that only affect the location.  The label an export names must be
+            // defined in the program.
+            case Isa::Encoding::NoContents:
+                if (m_NumOpCode == SymbolicOpCode::OC_EXPORT) LookupLabel(a_st, m_Operand1, 1, false, addr, a_lookupErr);
+                break;
+        }
     }
 
-    // Create the translated statement and set its error values.
-    TransStmt translated = TransStmt(m_NumOpCode, a_loc, m_instruction, reg1, reg2, addr, val);
-    translated.SetErrorCodes(m_InvalidOpCode, m_InvalidReg1, m_InvalidReg2, m_InvalidAddr, m_InvalidValue);
-    return translated;
+    // Create the translated statement with its error values.
+    unsigned char errorFlags = (m_InvalidOpCode ? TransStmt::F_InvalidOpCode : 0)
+        | (m_InvalidReg1 ? TransStmt::F_InvalidReg1 : 0) | (m_InvalidReg2 ? TransStmt::F_InvalidReg2 : 0)
+        | (m_InvalidAddr ? TransStmt::F_InvalidAddr : 0) | (m_InvalidValue ? TransStmt::F_InvalidValue : 0);
+    return TransStmt(m_NumOpCode, a_loc, a_line, reg1, reg2, addr, val, errorFlags);
 }
-/* TransStmt Instruction::Translate(int a_loc, SymbolTable& a_st); */
+/* TransStmt Instruction::TranslateFields(int a_loc, size_t a_line, const SymbolTable *a_st, int &a_lookupErr) */
 
 /**/
 /*
 NAME
 
-        Instruction::RecordErrRegisterAddress - records errors for operations that use a register and address.
+        Instruction::LookupLabel - looks up a label operand in the symbol table.
 
 SYNOPSIS
 
-        void Instruction::RecordErrRegisterAddress();
+        void Instruction::LookupLabel(const SymbolTable *a_st, string_view a_label, int a_operand,
+            bool a_allowImport, int &a_addr, int &a_lookupErr);
+            a_st             --> the symbol table, or nullptr to leave the lookup to the caller.
+            a_label          --> the label.
+            a_operand        --> the number of the operand the label is, for error messages.
+            a_allowImport    --> true if the label may be imported from another module.
+            a_addr           --> set to the location of the label.
+            a_lookupErr      --> set to the position among the statement's errors where an error from the
+                                 lookup belongs, if it is left to the caller.
 
 DESCRIPTION
 
-        This function checks the validity of the register and address operands in the instruction. It verifies that Operand 2 
-        exists, follows label conventions, and has an appropriate length. Additionally, it checks Operand 1 to ensure it is 
-        numeric and within the range of 0 to 9. If any errors are encountered during validation, appropriate error messages 
-        are set, and corresponding error flags are updated to indicate the presence of errors.
+        Nothing is looked up if the label is already known to be invalid.  A label that is not defined is
+        reported as not found, unless it is imported and imports are allowed, in which case its address is
+        left as 0 for the linker to fill in.  A label that is multiply defined is reported as such.
 
 RETURNS
 
@@ -438,48 +487,51 @@ RETURNS
 
 */
 /**/
-void Instruction::RecordErrRegisterAddress() {
-    // Check Operand 2: should exist and follow label conventions.
-    if (m_Operand2.empty()) {
-        Errors::RecordError("Error: missing operands.");
-        m_InvalidAddr = true;
+void Instruction::LookupLabel(const SymbolTable *a_st, string_view a_label, int a_operand, bool a_allowImport,
+    int &a_addr, int &a_lookupErr)
+{
+    if (m_InvalidAddr) return;
+
+    // If there is no symbol table, the caller looks up the symbol.
+    if (a_st == nullptr) {
+        a_lookupErr = m_Errors.GetCount();
+        return;
     }
-    else if (isdigit(m_Operand2[0])) {
-        Errors::RecordError("Error: Operand 2 is a label and cannot begin with a digit.");
+
+    // Look up the symbol and indicate if it is missing.
+    if (!a_st->LookupSymbol(a_label, a_addr)) {
+        if (a_allowImport && a_st->IsImported(a_label)) {
+            a_addr = 0;
+            return;
+        }
+        m_Errors.Record(DiagCode::LabelNotFound, a_label, a_operand);
         m_InvalidAddr = true;
     }
-    if (m_Operand2.length() > 10) {
-        Errors::RecordError("Error: Operand 2 is too long. Labels are a maximum of 10 characters.");
+    // Also indicate if the symbol is multiply defined.
+    else if (a_addr == a_st->multiplyDefinedSymbol) {
+        m_Errors.Record(DiagCode::MultiplyDefined, a_label, a_operand);
         m_InvalidAddr = true;
     }
-
-    // Check Operand 1: should be numeric and between 0 and 9. 
-    if (m_Operand1.empty()) {
-        m_InvalidReg1 = true;
-        return;         // Note: If operand 1 is missing, already logged error with Operand 2 check.
-    }
-    if (!m_IsNumericOperand1 || m_Operand1NumericValue > 9 || m_Operand1NumericValue < 0) {
-        Errors::RecordError("Error: Operand 1 must be a register number between 0 and 9.");
-        m_InvalidReg1 = true;
-    }
 }
-/* void Instruction::RecordErrRegisterAddress() */
+/* void Instruction::LookupLabel(const SymbolTable *a_st, string_view a_label, int a_operand, bool a_allowImport, int &a_addr, int &a_lookupErr) */
 
 /**/
 /*
 NAME
 
-        Instruction::RecordErrRegisterRegister - records errors for operations that use two registers.
+        Instruction::RecordOperandErrors - records errors in the operands of an instruction.
 
 SYNOPSIS
 
-        void Instruction::RecordErrRegisterRegister();
+        void Instruction::RecordOperandErrors(const Isa::OpDesc &a_op);
+            a_op        --> the descriptor of the instruction's op code.
 
 DESCRIPTION
 
-        This function checks the validity of the register operands in the instruction. It verifies that both operands exist,
-        are numeric, and are within the range of 0 to 9. If any errors are encountered during validation, appropriate error 
-        messages are set, and corresponding error flags are updated to indicate the presence of errors.
+        This function checks each operand against what the instruction set table says it must be.  Operand 2 is
+        checked first and then operand 1, so that errors are reported in that order.  An operand that is missing
+        is reported once as missing operands, and operands that should not be there are reported once as extra
+        operands.  The flag for each part of the machine language instruction that has an error is set.
 
 RETURNS
 
@@ -487,121 +539,105 @@ RETURNS
 
 */
 /**/
-void Instruction::RecordErrRegisterRegister() {
-    // Check Operand 2: should exist and be numeric between 0 and 9.
-    if (m_Operand2.empty()) {
-        Errors::RecordError("Error: missing operands.");
-        m_InvalidReg2 = true;
-    }
-    else if (!m_IsNumericOperand2 || m_Operand2NumericValue > 9 || m_Operand2NumericValue < 0) {
-        Errors::RecordError("Error: Operand 2 must be a register number between 0 and 9.");
-        m_InvalidReg2 = true;
-    }
+void Instruction::RecordOperandErrors(const Isa::OpDesc &a_op)
+{
+    bool missingReported = false;       // == true once missing operands have been reported.
+    bool extraReported = false;         // == true once extra operands have been reported.
 
-    // Check Operand 1: should be numeric and between 0 and 9.
-    if (m_Operand1.empty()) {
-        m_InvalidReg1 = true;
-        return;
+    if (!CheckOperand(a_op, a_op.operand2, 2, m_Operand2, m_IsNumericOperand2, m_Operand2NumericValue,
+        missingReported, extraReported)) {
+        if (a_op.operand2 == Isa::OperandKind::Register) m_InvalidReg2 = true;
+        else if (a_op.operand2 == Isa::OperandKind::Label) m_InvalidAddr = true;
     }
-    if (!m_IsNumericOperand1 || m_Operand1NumericValue > 9 || m_Operand1NumericValue < 0) {
-        m_InvalidReg1 = true;
-        Errors::RecordError("Error: Operand 1 must be a register number between 0 and 9.");
+    if (!CheckOperand(a_op, a_op.operand1, 1, m_Operand1, m_IsNumericOperand1, m_Operand1NumericValue,
+        missingReported, extraReported)) {
+        if (a_op.operand1 == Isa::OperandKind::Register) m_InvalidReg1 = true;
+        else if (a_op.operand1 == Isa::OperandKind::Value) m_InvalidValue = true;
+        else if (a_op.operand1 == Isa::OperandKind::Label) m_InvalidAddr = true;
     }
 }
-/* void Instruction::RecordErrRegisterRegister() */
+/* void Instruction::RecordOperandErrors(const Isa::OpDesc &a_op) */
 
 /**/
 /*
 NAME
 
-        Instruction::RecordErrHalt - records errors for the halt operation.
+        Instruction::CheckOperand - checks one operand of an instruction and records any errors.
 
 SYNOPSIS
 
-        void Instruction::RecordErrHalt();
+        bool Instruction::CheckOperand(const Isa::OpDesc &a_op, Isa::OperandKind a_kind, int a_number,
+            string_view a_operand, bool a_isNumeric, int a_value, bool &a_missingReported, bool &a_extraReported);
+            a_op                --> the descriptor of the instruction's op code.
+            a_kind              --> what the operand must be.
+            a_number            --> the number of the operand, 1 or 2, for error messages.
+            a_operand           --> the operand.
+            a_isNumeric         --> true if the operand is a number.
+            a_value             --> the value of the operand if it is a number.
+            a_missingReported   --> true if missing operands were already reported; set if they are now.
+            a_extraReported     --> true if extra operands were already reported; set if they are now.
 
 DESCRIPTION
 
-        This function checks the validity of a halt operation by ensuring that there are no operands. If any 
-        errors are encountered during validation, appropriate error messages are set, and corresponding error 
-        flags are updated to indicate the presence of errors.
+        A register must be a number from 0 to 9.  A label must not begin with a digit and must be at most 10
+        characters long; both errors are reported if both apply.  A value must be a number within the range
+        given by the descriptor.  An absent operand must be empty.
 
 RETURNS
 
-       This function does not return any value.
+       Returns false if the operand has an error that makes it unusable in the translation, and true otherwise.
 
 */
 /**/
-void Instruction::RecordErrHalt() {
-    // Operands 1 and 2 should both be empty.
-    if (!m_Operand1.empty() || !m_Operand2.empty()) Errors::RecordError("Error: extra operands.");
-}
-/* void Instruction::RecordErrHalt() */
-
-/**/
-/*
-NAME
-
-        Instruction::RecordErrDC - records errors for define constant operations.
-
-SYNOPSIS
-
-        void Instruction::RecordErrDC();
-
-DESCRIPTION
-
-        This function checks the validity of the operands in the define constant instruction. It verifies that only one operand
-        exists, it is numeric, and is within the allowed range of values. If any errors are encountered during validation, 
-        appropriate error messages are set, and corresponding error flags are updated to indicate the presence of errors.
-
-RETURNS
-
-       This function does not return any value.
-
-*/
-/**/
-void Instruction::RecordErrDC() {
-    // Operand 2 should be empty.
-    if (!m_Operand2.empty()) Errors::RecordError("Error: extra operands.");
-
-    // Constants must be numeric and between -999,999,999 and 999,999,999
-    if (!m_IsNumericOperand1 || abs(m_Operand1NumericValue) > 999'999'999) {
-        m_InvalidValue = true;
-        Errors::RecordError("Error: Operand 1 must be a value between -999,999,999 and 999,999,999.");
+bool Instruction::CheckOperand(const Isa::OpDesc &a_op, Isa::OperandKind a_kind, int a_number,
+    string_view a_operand, bool a_isNumeric, int a_value, bool &a_missingReported, bool &a_extraReported)
+{
+    // Required operands that are missing are only reported once, whichever operand is checked first.
+    bool required = a_kind == Isa::OperandKind::Register || a_kind == Isa::OperandKind::Label;
+    if (required && a_operand.empty()) {
+        if (!a_missingReported) m_Errors.Record(DiagCode::MissingOperands);
+        a_missingReported = true;
+        return false;
     }
-}
-/* void Instruction::RecordErrDC() */
 
-/**/
-/*
-NAME
-
-        Instruction::RecordErrDS - records errors for define storage operations.
-
-SYNOPSIS
-
-        void Instruction::RecordErrDS();
+    bool valid = true;
+    switch (a_kind) {
 
-DESCRIPTION
+        case Isa::OperandKind::Absent:
+            if (!a_operand.empty() && !a_extraReported) {
+                m_Errors.Record(DiagCode::ExtraOperands, a_operand, a_number);
+                a_extraReported = true;
+            }
+            break;
 
-        This function checks the validity of the operands in the define storage instruction. It verifies that only one operand
-        exists, it is numeric, and is within the allowed range of values. If any errors are encountered during validation,
-        appropriate error messages are set, and corresponding error flags are updated to indicate the presence of errors.
+        case Isa::OperandKind::Register:
+            if (!a_isNumeric || a_value < 0 || a_value >= Isa::RegisterCount) {
+                m_Errors.Record(DiagCode::RegisterOperand, a_operand, a_number);
+                valid = false;
+            }
+            break;
 
-RETURNS
+        case Isa::OperandKind::Label:
+            if (isdigit((unsigned char)a_operand[0])) {
+                m_Errors.Record(DiagCode::LabelStartsWithDigit, a_operand, a_number);
+                valid = false;
+            }
+            if (a_operand.length() > Isa::MaxLabelLength) {
+                m_Errors.Record(DiagCode::LabelTooLong, a_operand, a_number);
+                valid = false;
+            }
+            break;
 
-       This function does not return any value.
+        case Isa::OperandKind::Value:
+            if (!a_isNumeric || a_value < a_op.minValue || a_value > a_op.maxValue) {
+                m_Errors.Record(a_op.rangeError, a_operand, a_number);
+                valid = false;
+            }
+            break;
 
-*/
-/**/
-void Instruction::RecordErrDS() {
-    // Operand 2 should be empty.
-    if (!m_Operand2.empty()) Errors::RecordError("Error: extra operands.");
-
-    // Space reserved must be numeric and between 1 and 999,999
-    if (!m_IsNumericOperand1 || m_Operand1NumericValue < 1 || m_Operand1NumericValue > 999'999) {
-        m_InvalidValue = true;
-        Errors::RecordError("Error: Operand 1 must be a value between 1 and 999,999.");
+        case Isa::OperandKind::Unchecked:
+            break;
     }
+    return valid;
 }
-/* void Instruction::RecordErrDS() */
+/* bool Instruction::CheckOperand(const Isa::OpDesc &a_op, Isa::OperandKind a_kind, int a_number, string_view a_operand, bool a_isNumeric, int a_value, bool &a_missingReported, bool &a_extraReported) */
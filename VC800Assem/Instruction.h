@@ -3,9 +3,15 @@
 //
 #pragma once
 
+#include "Diagnostics.h"
+
 // Forward declarations required for Instruction::Translate to avoid circular dependencies.
 class TransStmt;    // Forward declaration
 class SymbolTable;  // Forward declaration
+namespace Isa {
+    struct OpDesc;              // Forward declaration
+    enum class OperandKind;     // Forward declaration
+}
 
 // The elements of an instruction.
 class Instruction {
@@ -47,20 +53,46 @@ public:
         OC_DC,                  // DEFINE STORAGE:  ASSEM INSTRUCTION - The operand specifies the number of words of storage to be set aside.
         OC_DS,                  // DEFINE CONSTANT: ASSEM INSTRUCTION - The constant is a decimal integer placed in the operand field.
         OC_END,                 // END:             ASSEM INSTRUCTION - Indicates there are no additional statements to translate.
+        OC_EXPORT,              // EXPORT:          ASSEM INSTRUCTION - The label in the operand can be referred to from other modules.
+        OC_IMPORT,              // IMPORT:          ASSEM INSTRUCTION - The label in the operand is defined in another module, which the linker supplies.
         OC_COMM                 // No operation - this is a comment line.
     };
 
+    // The fields of a parsed statement, in the compact form the token cache keeps them.  The operands
+    // are given by their offset and length in the line.
+    struct Tokens {
+        SymbolicOpCode opCode = SymbolicOpCode::OC_COMM;   // The op code.
+        bool formatError = false;                       // == true if the statement has extra fields.
+        bool isNumeric1 = false;                        // == true if operand 1 is a number.
+        bool isNumeric2 = false;                        // == true if operand 2 is a number.
+        int value1 = 0;                                 // The value of operand 1.
+        int value2 = 0;                                 // The value of operand 2.
+        unsigned operand1Start = 0;                     // The offset of operand 1 in the line.
+        unsigned operand1Length = 0;                    // The length of operand 1.
+        unsigned operand2Start = 0;                     // The offset of operand 2 in the line.
+        unsigned operand2Length = 0;                    // The length of operand 2.
+    };
+
     // Parse the Instruction to record its fields and return its type.
-    InstructionType ParseInstruction(string a_line);
+    InstructionType ParseInstruction(string_view a_line);
+
+    // Get the fields of the statement last parsed, to keep in the token cache.
+    Tokens GetTokens() const;
+
+    // Restore the fields of a statement parsed before, as ParseInstruction would record them, and return its type.
+    InstructionType SetTokens(const Tokens &a_tokens, string_view a_line);
 
     // Translate the instruction to machine language and store information about the line.
-    TransStmt Translate(int a_loc, SymbolTable& a_st);
+    TransStmt Translate(int a_loc, size_t a_line, const SymbolTable& a_st);
+
+    // Translate the instruction, leaving the lookup of its address label to the caller.
+    TransStmt TranslateDeferred(int a_loc, size_t a_line, int &a_lookupErr);
 
     // Compute the location of the next instruction.
     int LocationNextInstruction(int a_loc) const;
 
     // To access the label.
-    inline string &GetLabel( ) {
+    inline string_view GetLabel( ) const {
 
         return m_Label;
     };
@@ -71,16 +103,58 @@ public:
         return ! m_Label.empty();
     };
 
+    // To access the label used as the address operand.
+    inline string_view GetAddressLabel( ) const {
+
+        return m_Operand2;
+    };
+
+    // To access the label an export or import statement names.
+    inline string_view GetSymbolOperand( ) const {
+
+        return m_Operand1;
+    };
+
+    // To access the op code.
+    inline SymbolicOpCode GetOpCode( ) const {
+
+        return m_NumOpCode;
+    };
+
+    // To determine if operand 1 is a number.
+    inline bool isNumericOperand1( ) const {
+
+        return m_IsNumericOperand1;
+    };
+
+    // The value of operand 1 is kept from the last statement whose operand 1 was a number, and org and ds use
+    // it when theirs is not.  These let the lines of a chunk be parsed as if the lines before it had been.
+    inline int GetOperand1Value( ) const {
+
+        return m_Operand1NumericValue;
+    };
+    inline void SetOperand1Value( int a_value ) {
+
+        m_Operand1NumericValue = a_value;
+    };
+
+    // To access the diagnostics recorded for the statement since it was parsed.  Each Instruction has its
+    // own, so that statements can be translated on several threads at once.
+    inline DiagnosticBuffer &GetErrors( ) {
+
+        return m_Errors;
+    };
+
 
 private:
 
-    // The elemements of a instruction
-    string m_Label;        // The label.
-    string m_OpCode;       // The symbolic op code.
-    string m_Operand1;     // The first operand. 
-    string m_Operand2;     // The second operand.
+    // The elemements of a instruction, as views of the source text.
+    string_view m_Label;        // The label.
+    string_view m_OpCode;       // The symbolic op code.
+    string_view m_Operand1;     // The first operand. 
+    string_view m_Operand2;     // The second operand.
 
-    string m_instruction;    // The original instruction.
+    string_view m_instruction;    // The original instruction, as a view of the source text.
 
     // Derived values.
     SymbolicOpCode m_NumOpCode = Instruction::SymbolicOpCode::OC_ERR;   // The numerical value of the op code for machine language equivalents.
@@ -96,47 +170,32 @@ private:
     bool m_InvalidOpCode = false;       // == true if the opcode is invalid.
     bool m_InvalidReg1 = false;         // == true if the first register value is invalid.
     bool m_InvalidReg2 = false;         // == true if the second register value is invalid.
-    bool m_InvalidAddr = false;         // == true if the address label is invalid.
+    bool m_InvalidAddr = false;         // == true if the address label, or the label an export or import names, is invalid.
     bool m_InvalidValue = false;        // == true if the constant value is invalid.
 
-    // Delete any comments from the statement.
-    void DeleteComment(string &a_line)
-    {
-        size_t isemi1 = a_line.find(';');
-        if (isemi1 != string::npos)
-        {
-            a_line.erase(isemi1);
-        }
-    }
-
-    // Record the fields of the instructions.
-    bool RecordFields( const string &a_line );
+    bool m_IsFormatError = false;       // == true if the statement has extra fields.
 
-    // Get the fields that make up the statement.  This function returns false if there
-    // are extra fields.
-    bool ParseLineIntoFields(string a_line, string& a_label, string& a_OpCode,
-        string& a_Operand1, string& a_Operand2);
+    DiagnosticBuffer m_Errors;          // The diagnostics recorded for this statement.
 
-    // Check if a string contains a number. 
-    bool isStrNumber(const string& a_str);
+    // Translate the recorded fields, looking up the address label if there is a symbol table.
+    TransStmt TranslateFields(int a_loc, size_t a_line, const SymbolTable *a_st, int &a_lookupErr);
 
+    // Look up the label operand a_operand in the symbol table, or leave it to the caller if there is none.
+    void LookupLabel(const SymbolTable *a_st, string_view a_label, int a_operand, bool a_allowImport, int &a_addr,
+        int &a_lookupErr);
 
-    // Functions to record errors for each instruction type.
-
-    // Record errors for instructions that require an address and register 1.
-    void RecordErrRegisterAddress();
-
-    // Record errors for instructions that require two register values.
-    void RecordErrRegisterRegister();
+    // Record the fields of the instructions.
+    bool RecordFields( string_view a_line );
 
-    // Record errors for the halt instruction (no operands).
-    void RecordErrHalt();
+    // Record the errors found while parsing the statement.
+    void RecordParseErrors();
 
-    // Record errors for the define constant instruction (1 operand to define the value).
-    void RecordErrDC();
+    // Record errors in the operands, as the instruction set table describes them.
+    void RecordOperandErrors(const Isa::OpDesc &a_op);
 
-    // Record errors for the define storage instruction (1 operand to define storage reserved).
-    void RecordErrDS();
+    // Check one operand and record any errors.  Returns false if the operand cannot be used.
+    bool CheckOperand(const Isa::OpDesc &a_op, Isa::OperandKind a_kind, int a_number, string_view a_operand,
+        bool a_isNumeric, int a_value, bool &a_missingReported, bool &a_extraReported);
 
 };
 
@@ -0,0 +1,703 @@
+//
+//      Implementation of the performance instrumentation, including the counting
+//      replacement for the global allocation functions.
+//
+#include "stdafx.h"
+#include "Instrument.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+vector<Instrument::Phase> Instrument::m_Phases;
+mutex Instrument::m_Lock;
+
+static atomic<long long> s_allocCount(0);     // Number of heap allocations made.
+static atomic<long long> s_allocBytes(0);     // Number of bytes requested by those allocations.
+
+// The time the program started, which trace timestamps are relative to.
+static const chrono::steady_clock::time_point s_programStart = chrono::steady_clock::now();
+
+/**/
+/*
+NAME
+
+        CountedAlloc - allocates memory and records the allocation.
+
+SYNOPSIS
+
+        static void *CountedAlloc(size_t a_size);
+            a_size      --> the number of bytes requested.
+
+DESCRIPTION
+
+        This function counts the allocation and then obtains the memory from malloc.  All of the
+        replaceable global operator new functions below come through here.  A request for zero bytes
+        is treated as a request for one byte, as the standard requires a unique pointer.
+
+RETURNS
+
+        Returns the allocated memory, or nullptr if there was none available.
+
+*/
+/**/
+static void *CountedAlloc(size_t a_size)
+{
+    s_allocCount.fetch_add(1, memory_order_relaxed);
+    s_allocBytes.fetch_add((long long)a_size, memory_order_relaxed);
+    return malloc(a_size == 0 ? 1 : a_size);
+}
+/* static void *CountedAlloc(size_t a_size) */
+
+void *operator new(size_t a_size)
+{
+    void *p = CountedAlloc(a_size);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+void *operator new[](size_t a_size)
+{
+    void *p = CountedAlloc(a_size);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+void *operator new(size_t a_size, const nothrow_t &) noexcept { return CountedAlloc(a_size); }
+void *operator new[](size_t a_size, const nothrow_t &) noexcept { return CountedAlloc(a_size); }
+void operator delete(void *a_p) noexcept { free(a_p); }
+void operator delete[](void *a_p) noexcept { free(a_p); }
+void operator delete(void *a_p, size_t) noexcept { free(a_p); }
+void operator delete[](void *a_p, size_t) noexcept { free(a_p); }
+void operator delete(void *a_p, const nothrow_t &) noexcept { free(a_p); }
+void operator delete[](void *a_p, const nothrow_t &) noexcept { free(a_p); }
+
+/**/
+/*
+NAME
+
+        Instrument::RecordPhase - records the measurements of a completed phase.
+
+SYNOPSIS
+
+        void Instrument::RecordPhase(const Phase &a_phase);
+            a_phase     --> the measurements of the phase.
+
+DESCRIPTION
+
+        This function appends the phase to the list of recorded phases.  It may be called from any
+        thread.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Instrument::RecordPhase(const Phase &a_phase)
+{
+    lock_guard<mutex> guard(m_Lock);
+    m_Phases.push_back(a_phase);
+}
+/* void Instrument::RecordPhase(const Phase &a_phase) */
+
+/**/
+/*
+NAME
+
+        Instrument::GetPhases - returns the phases recorded so far.
+
+SYNOPSIS
+
+        vector<Instrument::Phase> Instrument::GetPhases();
+
+DESCRIPTION
+
+        This function returns a copy of the recorded phases, so that the caller is not affected by
+        phases that complete on other threads while it is looking at them.
+
+RETURNS
+
+        Returns the recorded phases in the order they completed.
+
+*/
+/**/
+vector<Instrument::Phase> Instrument::GetPhases()
+{
+    lock_guard<mutex> guard(m_Lock);
+    return m_Phases;
+}
+/* vector<Instrument::Phase> Instrument::GetPhases() */
+
+/**/
+/*
+NAME
+
+        Instrument::ClearPhases - discards the phases recorded so far.
+
+SYNOPSIS
+
+        void Instrument::ClearPhases();
+
+DESCRIPTION
+
+        This function empties the list of recorded phases.  It is used by callers that run the
+        assembler repeatedly and only want to report the latest run.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Instrument::ClearPhases()
+{
+    lock_guard<mutex> guard(m_Lock);
+    m_Phases.clear();
+}
+/* void Instrument::ClearPhases() */
+
+/**/
+/*
+NAME
+
+        Instrument::GetAllocCounts - returns the heap allocation totals so far.
+
+SYNOPSIS
+
+        AllocCounts Instrument::GetAllocCounts();
+
+DESCRIPTION
+
+        This function returns the number of heap allocations made since the program started and the
+        total number of bytes they requested.  Take the difference of two readings to measure a phase.
+
+RETURNS
+
+        Returns the allocation totals.
+
+*/
+/**/
+AllocCounts Instrument::GetAllocCounts()
+{
+    return { s_allocCount.load(memory_order_relaxed), s_allocBytes.load(memory_order_relaxed) };
+}
+/* AllocCounts Instrument::GetAllocCounts() */
+
+/**/
+/*
+NAME
+
+        Instrument::PeakResidentBytes - returns the peak resident set size of this process.
+
+SYNOPSIS
+
+        long long Instrument::PeakResidentBytes();
+
+DESCRIPTION
+
+        This function asks the operating system for the largest amount of physical memory this
+        process has used so far.  On Windows this is the peak working set; elsewhere it is the
+        maximum resident set size reported by getrusage.
+
+RETURNS
+
+        Returns the peak resident set size in bytes, or 0 if it could not be determined.
+
+*/
+/**/
+long long Instrument::PeakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (long long)pmc.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (long long)usage.ru_maxrss;          // Already in bytes.
+#else
+    return (long long)usage.ru_maxrss * 1024;   // Reported in kilobytes.
+#endif
+#endif
+}
+/* long long Instrument::PeakResidentBytes() */
+
+/**/
+/*
+NAME
+
+        Instrument::ElapsedUs - returns the wall clock time since the program started.
+
+SYNOPSIS
+
+        double Instrument::ElapsedUs();
+
+DESCRIPTION
+
+        This function measures from the time the instrumentation was initialized, which happens
+        before main is entered.
+
+RETURNS
+
+        Returns the elapsed time in microseconds.
+
+*/
+/**/
+double Instrument::ElapsedUs()
+{
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - s_programStart).count();
+}
+/* double Instrument::ElapsedUs() */
+
+/**/
+/*
+NAME
+
+        Instrument::CpuUs - returns the CPU time used by this process.
+
+SYNOPSIS
+
+        double Instrument::CpuUs();
+
+DESCRIPTION
+
+        This function returns the user plus system time of all threads of the process.
+
+RETURNS
+
+        Returns the CPU time in microseconds, or 0 if it could not be determined.
+
+*/
+/**/
+double Instrument::CpuUs()
+{
+#ifdef _WIN32
+    FILETIME creation, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exited, &kernel, &user)) return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10.0;   // FILETIME counts 100 nanosecond intervals.
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) return 0;
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#endif
+}
+/* double Instrument::CpuUs() */
+
+/**/
+/*
+NAME
+
+        Instrument::ThreadId - returns a small id for the calling thread.
+
+SYNOPSIS
+
+        int Instrument::ThreadId();
+
+DESCRIPTION
+
+        Threads are numbered from 1 in the order they first ask for an id, which keeps the trace
+        readable.
+
+RETURNS
+
+        Returns the id of the calling thread.
+
+*/
+/**/
+int Instrument::ThreadId()
+{
+    static atomic<int> nextId(1);
+    thread_local int id = nextId.fetch_add(1);
+    return id;
+}
+/* int Instrument::ThreadId() */
+
+/**/
+/*
+NAME
+
+        WriteCounters - writes the hardware counter readings of a phase as JSON members.
+
+SYNOPSIS
+
+        static void WriteCounters(ostream &a_out, const Instrument::Phase &a_phase);
+            a_out       --> the stream to write to.
+            a_phase     --> the phase whose readings are written.
+
+DESCRIPTION
+
+        This function writes each counter that was read as a ", name: value" member, so that it can
+        be appended to the object describing the phase.  For a phase that ran the emulator, the number
+        of VC8000 instructions is written too, along with the host cycles and host instructions spent
+        per VC8000 instruction.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+static void WriteCounters(ostream &a_out, const Instrument::Phase &a_phase)
+{
+    for (int ev = 0; ev < PerfCounters::EV_Count; ev++) {
+        if (a_phase.counters[ev] < 0) continue;
+        a_out << ", \"" << PerfCounters::Name((PerfCounters::Event)ev) << "\": " << a_phase.counters[ev];
+    }
+    if (a_phase.emulated < 0) return;
+    a_out << ", \"vc8000_instructions\": " << a_phase.emulated;
+    if (a_phase.emulated == 0) return;
+
+    long long cycles = a_phase.counters[PerfCounters::EV_Cycles];
+    long long instructions = a_phase.counters[PerfCounters::EV_Instructions];
+    if (cycles >= 0) {
+        a_out << ", \"host_cycles_per_vc8000_instruction\": " << (double)cycles / a_phase.emulated;
+    }
+    if (instructions >= 0) {
+        a_out << ", \"host_instructions_per_vc8000_instruction\": " << (double)instructions / a_phase.emulated;
+    }
+}
+/* static void WriteCounters(ostream &a_out, const Instrument::Phase &a_phase) */
+
+/**/
+/*
+NAME
+
+        Instrument::WriteJsonReport - writes the recorded phases as a JSON report.
+
+SYNOPSIS
+
+        bool Instrument::WriteJsonReport(const string &a_path);
+            a_path      --> the file to write the report to.
+
+DESCRIPTION
+
+        This function writes one JSON object with an array of the recorded phases, giving for each its
+        wall and CPU time in milliseconds, its allocation count and bytes and any hardware counter
+        readings, followed by the peak resident set size of the process.
+
+RETURNS
+
+        Returns true if the report was written, and false if the file could not be opened.
+
+*/
+/**/
+bool Instrument::WriteJsonReport(const string &a_path)
+{
+    ofstream out(a_path, ios::out | ios::trunc);
+    if (!out) return false;
+
+    vector<Phase> phases = GetPhases();
+    out << "{\n  \"phases\": [";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const Phase &ph = phases[i];
+        out << (i == 0 ? "\n" : ",\n") << fixed << setprecision(3)
+            << "    {\"name\": \"" << ph.name << "\", \"thread\": " << ph.thread
+            << ", \"start_ms\": " << ph.startUs / 1e3
+            << ", \"wall_ms\": " << ph.wallUs / 1e3
+            << ", \"cpu_ms\": " << ph.cpuUs / 1e3
+            << ", \"allocations\": " << ph.allocs
+            << ", \"allocated_bytes\": " << ph.allocBytes;
+        WriteCounters(out, ph);
+        out << "}";
+    }
+    out << "\n  ],\n  \"peak_rss_bytes\": " << PeakResidentBytes() << "\n}\n";
+    return (bool)out;
+}
+/* bool Instrument::WriteJsonReport(const string &a_path) */
+
+/**/
+/*
+NAME
+
+        Instrument::WriteChromeTrace - writes the recorded phases in Chrome trace event format.
+
+SYNOPSIS
+
+        bool Instrument::WriteChromeTrace(const string &a_path);
+            a_path      --> the file to write the trace to.
+
+DESCRIPTION
+
+        This function writes each phase as a complete ("X") event, which chrome://tracing and
+        Perfetto display as a bar on the timeline of the thread that ran it.  The CPU time,
+        allocation counts and hardware counter readings are attached as event arguments.
+
+RETURNS
+
+        Returns true if the trace was written, and false if the file could not be opened.
+
+*/
+/**/
+bool Instrument::WriteChromeTrace(const string &a_path)
+{
+    ofstream out(a_path, ios::out | ios::trunc);
+    if (!out) return false;
+
+    vector<Phase> phases = GetPhases();
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const Phase &ph = phases[i];
+        out << (i == 0 ? "\n" : ",\n") << fixed << setprecision(3)
+            << "  {\"name\": \"" << ph.name << "\", \"cat\": \"phase\", \"ph\": \"X\", \"pid\": 1"
+            << ", \"tid\": " << ph.thread << ", \"ts\": " << ph.startUs << ", \"dur\": " << ph.wallUs
+            << ", \"args\": {\"cpu_ms\": " << ph.cpuUs / 1e3 << ", \"allocations\": " << ph.allocs
+            << ", \"allocated_bytes\": " << ph.allocBytes;
+        WriteCounters(out, ph);
+        out << "}}";
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+/* bool Instrument::WriteChromeTrace(const string &a_path) */
+
+/**/
+/*
+NAME
+
+        Instrument::GetEnvironment - returns the value of an environment variable.
+
+SYNOPSIS
+
+        string Instrument::GetEnvironment(const char *a_name);
+            a_name      --> the name of the variable.
+
+DESCRIPTION
+
+        This function reads the variable with _dupenv_s on Windows, where getenv is deprecated, and
+        with getenv elsewhere.
+
+RETURNS
+
+        Returns the value of the variable, or an empty string if it is not set.
+
+*/
+/**/
+string Instrument::GetEnvironment(const char *a_name)
+{
+#ifdef _WIN32
+    char *value = nullptr;
+    size_t length = 0;
+    if (_dupenv_s(&value, &length, a_name) != 0 || value == nullptr) return "";
+    string result(value);
+    free(value);
+    return result;
+#else
+    const char *value = getenv(a_name);
+    return value == nullptr ? "" : value;
+#endif
+}
+/* string Instrument::GetEnvironment(const char *a_name) */
+
+/**/
+/*
+NAME
+
+        Instrument::CountersEnabled - tells whether hardware counters were requested.
+
+SYNOPSIS
+
+        bool Instrument::CountersEnabled();
+
+DESCRIPTION
+
+        Hardware counters are read around each phase when the VC8000_PERF_COUNTERS environment
+        variable is set to anything other than an empty string or "0".  They are off by default since
+        opening them costs several system calls per phase.  The variable is only read once.
+
+RETURNS
+
+        Returns true if hardware counters should be read.
+
+*/
+/**/
+bool Instrument::CountersEnabled()
+{
+    static const bool enabled = [] {
+        string value = GetEnvironment("VC8000_PERF_COUNTERS");
+        return !value.empty() && value != "0";
+    }();
+    return enabled;
+}
+/* bool Instrument::CountersEnabled() */
+
+/**/
+/*
+NAME
+
+        Instrument::DisplayCounters - displays the hardware counter readings of the recorded phases.
+
+SYNOPSIS
+
+        void Instrument::DisplayCounters();
+
+DESCRIPTION
+
+        This function writes a table on cerr with one line per phase, giving each counter that was
+        read, or "n/a" for one that was not.  Phases that ran the emulator are followed by a line
+        giving the host cycles and instructions per VC8000 instruction.  cerr is used so that the
+        table does not mix with the listing or the output of the emulated program.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Instrument::DisplayCounters()
+{
+    vector<Phase> phases = GetPhases();
+    cerr << endl << "Hardware counters:" << endl << endl << left << setw(22) << "Phase";
+    for (int ev = 0; ev < PerfCounters::EV_Count; ev++) {
+        cerr << right << setw(18) << PerfCounters::Name((PerfCounters::Event)ev);
+    }
+    cerr << endl;
+
+    bool any = false;
+    for (const Phase &ph : phases) {
+        cerr << left << setw(22) << ph.name << right;
+        for (int ev = 0; ev < PerfCounters::EV_Count; ev++) {
+            if (ph.counters[ev] < 0) cerr << setw(18) << "n/a";
+            else {
+                cerr << setw(18) << ph.counters[ev];
+                any = true;
+            }
+        }
+        cerr << endl;
+
+        long long cycles = ph.counters[PerfCounters::EV_Cycles];
+        long long instructions = ph.counters[PerfCounters::EV_Instructions];
+        if (ph.emulated > 0 && (cycles >= 0 || instructions >= 0)) {
+            cerr << "    " << ph.emulated << " VC8000 instructions: " << fixed << setprecision(2);
+            if (cycles >= 0) cerr << (double)cycles / ph.emulated << " host cycles";
+            if (cycles >= 0 && instructions >= 0) cerr << ", ";
+            if (instructions >= 0) cerr << (double)instructions / ph.emulated << " host instructions";
+            cerr << " per instruction" << endl;
+        }
+    }
+    if (!any) {
+        cerr << endl << "No counters could be read.  They need Linux and a perf_event_paranoid setting of 2 or less." << endl;
+    }
+    cerr << left;
+}
+/* void Instrument::DisplayCounters() */
+
+/**/
+/*
+NAME
+
+        Instrument::WriteReportsFromEnvironment - writes the reports requested by the environment.
+
+SYNOPSIS
+
+        void Instrument::WriteReportsFromEnvironment();
+
+DESCRIPTION
+
+        This function writes the JSON report to the file named by VC8000_REPORT and the Chrome trace to
+        the file named by VC8000_TRACE.  Either or both may be unset, in which case that report is not
+        written.  Failure to write a report is reported on cerr but is not fatal.  If hardware
+        counters were requested, their readings are also displayed.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void Instrument::WriteReportsFromEnvironment()
+{
+    string reportPath = GetEnvironment("VC8000_REPORT");
+    if (!reportPath.empty() && !WriteJsonReport(reportPath)) {
+        cerr << "Could not write the performance report to " << reportPath << endl;
+    }
+    string tracePath = GetEnvironment("VC8000_TRACE");
+    if (!tracePath.empty() && !WriteChromeTrace(tracePath)) {
+        cerr << "Could not write the performance trace to " << tracePath << endl;
+    }
+    if (CountersEnabled()) DisplayCounters();
+}
+/* void Instrument::WriteReportsFromEnvironment() */
+
+/**/
+/*
+NAME
+
+        PhaseTimer::PhaseTimer - starts measuring a phase.
+
+SYNOPSIS
+
+        PhaseTimer::PhaseTimer(const char *a_name);
+            a_name      --> the name of the phase.  It must outlive the timer.
+
+DESCRIPTION
+
+        This constructor takes the starting readings of the wall clock, the process CPU time and the
+        allocation totals.  If hardware counters were requested they are started last, so that
+        opening them is not counted against the phase.  They count the workers of the shared thread
+        pool too, since the passes run on them, so that they cover the same threads as the process CPU
+        time; like the allocation totals, they then include other phases running at the same time.
+
+*/
+/**/
+PhaseTimer::PhaseTimer(const char *a_name)
+    : m_name(a_name), m_startUs(Instrument::ElapsedUs()), m_startCpuUs(Instrument::CpuUs()),
+    m_startAllocs(Instrument::GetAllocCounts())
+{
+    if (Instrument::CountersEnabled()) m_counting = m_counters.Start(ThreadPool::Shared().GetWorkerIds());
+}
+/* PhaseTimer::PhaseTimer(const char *a_name) */
+
+/**/
+/*
+NAME
+
+        PhaseTimer::~PhaseTimer - finishes measuring a phase and records it.
+
+SYNOPSIS
+
+        PhaseTimer::~PhaseTimer();
+
+DESCRIPTION
+
+        This destructor takes the ending readings and records the differences as a phase.  The
+        readings are taken before the phase record is built, so the record's own allocations are
+        not charged to the phase.  The hardware counters are stopped first for the same reason.
+
+*/
+/**/
+PhaseTimer::~PhaseTimer()
+{
+    if (m_counting) m_counters.Stop();
+    double endUs = Instrument::ElapsedUs();
+    double endCpuUs = Instrument::CpuUs();
+    AllocCounts endAllocs = Instrument::GetAllocCounts();
+
+    Instrument::Phase phase;
+    phase.name = m_name;
+    phase.thread = Instrument::ThreadId();
+    phase.startUs = m_startUs;
+    phase.wallUs = endUs - m_startUs;
+    phase.cpuUs = endCpuUs - m_startCpuUs;
+    phase.allocs = endAllocs.count - m_startAllocs.count;
+    phase.allocBytes = endAllocs.bytes - m_startAllocs.bytes;
+    for (int ev = 0; ev < PerfCounters::EV_Count; ev++) {
+        phase.counters[ev] = m_counters.Get((PerfCounters::Event)ev);
+    }
+    phase.emulated = m_emulated;
+    Instrument::RecordPhase(phase);
+}
+/* PhaseTimer::~PhaseTimer() */
@@ -0,0 +1,110 @@
+//
+// Class to record performance measurements for the phases of a run.  Like Errors, all members are
+// static so that any component can record a phase without being handed an object.
+//
+#ifndef _INSTRUMENT_H
+#define _INSTRUMENT_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+
+// Heap allocation totals since the program started.
+struct AllocCounts {
+    long long count;        // Number of allocations.
+    long long bytes;        // Bytes requested by those allocations.
+};
+
+class Instrument {
+
+public:
+
+    // The measurements taken for one phase.
+    struct Phase {
+        string name;                // The name of the phase.
+        int thread = 0;             // Small id of the thread that ran the phase.
+        double startUs = 0;         // Start of the phase, in microseconds since the program started.
+        double wallUs = 0;          // Wall clock duration in microseconds.
+        double cpuUs = 0;           // Process CPU time consumed, in microseconds.
+        long long allocs = 0;       // Heap allocations made during the phase.
+        long long allocBytes = 0;   // Bytes requested by those allocations.
+        long long counters[PerfCounters::EV_Count] = { -1, -1, -1, -1, -1 };
+                                    // Hardware counter values, or -1 where not counted.
+        long long emulated = -1;    // VC8000 instructions executed in the phase, or -1 if none.
+    };
+
+    // Records the measurements of a completed phase.
+    static void RecordPhase(const Phase &a_phase);
+
+    // Returns a copy of the phases recorded so far, in the order they completed.
+    static vector<Phase> GetPhases();
+
+    // Discards the phases recorded so far.
+    static void ClearPhases();
+
+    // Returns the heap allocation totals so far.
+    static AllocCounts GetAllocCounts();
+
+    // Returns the peak resident set size of this process in bytes.
+    static long long PeakResidentBytes();
+
+    // Returns the wall clock time since the program started, in microseconds.
+    static double ElapsedUs();
+
+    // Returns the CPU time used by this process, in microseconds.
+    static double CpuUs();
+
+    // Returns true if hardware counters were requested with the VC8000_PERF_COUNTERS environment variable.
+    static bool CountersEnabled();
+
+    // Displays the hardware counter readings of the recorded phases on cerr.
+    static void DisplayCounters();
+
+    // Returns a small id for the calling thread, for the trace.
+    static int ThreadId();
+
+    // Writes the recorded phases as a JSON report.  Returns false if the file could not be written.
+    static bool WriteJsonReport(const string &a_path);
+
+    // Writes the recorded phases in Chrome trace event format.  Returns false if the file could not be written.
+    static bool WriteChromeTrace(const string &a_path);
+
+    // Returns the value of an environment variable, or an empty string if it is not set.
+    static string GetEnvironment(const char *a_name);
+
+    // Writes the reports named by the VC8000_REPORT and VC8000_TRACE environment variables, if set,
+    // and displays the hardware counters if they were requested.
+    static void WriteReportsFromEnvironment();
+
+private:
+
+    static vector<Phase> m_Phases;      // The phases recorded so far.
+    static mutex m_Lock;                // Guards m_Phases, since phases may complete on any thread.
+};
+
+// Measures the phase of the run that lasts as long as this object is in scope.  Allocation counts
+// are process wide, so phases that overlap on different threads see each other's allocations.
+class PhaseTimer {
+
+public:
+
+    explicit PhaseTimer(const char *a_name);
+    ~PhaseTimer();
+
+    // Records the number of VC8000 instructions the phase executed, so that the hardware counters
+    // can be reported per emulated instruction.
+    void SetEmulatedInstructions(long long a_count) { m_emulated = a_count; }
+
+private:
+
+    const char *m_name;             // The name of the phase.
+    double m_startUs;               // Wall clock time at the start of the phase.
+    double m_startCpuUs;            // Process CPU time at the start of the phase.
+    AllocCounts m_startAllocs;      // Allocation totals at the start of the phase.
+    PerfCounters m_counters;        // Hardware counters, if they were requested.
+    bool m_counting = false;        // True if the hardware counters were started.
+    long long m_emulated = -1;      // VC8000 instructions executed, or -1 if not an emulation phase.
+};
+#endif
@@ -0,0 +1,169 @@
+//
+// Descriptor table for the VC8000 instruction set.  Each mnemonic is described once, with its op code,
+// its operands and how it is encoded, and the assembler's parser and validation, the listing and the
+// emulator's decoder all work from this table.  Everything here is evaluated at compile time.
+//
+#pragma once
+
+#include <array>
+#include <cctype>
+#include <string_view>
+
+#include "Instruction.h"
+
+namespace Isa {
+
+    const int RegisterCount = 10;       // Registers are numbered 0 to RegisterCount - 1.
+    const int MaxLabelLength = 10;      // The longest label allowed.
+
+    // Returns true if a label operand has none of the errors checking it reports: it is there, does not
+    // begin with a digit and is not too long.
+    inline bool IsValidLabel( string_view a_label ) {
+        return !a_label.empty() && !isdigit( (unsigned char)a_label[0] ) && a_label.size() <= (size_t)MaxLabelLength;
+    }
+
+    // What an operand must be.
+    enum class OperandKind {
+        Absent,             // There must be no operand.
+        Register,           // A register number.
+        Label,              // A label, used as an address or named by an export or import.
+        Value,              // A number within the range given by the descriptor.
+        Unchecked           // Not checked by the assembler.
+    };
+
+    // How a statement is encoded in a word of memory.
+    enum class Encoding {
+        RegAddr,            // Op code, register, address: OORAAAAAA.
+        RegReg,             // Op code, two registers: OORR00000.
+        Constant,           // A signed constant.
+        NoContents          // The statement does not generate a word.
+    };
+
+    // The description of one mnemonic.
+    struct OpDesc {
+        string_view mnemonic;                       // The mnemonic, in upper case.
+        Instruction::SymbolicOpCode opCode;         // The op code.
+        Instruction::InstructionType type;          // The type of statement.
+        OperandKind operand1;                       // What the first operand must be.
+        OperandKind operand2;                       // What the second operand must be.
+        Encoding encoding;                          // How the statement is encoded.
+        int minValue;                               // The smallest value of a Value operand.
+        int maxValue;                               // The largest value of a Value operand.
+        DiagCode rangeError;                        // The error for a Value operand out of range, or Count.
+    };
+
+    using SOC = Instruction::SymbolicOpCode;
+    using IT = Instruction::InstructionType;
+    using OK = OperandKind;
+    using EN = Encoding;
+
+    // The instruction set, in op code order.  Halt is encoded with a zero register and address.
+    constexpr OpDesc Ops[] = {
+        { "ADD",   SOC::OC_ADD,   IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "SUB",   SOC::OC_SUB,   IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "MULT",  SOC::OC_MULT,  IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "DIV",   SOC::OC_DIV,   IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "LOAD",  SOC::OC_LOAD,  IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "STORE", SOC::OC_STORE, IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "ADDR",  SOC::OC_ADDR,  IT::ST_MachineLanguage, OK::Register,  OK::Register,  EN::RegReg,     0, 0, DiagCode::Count },
+        { "SUBR",  SOC::OC_SUBR,  IT::ST_MachineLanguage, OK::Register,  OK::Register,  EN::RegReg,     0, 0, DiagCode::Count },
+        { "MULTR", SOC::OC_MULTR, IT::ST_MachineLanguage, OK::Register,  OK::Register,  EN::RegReg,     0, 0, DiagCode::Count },
+        { "DIVR",  SOC::OC_DIVR,  IT::ST_MachineLanguage, OK::Register,  OK::Register,  EN::RegReg,     0, 0, DiagCode::Count },
+        { "READ",  SOC::OC_READ,  IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "WRITE", SOC::OC_WRITE, IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "B",     SOC::OC_B,     IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "BM",    SOC::OC_BM,    IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "BZ",    SOC::OC_BZ,    IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "BP",    SOC::OC_BP,    IT::ST_MachineLanguage, OK::Register,  OK::Label,     EN::RegAddr,    0, 0, DiagCode::Count },
+        { "HALT",  SOC::OC_HALT,  IT::ST_MachineLanguage, OK::Absent,    OK::Absent,    EN::RegAddr,    0, 0, DiagCode::Count },
+        { "ORG",   SOC::OC_ORG,   IT::ST_AssemblerInstr,  OK::Unchecked, OK::Unchecked, EN::NoContents, 0, 0, DiagCode::Count },
+        { "DC",    SOC::OC_DC,    IT::ST_AssemblerInstr,  OK::Value,     OK::Absent,    EN::Constant,
+            -999'999'999, 999'999'999, DiagCode::ConstantRange },
+        { "DS",    SOC::OC_DS,    IT::ST_AssemblerInstr,  OK::Value,     OK::Absent,    EN::NoContents,
+            1, 999'999, DiagCode::StorageRange },
+        { "END",   SOC::OC_END,   IT::ST_End,             OK::Unchecked, OK::Unchecked, EN::NoContents, 0, 0, DiagCode::Count },
+        { "EXPORT", SOC::OC_EXPORT, IT::ST_AssemblerInstr, OK::Label,   OK::Absent,    EN::NoContents, 0, 0, DiagCode::Count },
+        { "IMPORT", SOC::OC_IMPORT, IT::ST_AssemblerInstr, OK::Label,   OK::Absent,    EN::NoContents, 0, 0, DiagCode::Count },
+    };
+    constexpr int OpCount = sizeof(Ops) / sizeof(Ops[0]);
+
+    // Returns the descriptor of an op code, or nullptr if there is none.
+    constexpr const OpDesc *ByOpCode(int a_opCode)
+    {
+        return (a_opCode >= 1 && a_opCode <= OpCount) ? &Ops[a_opCode - 1] : nullptr;
+    }
+    constexpr const OpDesc *ByOpCode(Instruction::SymbolicOpCode a_opCode)
+    {
+        return ByOpCode((int)a_opCode);
+    }
+
+    // Hashes a mnemonic, ignoring the case of letters.
+    constexpr unsigned Hash(string_view a_name)
+    {
+        unsigned h = 2166136261u;
+        for (size_t i = 0; i < a_name.size(); i++) {
+            h = (h ^ ((unsigned char)a_name[i] | 0x20u)) * 16777619u;
+        }
+        return h;
+    }
+
+    const unsigned HashBits = 6;                // The hash table has 2 ^ HashBits slots.
+    const unsigned HashSize = 1u << HashBits;
+
+    // Gives the slot of a hash.  The multiplier mixes all the bits of the hash into the top ones.
+    constexpr unsigned Slot(unsigned a_hash, unsigned a_multiplier)
+    {
+        return (a_hash * a_multiplier) >> (32 - HashBits);
+    }
+
+    // Finds a multiplier for which no two mnemonics go to the same slot.
+    constexpr unsigned FindMultiplier()
+    {
+        for (unsigned multiplier = 2654435761u; ; multiplier += 2) {
+            bool used[HashSize] = {};
+            bool collision = false;
+            for (int i = 0; i < OpCount && !collision; i++) {
+                unsigned slot = Slot(Hash(Ops[i].mnemonic), multiplier);
+                collision = used[slot];
+                used[slot] = true;
+            }
+            if (!collision) return multiplier;
+        }
+    }
+    constexpr unsigned Multiplier = FindMultiplier();
+
+    // Builds the hash table, which gives the index in Ops of the mnemonic in each slot, or -1.
+    constexpr array<signed char, HashSize> BuildSlots()
+    {
+        array<signed char, HashSize> slots = {};
+        for (unsigned i = 0; i < HashSize; i++) slots[i] = -1;
+        for (int i = 0; i < OpCount; i++) slots[Slot(Hash(Ops[i].mnemonic), Multiplier)] = (signed char)i;
+        return slots;
+    }
+    constexpr array<signed char, HashSize> Slots = BuildSlots();
+
+    // Returns the descriptor of a mnemonic, in any case, or nullptr if it is not one.  Since the hash is
+    // perfect, the only comparison needed is with the one mnemonic in the slot.
+    constexpr const OpDesc *Find(string_view a_name)
+    {
+        int index = Slots[Slot(Hash(a_name), Multiplier)];
+        if (index < 0 || Ops[index].mnemonic.size() != a_name.size()) return nullptr;
+
+        // Clearing bit 5 makes a lower case letter upper case, and only a letter can then match.
+        for (size_t i = 0; i < a_name.size(); i++) {
+            if ((a_name[i] & 0xDF) != Ops[index].mnemonic[i]) return nullptr;
+        }
+        return &Ops[index];
+    }
+
+    // Checks that the table is in op code order and that every mnemonic can be found.
+    constexpr bool TableIsConsistent()
+    {
+        for (int i = 0; i < OpCount; i++) {
+            if ((int)Ops[i].opCode != i + 1 || Find(Ops[i].mnemonic) != &Ops[i]) return false;
+        }
+        return true;
+    }
+    static_assert(TableIsConsistent(), "The instruction set table is out of order or has a hash collision.");
+    static_assert(Find("load") == ByOpCode(Instruction::SymbolicOpCode::OC_LOAD), "Lookup must ignore case.");
+}
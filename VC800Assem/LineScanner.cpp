@@ -0,0 +1,268 @@
+//
+//      Implementation of the line scanner.
+//
+#include "stdafx.h"
+#include "LineScanner.h"
+
+#include <charconv>
+#include <climits>
+#include <stdint.h>
+#include <string.h>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#define LINESCANNER_AVX2
+#define LINESCANNER_SSE2
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define LINESCANNER_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+    const size_t BlockSize = 64;    // The number of characters classified at once, one per bit of a mask.
+
+    // The classes of the characters of a block.  Bit i of each mask is for character i.
+    struct BlockMasks {
+        uint64_t separators;        // White space and commas.
+        uint64_t semicolons;        // Semicolons, which start a comment.
+    };
+
+    // Gives the index of the lowest set bit.  a_bits must not be zero.
+    inline unsigned LowestBit( uint64_t a_bits )
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64( &index, a_bits );
+        return (unsigned)index;
+#else
+        return (unsigned)__builtin_ctzll( a_bits );
+#endif
+    }
+
+    // Classifies a block of BlockSize characters.  White space is what isspace accepts in the C locale:
+    // a blank, or a tab, newline, vertical tab, form feed or carriage return, which are codes 9 to 13.
+    BlockMasks Classify( const char *a_block )
+    {
+        BlockMasks masks = { 0, 0 };
+#if defined( LINESCANNER_AVX2 )
+        const __m256i tab = _mm256_set1_epi8( '\t' );
+        const __m256i controlRange = _mm256_set1_epi8( '\r' - '\t' );
+        for( unsigned part = 0; part < BlockSize / 32; part++ ) {
+            __m256i chars = _mm256_loadu_si256( (const __m256i *)( a_block + 32 * part ) );
+
+            // Subtracting a tab takes the control characters to 0 to 4; anything else is larger, unsigned.
+            __m256i control = _mm256_sub_epi8( chars, tab );
+            __m256i separators = _mm256_or_si256(
+                _mm256_cmpeq_epi8( _mm256_min_epu8( control, controlRange ), control ),
+                _mm256_or_si256( _mm256_cmpeq_epi8( chars, _mm256_set1_epi8( ' ' ) ),
+                    _mm256_cmpeq_epi8( chars, _mm256_set1_epi8( ',' ) ) ) );
+            __m256i semicolons = _mm256_cmpeq_epi8( chars, _mm256_set1_epi8( ';' ) );
+
+            masks.separators |= (uint64_t)(uint32_t)_mm256_movemask_epi8( separators ) << ( 32 * part );
+            masks.semicolons |= (uint64_t)(uint32_t)_mm256_movemask_epi8( semicolons ) << ( 32 * part );
+        }
+#elif defined( LINESCANNER_SSE2 )
+        const __m128i tab = _mm_set1_epi8( '\t' );
+        const __m128i controlRange = _mm_set1_epi8( '\r' - '\t' );
+        for( unsigned part = 0; part < BlockSize / 16; part++ ) {
+            __m128i chars = _mm_loadu_si128( (const __m128i *)( a_block + 16 * part ) );
+
+            // Subtracting a tab takes the control characters to 0 to 4; anything else is larger, unsigned.
+            __m128i control = _mm_sub_epi8( chars, tab );
+            __m128i separators = _mm_or_si128(
+                _mm_cmpeq_epi8( _mm_min_epu8( control, controlRange ), control ),
+                _mm_or_si128( _mm_cmpeq_epi8( chars, _mm_set1_epi8( ' ' ) ),
+                    _mm_cmpeq_epi8( chars, _mm_set1_epi8( ',' ) ) ) );
+            __m128i semicolons = _mm_cmpeq_epi8( chars, _mm_set1_epi8( ';' ) );
+
+            masks.separators |= (uint64_t)(uint32_t)_mm_movemask_epi8( separators ) << ( 16 * part );
+            masks.semicolons |= (uint64_t)(uint32_t)_mm_movemask_epi8( semicolons ) << ( 16 * part );
+        }
+#else
+        for( unsigned i = 0; i < BlockSize; i++ ) {
+            unsigned char ch = (unsigned char)a_block[i];
+            if( ch == ' ' || ch == ',' || ( ch >= '\t' && ch <= '\r' ) ) masks.separators |= 1ULL << i;
+            if( ch == ';' ) masks.semicolons |= 1ULL << i;
+        }
+#endif
+        return masks;
+    }
+
+    // Classifies the last, short block of a line.  It is copied so as not to read past the end of the
+    // source, and padded with blanks, which end any field.
+    BlockMasks ClassifyTail( const char *a_text, size_t a_count )
+    {
+        char block[BlockSize];
+        memcpy( block, a_text, a_count );
+        memset( block + a_count, ' ', BlockSize - a_count );
+        return Classify( block );
+    }
+}
+
+/**/
+/*
+NAME
+
+        LineScanner::SplitFields - splits a statement into its fields.
+
+SYNOPSIS
+
+        bool LineScanner::SplitFields( string_view a_line, string_view &a_label, string_view &a_opCode,
+            string_view &a_operand1, string_view &a_operand2 );
+            a_line          --> the statement to split.
+            a_label         --> set to the label, or empty.
+            a_opCode        --> set to the op code, or empty.
+            a_operand1      --> set to the first operand, or empty.
+            a_operand2      --> set to the second operand, or empty.
+
+DESCRIPTION
+
+        This function classifies the line a block of 64 characters at a time, which for almost every
+        statement is the whole line, giving a bit mask of its separators and one of its semicolons.  The
+        first semicolon starts a comment, so every character from it on is made a separator.  The fields
+        are then found by alternately taking the lowest set bit of the characters that are not separators,
+        which starts a field, and of the separators, which ends it.  The fields are views of the line.
+
+RETURNS
+
+        Returns true if there are more than four fields, and false otherwise.
+
+*/
+/**/
+bool LineScanner::SplitFields( string_view a_line, string_view &a_label, string_view &a_opCode,
+    string_view &a_operand1, string_view &a_operand2 )
+{
+    a_label = a_opCode = a_operand1 = a_operand2 = string_view();
+    if( a_line.empty() ) return false;
+
+    // The fields in the order they appear.  If the line begins with a blank or a comma, there is no label.
+    string_view *fields[] = { &a_label, &a_opCode, &a_operand1, &a_operand2 };
+    size_t ifield = ( a_line[0] == ' ' || a_line[0] == '\t' || a_line[0] == ',' ) ? 1 : 0;
+
+    size_t start = SIZE_MAX;    // The start of the field being read, if any.
+    for( size_t base = 0; base < a_line.size(); base += BlockSize ) {
+        size_t count = min( BlockSize, a_line.size() - base );
+        BlockMasks masks = count == BlockSize ? Classify( a_line.data() + base )
+            : ClassifyTail( a_line.data() + base, count );
+
+        // Nothing after a semicolon is part of the statement.
+        bool comment = masks.semicolons != 0;
+        if( comment ) masks.separators |= ~0ULL << LowestBit( masks.semicolons );
+
+        // Find the starts and ends of the fields in the block.
+        unsigned pos = 0;
+        for( ; ; ) {
+            if( start == SIZE_MAX ) {
+                uint64_t starts = ~masks.separators & ( ~0ULL << pos );
+                if( starts == 0 ) break;
+                pos = LowestBit( starts );
+
+                // If all the fields are filled, there is extra data.
+                if( ifield == 4 ) return true;
+                start = base + pos;
+            }
+            else {
+                uint64_t ends = masks.separators & ( ~0ULL << pos );
+                if( ends == 0 ) break;
+                pos = LowestBit( ends );
+                *fields[ifield++] = a_line.substr( start, base + pos - start );
+                start = SIZE_MAX;
+            }
+        }
+        if( comment ) return false;
+    }
+
+    // The last field may run to the end of the line.
+    if( start != SIZE_MAX ) *fields[ifield] = a_line.substr( start );
+    return false;
+}
+/* bool LineScanner::SplitFields( string_view a_line, string_view &a_label, string_view &a_opCode, string_view &a_operand1, string_view &a_operand2 ) */
+
+/**/
+/*
+NAME
+
+        LineScanner::ParseNumber - checks if a string is a number and converts it.
+
+SYNOPSIS
+
+        bool LineScanner::ParseNumber( string_view a_str, int &a_value );
+            a_str           --> the string to be checked.
+            a_value         --> set to the value of the number, if it is one.
+
+DESCRIPTION
+
+        A number is an optional '-' or '+' sign followed by one or more digits and nothing else, and must fit
+        in an int.  Up to 16 digits are handled with SSE2: they are placed at the end of a 16 byte block of
+        zeros, checked to all be digits with one compare, and converted by multiplying and adding pairs of
+        neighbours, giving pairs of digits, then groups of four and then of eight, and the two groups of eight
+        are combined at the end.  Longer strings, which can only fit with leading zeros, and builds without
+        SSE2 are converted with from_chars.  Neither way allocates or throws.
+
+RETURNS
+
+        Returns true if the string is a number that fits in an int, and false otherwise.
+
+*/
+/**/
+bool LineScanner::ParseNumber( string_view a_str, int &a_value )
+{
+    const char *digits = a_str.data();
+    size_t count = a_str.size();
+
+    bool negative = false;
+    if( count > 0 && ( *digits == '-' || *digits == '+' ) ) {
+        negative = *digits == '-';
+        digits++;
+        count--;
+    }
+    if( count == 0 ) return false;
+
+#ifdef LINESCANNER_SSE2
+    if( count <= 16 ) {
+        char block[16];
+        memset( block, '0', 16 - count );
+        memcpy( block + 16 - count, digits, count );
+
+        // As unsigned bytes, the digits are 0 to 9 once '0' is subtracted, and anything else is larger.
+        __m128i values = _mm_sub_epi8( _mm_loadu_si128( (const __m128i *)block ), _mm_set1_epi8( '0' ) );
+        __m128i nine = _mm_set1_epi8( 9 );
+        if( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( values, nine ), values ) ) != 0xFFFF ) return false;
+
+        // Widen the digits to 16 bits and combine neighbours: pairs, then groups of four.
+        __m128i zero = _mm_setzero_si128();
+        __m128i tens = _mm_setr_epi16( 10, 1, 10, 1, 10, 1, 10, 1 );
+        __m128i pairs = _mm_packs_epi32( _mm_madd_epi16( _mm_unpacklo_epi8( values, zero ), tens ),
+            _mm_madd_epi16( _mm_unpackhi_epi8( values, zero ), tens ) );
+        __m128i hundreds = _mm_setr_epi16( 100, 1, 100, 1, 100, 1, 100, 1 );
+        __m128i fours = _mm_madd_epi16( pairs, hundreds );
+
+        // Then groups of eight, of which the first two lanes hold the high and the low half.
+        __m128i tenThousands = _mm_setr_epi16( 10000, 1, 10000, 1, 10000, 1, 10000, 1 );
+        __m128i eights = _mm_madd_epi16( _mm_packs_epi32( fours, fours ), tenThousands );
+        uint64_t high = (uint32_t)_mm_cvtsi128_si32( eights );
+        uint64_t low = (uint32_t)_mm_cvtsi128_si32( _mm_srli_si128( eights, 4 ) );
+        uint64_t value = high * 100'000'000 + low;
+
+        if( value > (uint64_t)INT_MAX + ( negative ? 1 : 0 ) ) return false;
+        a_value = negative ? (int)-(long long)value : (int)value;
+        return true;
+    }
+#endif
+
+    // from_chars accepts a minus but not a plus, so it is given the string from the minus, if any.
+    if( *digits < '0' || *digits > '9' ) return false;
+    const char *last = digits + count;
+    int value;
+    from_chars_result result = from_chars( negative ? digits - 1 : digits, last, value );
+    if( result.ec != errc() || result.ptr != last ) return false;
+
+    a_value = value;
+    return true;
+}
+/* bool LineScanner::ParseNumber( string_view a_str, int &a_value ) */
@@ -0,0 +1,24 @@
+//
+//		Vectorized scanning of source lines.
+//
+#pragma once
+
+#include <string_view>
+
+// Splits statements into fields and converts numbers, a block of characters at a time.  Each block of a
+// line is classified with SIMD compares into a bit mask of separators and one of semicolons, and the
+// fields are then read off the masks with bit operations instead of testing the characters one by one.
+// AVX2 is used when the assembler is built for it, SSE2 otherwise, and plain C++ where neither is
+// available; all give the same results.
+namespace LineScanner {
+
+    // Splits a line into its label, op code and two operands, ignoring any comment.  Fields are separated
+    // by white space or commas.  If the line begins with a blank, a tab or a comma there is no label.
+    // Returns true if there are more fields than that.
+    bool SplitFields( string_view a_line, string_view &a_label, string_view &a_opCode, string_view &a_operand1,
+        string_view &a_operand2 );
+
+    // Checks if a string is a number that fits in an int, an optional sign followed by digits, and
+    // converts it if it is.  a_value is left unchanged if it is not.
+    bool ParseNumber( string_view a_str, int &a_value );
+}
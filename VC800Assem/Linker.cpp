@@ -0,0 +1,204 @@
+//
+//      Implementation of the linker.
+//
+#include "stdafx.h"
+#include "Linker.h"
+
+// Reads a module, or a plain object file, to be linked.
+bool Linker::AddModule( const string &a_path )
+{
+    ObjectFile::Module module;
+    if( !ObjectFile::ReadModule( a_path, module ) ) return false;
+
+    m_modules.push_back( move( module ) );
+    m_paths.push_back( a_path );
+    return true;
+}
+
+/**/
+/*
+NAME
+
+        Linker::Link - links the modules into one program.
+
+SYNOPSIS
+
+        bool Linker::Link( MemoryImage &a_image );
+            a_image     --> set to the memory image of the program.
+
+DESCRIPTION
+
+        The modules are placed, the symbols they export are indexed, and then the words of each module are
+        stored at their places in turn.  The address field of each word with a relocation has where the
+        module was placed added to it, or the location of the symbol it imports, which it was assembled
+        with as 0.  Every import that no module exports, and every address that ends up outside memory, is
+        reported, so that all the problems are seen at once.
+
+RETURNS
+
+        Returns true if the program was linked, and false if there was a problem.
+
+*/
+/**/
+bool Linker::Link( MemoryImage &a_image )
+{
+    a_image.Start( {} );
+    if( !Place() || !IndexExports() ) {
+        a_image.SetFailed();
+        return false;
+    }
+
+    bool linked = true;
+    for( size_t imodule = 0; imodule < m_modules.size(); imodule++ ) {
+        const ObjectFile::Module &module = m_modules[imodule];
+        const int base = m_bases[imodule];
+
+        // Every symbol imported must be exported by some module.
+        for( const string &symbol : module.imports ) {
+            int loc;
+            if( !m_globals.LookupSymbol( symbol, loc ) ) {
+                cerr << m_paths[imodule] << ": " << symbol << " is not exported by any module." << endl;
+                linked = false;
+            }
+        }
+
+        for( const ObjectFile::Word &word : module.words ) {
+            if( !a_image.Store( base + word.loc, word.word ) ) {
+                cerr << m_paths[imodule] << ": location " << base + word.loc << " is outside memory." << endl;
+                a_image.SetFailed();
+                return false;
+            }
+        }
+
+        // Adjust the address of each word that depends on where things are placed.
+        for( const ObjectFile::Relocation &reloc : module.relocations ) {
+            int offset = base;
+            if( !reloc.symbol.empty() && !m_globals.LookupSymbol( reloc.symbol, offset ) ) continue;
+
+            long long word = a_image.GetWord( base + reloc.loc );
+            long long addr = word % 1'000'000 + offset;
+            if( word <= 0 || addr >= 1'000'000 ) {
+                cerr << m_paths[imodule] << ": the address of the word at " << base + reloc.loc
+                    << " cannot be relocated." << endl;
+                linked = false;
+                continue;
+            }
+            a_image.Store( base + reloc.loc, word - word % 1'000'000 + addr );
+        }
+    }
+    if( !linked ) a_image.SetFailed();
+    return linked;
+}
+/* bool Linker::Link( MemoryImage &a_image ) */
+
+/**/
+/*
+NAME
+
+        Linker::Place - places the modules in memory.
+
+SYNOPSIS
+
+        bool Linker::Place( );
+
+DESCRIPTION
+
+        An absolute module takes up the locations from its first word up to as far as it reaches, and no
+        two may share any.  The relocatable modules then follow one another, in the order they were added,
+        from EntryLocation or from past the last absolute module, whichever is further, each taking up as
+        far as it reaches from where it is placed.
+
+RETURNS
+
+        Returns false if two absolute modules overlap or a relocatable module does not fit in memory.
+
+*/
+/**/
+bool Linker::Place( )
+{
+    m_bases.assign( m_modules.size(), 0 );
+
+    // The range of locations of each absolute module, in order of location.
+    struct Range {
+        int first;
+        int last;
+        size_t module;
+    };
+    vector<Range> ranges;
+    int next = EntryLocation;
+    for( size_t imodule = 0; imodule < m_modules.size(); imodule++ ) {
+        const ObjectFile::Module &module = m_modules[imodule];
+        if( module.relocatable ) continue;
+        next = max( next, module.size );
+        if( module.words.empty() ) continue;
+
+        int first = module.words.front().loc;
+        for( const ObjectFile::Word &word : module.words ) first = min( first, word.loc );
+        ranges.push_back( { first, module.size - 1, imodule } );
+    }
+    sort( ranges.begin(), ranges.end(), []( const Range &a_lhs, const Range &a_rhs ) {
+        return a_lhs.first < a_rhs.first;
+    } );
+    for( size_t i = 1; i < ranges.size(); i++ ) {
+        if( ranges[i].first <= ranges[i - 1].last ) {
+            cerr << m_paths[ranges[i - 1].module] << " and " << m_paths[ranges[i].module] << " overlap." << endl;
+            return false;
+        }
+    }
+
+    for( size_t imodule = 0; imodule < m_modules.size(); imodule++ ) {
+        if( !m_modules[imodule].relocatable ) continue;
+        if( m_modules[imodule].size > MemoryImage::Size - next ) {
+            cerr << m_paths[imodule] << " does not fit in memory." << endl;
+            return false;
+        }
+        m_bases[imodule] = next;
+        next += m_modules[imodule].size;
+    }
+    return true;
+}
+/* bool Linker::Place( ) */
+
+/**/
+/*
+NAME
+
+        Linker::IndexExports - builds the index of the symbols the modules export.
+
+SYNOPSIS
+
+        bool Linker::IndexExports( );
+
+DESCRIPTION
+
+        The index is a symbol table of the whole program, which gives the location of each exported symbol
+        where its module was placed.  A symbol exported by two modules is recorded as multiply defined, and
+        reported once.
+
+RETURNS
+
+        Returns false if a symbol is exported by more than one module.
+
+*/
+/**/
+bool Linker::IndexExports( )
+{
+    size_t exportCount = 0;
+    for( const ObjectFile::Module &module : m_modules ) exportCount += module.exports.size();
+    m_globals.Reserve( exportCount );
+
+    bool unique = true;
+    for( size_t imodule = 0; imodule < m_modules.size(); imodule++ ) {
+        for( const ObjectFile::Symbol &symbol : m_modules[imodule].exports ) {
+            int loc;
+            bool duplicate = m_globals.LookupSymbol( symbol.name, loc ) && loc != m_globals.multiplyDefinedSymbol;
+            m_globals.AddSymbol( symbol.name, m_bases[imodule] + symbol.loc );
+            if( duplicate ) {
+                cerr << m_paths[imodule] << ": " << symbol.name << " is exported by more than one module." << endl;
+                unique = false;
+            }
+        }
+    }
+    return unique;
+}
+/* bool Linker::IndexExports( ) */
@@ -0,0 +1,41 @@
+//
+//		Linker, which joins modules assembled on their own into one program.
+//
+#pragma once
+
+#include "ObjectFile.h"
+#include "MemoryImage.h"
+#include "SymTab.h"
+
+// The linker places each module in memory, resolves the symbols each imports through an index of the
+// symbols all of them export, and stores the program in a memory image for the emulator.  Absolute
+// modules stay where their orgs put them.  Relocatable ones follow, one after another, from location
+// 100, where the emulator starts running, or from past the last absolute module if that is further.
+class Linker {
+
+public:
+
+    // The location the emulator starts running at, and so where the first relocatable module goes if
+    // nothing else is there.
+    static const int EntryLocation = 100;
+
+    // Reads a module, or a plain object file, to be linked.  Returns false if it could not be read.
+    bool AddModule( const string &a_path );
+
+    // Links the modules into a memory image.  Every problem is reported on cerr, naming the module.
+    // Returns false if there was one, in which case the image is not good.
+    bool Link( MemoryImage &a_image );
+
+private:
+
+    // Places the modules.  Returns false if two absolute modules overlap or a module does not fit.
+    bool Place( );
+
+    // Builds the index of the symbols the modules export.  Returns false if one is exported twice.
+    bool IndexExports( );
+
+    vector<ObjectFile::Module> m_modules;   // The modules, in the order they were added.
+    vector<string> m_paths;                 // The file each module was read from.
+    vector<int> m_bases;                    // Where each relocatable module is placed, or 0.
+    SymbolTable m_globals;                  // The location of every symbol exported, in the program.
+};
@@ -0,0 +1,298 @@
+//
+//      Implementation of the listing writer.
+//
+#include "stdafx.h"
+#include "ListingWriter.h"
+
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+static int OpenOutputFile( const char *a_path ) { return _open( a_path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644 ); }
+static long long WriteOutputFile( int a_fd, const char *a_data, unsigned a_size ) { return _write( a_fd, a_data, a_size ); }
+static void CloseOutputFile( int a_fd ) { _close( a_fd ); }
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+static int OpenOutputFile( const char *a_path ) { return open( a_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ); }
+static long long WriteOutputFile( int a_fd, const char *a_data, unsigned a_size ) { return write( a_fd, a_data, a_size ); }
+static void CloseOutputFile( int a_fd ) { close( a_fd ); }
+#endif
+
+// Writes the listing to a stream.  The buffer is allocated once, here.
+ListingWriter::ListingWriter( ostream &a_out )
+    : m_buffer( new char[BufferSize] ), m_stream( &a_out )
+{
+}
+
+// Keeps the listing in memory.  The buffer starts small and grows with the listing.
+ListingWriter::ListingWriter( )
+    : m_buffer( new char[BufferSize / 16] ), m_capacity( BufferSize / 16 )
+{
+}
+
+// Writes out what is left in the buffer and closes the file, if there is one.
+ListingWriter::~ListingWriter()
+{
+    Flush();
+    if( m_fd >= 0 ) CloseOutputFile( m_fd );
+}
+
+/**/
+/*
+NAME
+
+        ListingWriter::Open - writes the listing to a file.
+
+SYNOPSIS
+
+        bool ListingWriter::Open( const string &a_path );
+            a_path      --> the name of the file.
+
+DESCRIPTION
+
+        The file is created, or emptied if it exists.  Anything already written is written out to where it
+        was going first.
+
+RETURNS
+
+        Returns true if the file was created, and false if it could not be.
+
+*/
+/**/
+bool ListingWriter::Open( const string &a_path )
+{
+    Flush();
+    int fd = OpenOutputFile( a_path.c_str() );
+    if( fd < 0 ) return false;
+    if( m_fd >= 0 ) CloseOutputFile( m_fd );
+    m_fd = fd;
+    return true;
+}
+/* bool ListingWriter::Open( const string &a_path ) */
+
+// Writes out what is in the buffer.  A listing kept in memory is left as it is.
+void ListingWriter::Flush( )
+{
+    if( m_used == 0 || IsInMemory() ) return;
+    WriteOut( m_buffer.get(), m_used );
+    m_used = 0;
+}
+
+// Writes text that does not fit in the buffer.  What is in the buffer goes first, then the text
+// is written straight out if it is as big as the buffer.  A listing kept in memory grows instead.
+void ListingWriter::WriteLarge( string_view a_text )
+{
+    MakeRoom( a_text.size() );
+    if( a_text.size() > m_capacity - m_used ) {
+        WriteOut( a_text.data(), a_text.size() );
+        return;
+    }
+    memcpy( m_buffer.get() + m_used, a_text.data(), a_text.size() );
+    m_used += a_text.size();
+}
+
+// Makes room for a_size characters, by growing a listing kept in memory or writing out the buffer.
+void ListingWriter::MakeRoom( size_t a_size )
+{
+    if( !IsInMemory() ) {
+        Flush();
+        return;
+    }
+    if( a_size <= m_capacity - m_used ) return;
+
+    size_t capacity = max( m_capacity * 2, m_used + a_size );
+    unique_ptr<char[]> buffer( new char[capacity] );
+    memcpy( buffer.get(), m_buffer.get(), m_used );
+    m_buffer = move( buffer );
+    m_capacity = capacity;
+}
+
+/**/
+/*
+NAME
+
+        ListingWriter::WriteInOrder - writes out listings kept in memory, in order.
+
+SYNOPSIS
+
+        void ListingWriter::WriteInOrder( const ListingWriter *a_parts, size_t a_count );
+            a_parts     --> the listings kept in memory.
+            a_count     --> the number of them.
+
+DESCRIPTION
+
+        This function is how the parts of a listing formatted on several threads are put together.  What
+        is already in the buffer is written first.  The parts are then written to a file with writev, as
+        many at a time as it takes, so that their text is not copied again.  A stream is given each part
+        in turn.  A listing kept in memory grows once to hold all of the parts, which are copied onto its
+        end.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void ListingWriter::WriteInOrder( const ListingWriter *a_parts, size_t a_count )
+{
+    Flush();
+#ifndef _WIN32
+    if( m_fd >= 0 ) {
+        const size_t MaxVectors = 64;
+        size_t part = 0;
+        size_t offset = 0;      // How much of a_parts[part] has been written.
+        while( part < a_count && !m_failed ) {
+
+            // Gather the parts not yet written, skipping empty ones.
+            iovec vectors[MaxVectors];
+            int count = 0;
+            for( size_t i = part; i < a_count && count < (int)MaxVectors; i++ ) {
+                string_view text = a_parts[i].GetText().substr( i == part ? offset : 0 );
+                if( text.empty() ) continue;
+                vectors[count].iov_base = const_cast<char *>( text.data() );
+                vectors[count].iov_len = text.size();
+                count++;
+            }
+            if( count == 0 ) return;
+
+            ssize_t written = writev( m_fd, vectors, count );
+            if( written < 0 && errno == EINTR ) continue;
+            if( written <= 0 ) {
+                m_failed = true;
+                return;
+            }
+
+            // Move past what was written, which may end part way through a part.
+            size_t left = (size_t)written;
+            while( part < a_count ) {
+                size_t remaining = a_parts[part].GetText().size() - offset;
+                if( left < remaining ) {
+                    offset += left;
+                    break;
+                }
+                left -= remaining;
+                part++;
+                offset = 0;
+            }
+        }
+        return;
+    }
+#endif
+    if( IsInMemory() ) {
+        size_t total = 0;
+        for( size_t i = 0; i < a_count; i++ ) total += a_parts[i].GetText().size();
+        MakeRoom( total );
+    }
+    for( size_t i = 0; i < a_count; i++ ) {
+        string_view text = a_parts[i].GetText();
+        if( !text.empty() ) WriteOut( text.data(), text.size() );
+    }
+}
+/* void ListingWriter::WriteInOrder( const ListingWriter *a_parts, size_t a_count ) */
+
+/**/
+/*
+NAME
+
+        ListingWriter::WriteOut - writes characters to the stream or the file.
+
+SYNOPSIS
+
+        void ListingWriter::WriteOut( const char *a_data, size_t a_size );
+            a_data      --> the characters.
+            a_size      --> the number of characters.
+
+DESCRIPTION
+
+        A file is written with as many write calls as it takes, since one may write only part of the
+        characters.  Once a write fails, the rest are dropped.  A listing kept in memory has the
+        characters added to its buffer, which grows to hold them.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void ListingWriter::WriteOut( const char *a_data, size_t a_size )
+{
+    if( m_failed ) return;
+    if( IsInMemory() ) {
+        MakeRoom( a_size );
+        memcpy( m_buffer.get() + m_used, a_data, a_size );
+        m_used += a_size;
+        return;
+    }
+    if( m_fd < 0 ) {
+        m_stream->write( a_data, (streamsize)a_size );
+        m_failed = !*m_stream;
+        return;
+    }
+    while( a_size > 0 ) {
+        long long written = WriteOutputFile( m_fd, a_data, (unsigned)min<size_t>( a_size, 1u << 30 ) );
+        if( written < 0 && errno == EINTR ) continue;
+        if( written <= 0 ) {
+            m_failed = true;
+            return;
+        }
+        a_data += written;
+        a_size -= (size_t)written;
+    }
+}
+/* void ListingWriter::WriteOut( const char *a_data, size_t a_size ) */
+
+/**/
+/*
+NAME
+
+        ListingWriter::FormatInteger - formats a number in decimal.
+
+SYNOPSIS
+
+        size_t ListingWriter::FormatInteger( long long a_value, char *a_out );
+            a_value     --> the number.
+            a_out       --> where to put the characters.  It must have room for MaxIntegerLength of them.
+
+DESCRIPTION
+
+        The digits are produced two at a time from a table, from the right, into a scratch area and then
+        copied out.  The result is the same as to_string would give.
+
+RETURNS
+
+        Returns the number of characters.
+
+*/
+/**/
+size_t ListingWriter::FormatInteger( long long a_value, char *a_out )
+{
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    char scratch[MaxIntegerLength];
+    char *end = scratch + MaxIntegerLength;
+    char *pos = end;
+
+    unsigned long long value = a_value < 0 ? 0ull - (unsigned long long)a_value : (unsigned long long)a_value;
+    while( value >= 100 ) {
+        unsigned pair = (unsigned)( value % 100 ) * 2;
+        value /= 100;
+        *--pos = pairs[pair + 1];
+        *--pos = pairs[pair];
+    }
+    if( value >= 10 ) {
+        *--pos = pairs[value * 2 + 1];
+        *--pos = pairs[value * 2];
+    }
+    else *--pos = (char)( '0' + value );
+    if( a_value < 0 ) *--pos = '-';
+
+    size_t length = (size_t)( end - pos );
+    memcpy( a_out, pos, length );
+    return length;
+}
+/* size_t ListingWriter::FormatInteger( long long a_value, char *a_out ) */
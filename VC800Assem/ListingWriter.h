@@ -0,0 +1,137 @@
+//
+//		Listing writer, for writing the symbol table and translation quickly.
+//
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Formats the lines of a listing into a large buffer and writes the buffer out whole when it fills.
+// Numbers are formatted by hand and padded to their column, so writing a line makes no allocations and
+// no call into the stream library.  The listing goes to a stream, normally cout, so that it stays in order
+// with the rest of the output, or to a file of its own, which is written with the write system call.
+//
+// A writer can also keep what is formatted in memory, growing its buffer as needed, so that parts of a
+// listing can be formatted on several threads at once and then written out in order.
+class ListingWriter {
+
+public:
+
+    // The size of the buffer.
+    static const size_t BufferSize = 1 << 20;
+
+    // The most characters FormatInteger writes.
+    static const size_t MaxIntegerLength = 20;
+
+    // Writes the listing to a stream.
+    explicit ListingWriter( ostream &a_out );
+
+    // Keeps the listing in memory.
+    ListingWriter( );
+
+    // Writes out what is left in the buffer and closes the file, if there is one.
+    ~ListingWriter();
+
+    ListingWriter( const ListingWriter & ) = delete;
+    ListingWriter &operator=( const ListingWriter & ) = delete;
+
+    // Writes the listing to a file instead of the stream.  Returns false if the file cannot be created.
+    bool Open( const string &a_path );
+
+    // Adds text.
+    inline void Write( string_view a_text ) {
+        if( a_text.size() > m_capacity - m_used ) {
+            WriteLarge( a_text );
+            return;
+        }
+        memcpy( m_buffer.get() + m_used, a_text.data(), a_text.size() );
+        m_used += a_text.size();
+    }
+
+    // Adds a character.
+    inline void Write( char a_ch ) {
+        if( m_used == m_capacity ) MakeRoom( 1 );
+        m_buffer[m_used++] = a_ch;
+    }
+
+    // Adds a number of spaces.
+    inline void WriteSpaces( size_t a_count ) {
+        if( a_count > m_capacity - m_used ) MakeRoom( a_count );
+        while( a_count > 0 ) {
+            if( m_used == m_capacity ) MakeRoom( a_count );
+            size_t count = min( a_count, m_capacity - m_used );
+            memset( m_buffer.get() + m_used, ' ', count );
+            m_used += count;
+            a_count -= count;
+        }
+    }
+
+    // Adds text, followed by spaces to fill a_width characters, as setw and left would.
+    inline void WriteLeft( string_view a_text, size_t a_width ) {
+        Write( a_text );
+        if( a_text.size() < a_width ) WriteSpaces( a_width - a_text.size() );
+    }
+
+    // Adds text after spaces to fill a_width characters, as setw would.
+    inline void WriteRight( string_view a_text, size_t a_width ) {
+        if( a_text.size() < a_width ) WriteSpaces( a_width - a_text.size() );
+        Write( a_text );
+    }
+
+    // Adds a number, padded on the right or the left to a_width characters.
+    inline void WriteLeft( long long a_value, size_t a_width ) {
+        char digits[MaxIntegerLength];
+        WriteLeft( string_view( digits, FormatInteger( a_value, digits ) ), a_width );
+    }
+    inline void WriteRight( long long a_value, size_t a_width ) {
+        char digits[MaxIntegerLength];
+        WriteRight( string_view( digits, FormatInteger( a_value, digits ) ), a_width );
+    }
+
+    // Ends a line.
+    inline void EndLine( ) { Write( '\n' ); }
+
+    // Writes out what is in the buffer.  A listing kept in memory is left as it is.
+    void Flush( );
+
+    // Writes out the listings kept in memory by a_parts[0] to a_parts[a_count - 1], in order, after
+    // what is in the buffer.  The parts are left as they are.
+    void WriteInOrder( const ListingWriter *a_parts, size_t a_count );
+
+    // Get the text of a listing kept in memory.
+    inline string_view GetText( ) const { return string_view( m_buffer.get(), m_used ); }
+
+    // Empties a listing kept in memory, keeping its buffer.
+    inline void Clear( ) { m_used = 0; }
+
+    // Returns true if everything written so far has been written out.
+    inline bool IsGood( ) const { return !m_failed; }
+
+    // Formats a number in decimal into a_out, which must have room for MaxIntegerLength characters,
+    // and returns the number of characters.
+    static size_t FormatInteger( long long a_value, char *a_out );
+
+private:
+
+    // Writes text that does not fit in the buffer.
+    void WriteLarge( string_view a_text );
+
+    // Makes room for a_size characters: a listing kept in memory grows its buffer, and otherwise the
+    // buffer is written out.
+    void MakeRoom( size_t a_size );
+
+    // Returns true if the listing is kept in memory.
+    inline bool IsInMemory( ) const { return m_stream == nullptr && m_fd < 0; }
+
+    // Writes characters to the stream or the file, or adds them to a listing kept in memory.
+    void WriteOut( const char *a_data, size_t a_size );
+
+    unique_ptr<char[]> m_buffer;        // The buffer the lines are formatted into.
+    size_t m_capacity = BufferSize;     // The size of the buffer.
+    size_t m_used = 0;                  // The number of characters in the buffer.
+    ostream *m_stream = nullptr;        // The stream the listing is written to, unless there is a file.
+    int m_fd = -1;                      // The file the listing is written to, or -1.
+    bool m_failed = false;              // == true if a write failed.
+};
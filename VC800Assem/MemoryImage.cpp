@@ -0,0 +1,61 @@
+//
+//      Implementation of the memory image.
+//
+#include "stdafx.h"
+#include "MemoryImage.h"
+
+/**/
+/*
+NAME
+
+        MemoryImage::Start - empties the memory for a new program.
+
+SYNOPSIS
+
+        void MemoryImage::Start( vector<Segment> a_segments );
+            a_segments  --> the segments of the program, from Pass I, in any order.
+
+DESCRIPTION
+
+        This function clears the memory, makes it reach the last location of any segment inside it, and
+        works out from the segments whether any location could be stored twice.  Two segments that share a
+        location overlap.  A segment outside memory does not stop the image being built, since only the
+        statements in it that generate a word fail to be stored.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void MemoryImage::Start( vector<Segment> a_segments )
+{
+    int extent = 0;
+    for( const Segment &seg : a_segments ) extent = max( extent, min( seg.last, Size - 1 ) + 1 );
+    m_words.assign( extent, 0 );
+    m_failed = false;
+    m_built = true;
+
+    sort( a_segments.begin(), a_segments.end(),
+        []( const Segment &a_lhs, const Segment &a_rhs ) { return a_lhs.first < a_rhs.first; } );
+
+    m_disjoint = true;
+    for( size_t i = 1; i < a_segments.size(); i++ ) {
+        if( a_segments[i].first <= a_segments[i - 1].last ) m_disjoint = false;
+    }
+}
+/* void MemoryImage::Start( vector<Segment> a_segments ) */
+
+// Makes the memory reach a location, at least doubling it so that storing a program a word at a time
+// does not copy it over and over.
+void MemoryImage::Grow( int a_loc )
+{
+    m_words.resize( max<size_t>( a_loc + 1, min<size_t>( Size, m_words.size() * 2 ) ), 0 );
+}
+
+// Frees the memory, leaving the image empty.
+void MemoryImage::Release( )
+{
+    vector<long long>().swap( m_words );
+    m_built = false;
+}
@@ -0,0 +1,82 @@
+//
+//		Memory image, built by Pass II for the emulator to run.
+//
+#pragma once
+
+#include <vector>
+
+// The memory of the VC8000 with a translated program stored in it.  Pass II stores each machine word as
+// it is translated, and the emulator then copies the words, as far as the program reaches, into its
+// memory, so that there is no separate step to load the translation statement by statement.
+//
+// The segments of the program, the runs of locations between one org and the next, are known from
+// Pass I before any word is stored.  If no two of them overlap, no location is stored twice, so the
+// words of different parts of the program can be stored on several threads at once.  The memory only
+// reaches as far as the program does, so a small program costs little to build and to load, and
+// one that is only assembled does not cost a whole memory.
+class MemoryImage {
+
+public:
+
+    // The size of the memory of the VC8000, in words.
+    static const int Size = 1'000'000;
+
+    // The locations from first to last.
+    struct Segment {
+        int first;
+        int last;
+    };
+
+    // Empties the memory, for the words of a program whose segments are a_segments, in any order.  The
+    // memory is made to reach the end of the last segment.
+    void Start( vector<Segment> a_segments );
+
+    // Returns true if the segments do not overlap, so words can be stored on several threads at once.
+    inline bool IsDisjoint( ) const { return m_disjoint; }
+
+    // Stores the word a statement generates at its location.  A statement without a word, whose word is
+    // 0, stores nothing.  Returns false if the location is outside memory.  The memory grows to reach a
+    // location past the segments, so that may only be done on one thread at a time.
+    inline bool Store( int a_loc, long long a_word ) {
+        if( a_word == 0 ) return true;
+        if( a_loc < 0 || a_loc >= Size ) return false;
+        if( a_loc >= (int)m_words.size() ) Grow( a_loc );
+        m_words[a_loc] = a_word;
+        return true;
+    }
+
+    // Clears the word at a location, for a statement that is translated again.
+    inline void Erase( int a_loc ) {
+        if( a_loc >= 0 && a_loc < (int)m_words.size() ) m_words[a_loc] = 0;
+    }
+
+    // Get the number of locations the memory reaches, which is past every word stored.
+    inline int GetExtent( ) const { return (int)m_words.size(); }
+
+    // Get the word stored at a location.
+    inline long long GetWord( int a_loc ) const {
+        return a_loc < (int)m_words.size() ? m_words[a_loc] : 0;
+    }
+
+    // Records that a word could not be stored, so that the program cannot be run.
+    inline void SetFailed( ) { m_failed = true; }
+
+    // Returns true if every word was stored.
+    inline bool IsGood( ) const { return !m_failed; }
+
+    // Returns true if the image holds a program that has not been released.
+    inline bool IsBuilt( ) const { return m_built; }
+
+    // Frees the memory, leaving the image empty, once the emulator has loaded the program from it.
+    void Release( );
+
+private:
+
+    // Makes the memory reach a location.
+    void Grow( int a_loc );
+
+    vector<long long> m_words;      // The memory, as far as the program reaches.
+    bool m_disjoint = false;        // == true if the segments of the program do not overlap.
+    bool m_failed = false;          // == true if a word could not be stored.
+    bool m_built = false;           // == true if the image holds a program.
+};
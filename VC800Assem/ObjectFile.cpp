@@ -0,0 +1,299 @@
+//
+//      Implementation of object files.
+//
+#include "stdafx.h"
+#include "ObjectFile.h"
+#include "ListingWriter.h"
+
+#include <errno.h>
+
+namespace {
+
+    // The first line of an object file, and of a module.
+    const char Header[] = "VC8000 object 1";
+    const char ModuleHeader[] = "VC8000 module 1";
+
+    // Reads a location inside memory and a word from a line with nothing else on it.  Returns false if
+    // the line is not that.
+    bool ParseWord( const char *a_text, int &a_loc, long long &a_word )
+    {
+        char *end;
+        errno = 0;
+        long long loc = strtoll( a_text, &end, 10 );
+        const char *wordText = end;
+        a_word = strtoll( wordText, &end, 10 );
+        bool valid = errno == 0 && end != wordText && wordText != a_text && loc >= 0 && loc < MemoryImage::Size;
+        while( valid && ( *end == ' ' || *end == '\t' || *end == '\r' ) ) end++;
+        a_loc = (int)loc;
+        return valid && *end == '\0';
+    }
+
+    // Opens a file to read, or uses standard input for "-", and reads its first line without any carriage
+    // return.  A file that cannot be opened is reported on cerr.
+    istream *OpenInput( const string &a_path, ifstream &a_file, string &a_header )
+    {
+        if( a_path != "-" ) {
+            a_file.open( a_path, ios::in );
+            if( !a_file ) {
+                cerr << "Object file " << a_path << " could not be opened." << endl;
+                return nullptr;
+            }
+        }
+        istream *in = ( a_path == "-" ) ? &cin : &a_file;
+        if( !getline( *in, a_header ) ) a_header.clear();
+        a_header.erase( a_header.find_last_not_of( "\r" ) + 1 );
+        return in;
+    }
+
+    // Returns true if a line has nothing but white space.
+    bool IsBlank( const string &a_line )
+    {
+        return a_line.find_first_not_of( " \t\r" ) == string::npos;
+    }
+}
+
+/**/
+/*
+NAME
+
+        ObjectFile::Write - writes the words of a memory image to an object file.
+
+SYNOPSIS
+
+        bool ObjectFile::Write( const string &a_path, const MemoryImage &a_image );
+            a_path      --> the name of the file, or "-" for standard output.
+            a_image     --> the memory image of the program.
+
+DESCRIPTION
+
+        This function writes the header line, then a line for every location that holds a word, in
+        order of location.  It goes through the listing writer, so a large program is written without
+        any stream formatting.
+
+RETURNS
+
+        Returns true if the file was written, and false if it could not be.
+
+*/
+/**/
+bool ObjectFile::Write( const string &a_path, const MemoryImage &a_image )
+{
+    ListingWriter out( cout );
+    if( a_path != "-" && !out.Open( a_path ) ) return false;
+
+    out.Write( Header );
+    out.EndLine();
+    for( int loc = 0; loc < a_image.GetExtent(); loc++ ) {
+        long long word = a_image.GetWord( loc );
+        if( word == 0 ) continue;
+        out.WriteLeft( loc, 0 );
+        out.Write( ' ' );
+        out.WriteLeft( word, 0 );
+        out.EndLine();
+    }
+    out.Flush();
+    return out.IsGood();
+}
+/* bool ObjectFile::Write( const string &a_path, const MemoryImage &a_image ) */
+
+/**/
+/*
+NAME
+
+        ObjectFile::Read - reads a program from an object file into a memory image.
+
+SYNOPSIS
+
+        bool ObjectFile::Read( const string &a_path, MemoryImage &a_image );
+            a_path      --> the name of the file, or "-" for standard input.
+            a_image     --> set to the memory image of the program.
+
+DESCRIPTION
+
+        This function checks the header line, then stores the word on each line at its location.  Blank
+        lines are skipped.  A line that is not a location inside memory followed by a word, or a file
+        without the header, is reported with its line number on cerr, and the image is not built.
+
+RETURNS
+
+        Returns true if the program was read, and false if there was an issue.
+
+*/
+/**/
+bool ObjectFile::Read( const string &a_path, MemoryImage &a_image )
+{
+    ifstream file;
+    string line;
+    istream *in = OpenInput( a_path, file, line );
+    if( in == nullptr ) return false;
+    if( line != Header ) {
+        cerr << a_path << " is not a VC8000 object file." << endl;
+        return false;
+    }
+
+    a_image.Start( {} );
+    for( size_t lineNumber = 2; getline( *in, line ); lineNumber++ ) {
+        if( IsBlank( line ) ) continue;
+
+        // Read the location and the word, and make sure nothing else follows.
+        int loc;
+        long long word;
+        if( !ParseWord( line.c_str(), loc, word ) ) {
+            cerr << a_path << ":" << lineNumber << ": expected a location and a word." << endl;
+            a_image.SetFailed();
+            return false;
+        }
+        a_image.Store( loc, word );
+    }
+    return true;
+}
+/* bool ObjectFile::Read( const string &a_path, MemoryImage &a_image ) */
+
+/**/
+/*
+NAME
+
+        ObjectFile::WriteModule - writes a module to an object file.
+
+SYNOPSIS
+
+        bool ObjectFile::WriteModule( const string &a_path, const Module &a_module );
+            a_path      --> the name of the file, or "-" for standard output.
+            a_module    --> the module.
+
+DESCRIPTION
+
+        This function writes the header line, whether the module is relocatable and how far it reaches,
+        its exports and imports, its words and then its relocations, through the listing writer.
+
+RETURNS
+
+        Returns true if the file was written, and false if it could not be.
+
+*/
+/**/
+bool ObjectFile::WriteModule( const string &a_path, const Module &a_module )
+{
+    ListingWriter out( cout );
+    if( a_path != "-" && !out.Open( a_path ) ) return false;
+
+    out.Write( ModuleHeader );
+    out.EndLine();
+    out.Write( a_module.relocatable ? "relocatable " : "absolute " );
+    out.WriteLeft( a_module.size, 0 );
+    out.EndLine();
+    for( const Symbol &symbol : a_module.exports ) {
+        out.Write( "export " );
+        out.Write( symbol.name );
+        out.Write( ' ' );
+        out.WriteLeft( symbol.loc, 0 );
+        out.EndLine();
+    }
+    for( const string &symbol : a_module.imports ) {
+        out.Write( "import " );
+        out.Write( symbol );
+        out.EndLine();
+    }
+    for( const Word &word : a_module.words ) {
+        out.WriteLeft( word.loc, 0 );
+        out.Write( ' ' );
+        out.WriteLeft( word.word, 0 );
+        out.EndLine();
+    }
+    for( const Relocation &reloc : a_module.relocations ) {
+        out.Write( "reloc " );
+        out.WriteLeft( reloc.loc, 0 );
+        if( !reloc.symbol.empty() ) {
+            out.Write( ' ' );
+            out.Write( reloc.symbol );
+        }
+        out.EndLine();
+    }
+    out.Flush();
+    return out.IsGood();
+}
+/* bool ObjectFile::WriteModule( const string &a_path, const Module &a_module ) */
+
+/**/
+/*
+NAME
+
+        ObjectFile::ReadModule - reads a module from an object file.
+
+SYNOPSIS
+
+        bool ObjectFile::ReadModule( const string &a_path, Module &a_module );
+            a_path      --> the name of the file, or "-" for standard input.
+            a_module    --> set to the module.
+
+DESCRIPTION
+
+        This function reads a module as WriteModule writes it.  A plain object file is read as an
+        absolute module with only words, which reaches just past its last word.  Blank lines are skipped.
+        A line that cannot be read, a relocation of a location outside the module, or a file that is not
+        an object file at all, is reported with its line number on cerr.
+
+RETURNS
+
+        Returns true if the module was read, and false if there was an issue.
+
+*/
+/**/
+bool ObjectFile::ReadModule( const string &a_path, Module &a_module )
+{
+    a_module = Module();
+
+    ifstream file;
+    string line;
+    istream *in = OpenInput( a_path, file, line );
+    if( in == nullptr ) return false;
+    const bool isModule = line == ModuleHeader;
+    if( !isModule && line != Header ) {
+        cerr << a_path << " is not a VC8000 object file." << endl;
+        return false;
+    }
+
+    for( size_t lineNumber = 2; getline( *in, line ); lineNumber++ ) {
+        if( IsBlank( line ) ) continue;
+
+        // Most lines are words.  The others start with what they are.
+        int loc;
+        long long word;
+        if( ParseWord( line.c_str(), loc, word ) ) {
+            a_module.words.push_back( { loc, word } );
+            a_module.size = max( a_module.size, loc + 1 );
+            continue;
+        }
+
+        istringstream fields( line );
+        string kind, name, extra;
+        bool valid = isModule && ( fields >> kind );
+        if( valid && ( kind == "relocatable" || kind == "absolute" ) ) {
+            a_module.relocatable = kind == "relocatable";
+            valid = ( fields >> loc ) && loc >= 0 && loc <= MemoryImage::Size;
+            a_module.size = max( a_module.size, loc );
+        }
+        else if( valid && kind == "export" ) {
+            valid = ( fields >> name >> loc ) && loc >= 0 && loc < MemoryImage::Size;
+            a_module.exports.push_back( { name, loc } );
+        }
+        else if( valid && kind == "import" ) {
+            valid = bool( fields >> name );
+            a_module.imports.push_back( name );
+        }
+        else if( valid && kind == "reloc" ) {
+            valid = ( fields >> loc ) && loc >= 0 && loc < a_module.size;
+            fields >> name;
+            a_module.relocations.push_back( { loc, name } );
+        }
+        else valid = false;
+
+        if( !valid || ( fields >> extra ) ) {
+            cerr << a_path << ":" << lineNumber << ": expected "
+                << ( isModule ? "a word or a module entry." : "a location and a word." ) << endl;
+            return false;
+        }
+    }
+    return true;
+}
+/* bool ObjectFile::ReadModule( const string &a_path, Module &a_module ) */
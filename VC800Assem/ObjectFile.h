@@ -0,0 +1,77 @@
+//
+//		Object files, which hold an assembled program so that it can be run without assembling it again.
+//
+#pragma once
+
+#include <string>
+
+#include "MemoryImage.h"
+
+// An object file is text.  The first line names the format and its version, and each line after it
+// holds a location and the word stored there, in decimal, for every location that is not zero:
+//
+//      VC8000 object 1
+//      100 051000105
+//
+// The words are written as the emulator stores them, so a statement with an error is -1.
+//
+// A module, assembled to be linked with others, is an object file with a different first line and
+// lines saying how to link it before its words, and which of its words refer to addresses, after them:
+//
+//      VC8000 module 1
+//      relocatable 12
+//      export SQUARE 0
+//      import RESULT
+//      0 051000010
+//      1 061000000
+//      reloc 0
+//      reloc 1 RESULT
+//
+// A relocatable module, which has no org, is assembled from location 0 and may be placed anywhere; an
+// absolute one stays where its orgs put it.  The number is how far the module reaches, so that the
+// linker can place the next module after any storage at its end.  A reloc line names a word whose
+// address field is adjusted, by where the module is placed, or by the location of the symbol named.
+namespace ObjectFile {
+
+    // A word of a module.
+    struct Word {
+        int loc;                    // The location, from the start of the module if it is relocatable.
+        long long word;             // The word.
+    };
+
+    // A symbol a module exports.
+    struct Symbol {
+        string name;                // The name.
+        int loc;                    // The location, from the start of the module if it is relocatable.
+    };
+
+    // A word whose address field depends on where things are placed.
+    struct Relocation {
+        int loc;                    // The location of the word, from the start of the module if it is relocatable.
+        string symbol;              // The imported symbol whose location is added, or empty to add the module's.
+    };
+
+    // A module, as the assembler leaves it for the linker.
+    struct Module {
+        bool relocatable = false;           // == true if the module may be placed anywhere.
+        int size = 0;                       // The locations the module reaches, from 0.
+        vector<Symbol> exports;             // The symbols the module exports.
+        vector<string> imports;             // The symbols the module imports.
+        vector<Word> words;                 // The words of the module that are not zero, in order of location.
+        vector<Relocation> relocations;     // The words to adjust, in order of location.
+    };
+
+    // Write the words of a memory image.  Returns false if the file could not be written.
+    bool Write( const string &a_path, const MemoryImage &a_image );
+
+    // Read a program into a memory image.  A file that cannot be read, or is not an object file, is
+    // reported on cerr and false is returned.
+    bool Read( const string &a_path, MemoryImage &a_image );
+
+    // Write a module.  Returns false if the file could not be written.
+    bool WriteModule( const string &a_path, const Module &a_module );
+
+    // Read a module.  A plain object file is read as an absolute module that exports and imports
+    // nothing.  A file that cannot be read is reported on cerr and false is returned.
+    bool ReadModule( const string &a_path, Module &a_module );
+}
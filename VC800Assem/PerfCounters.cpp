@@ -0,0 +1,201 @@
+//
+//      Implementation of the hardware performance counters.
+//
+#include "stdafx.h"
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Constructs the counters in the closed state.
+PerfCounters::PerfCounters()
+{
+    for (int ev = 0; ev < EV_Count; ev++) {
+        m_values[ev] = -1;
+    }
+}
+
+// Closes the counters if they are still open.
+PerfCounters::~PerfCounters()
+{
+    Close();
+}
+
+/**/
+/*
+NAME
+
+        PerfCounters::Start - opens and starts the counters.
+
+SYNOPSIS
+
+        bool PerfCounters::Start(const vector<int> &a_threads);
+            a_threads   --> the kernel ids of the other threads to count, such as the pool's workers.
+
+DESCRIPTION
+
+        This function opens one counter per event for the calling thread and for each thread named,
+        counting user mode only so that it works with the default perf_event_paranoid setting.  The
+        threads named already exist, so counters inherited by new threads would not reach them, and
+        inherited counts only arrive when a thread exits; each thread is counted by counters of its
+        own instead, which Stop adds together.  Events the CPU or kernel does not support are
+        skipped, and are reported as -1.  All of the counters are reset and enabled together at the
+        end.
+
+RETURNS
+
+        Returns true if at least one counter was opened, and false otherwise.
+
+*/
+/**/
+bool PerfCounters::Start(const vector<int> &a_threads)
+{
+#ifdef __linux__
+    static const struct { unsigned type; unsigned long long config; } events[EV_Count] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    };
+
+    Close();
+    bool any = false;
+    for (size_t thread = 0; thread <= a_threads.size(); thread++) {
+        int tid = thread == 0 ? 0 : a_threads[thread - 1];
+        for (int ev = 0; ev < EV_Count; ev++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[ev].type;
+            attr.config = events[ev].config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            int fd = tid < 0 ? -1 : (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+            m_fds.push_back(fd);
+            if (fd >= 0) any = true;
+        }
+    }
+    for (int fd : m_fds) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return any;
+#else
+    (void)a_threads;
+    return false;
+#endif
+}
+/* bool PerfCounters::Start() */
+
+/**/
+/*
+NAME
+
+        PerfCounters::Stop - stops the counters and records their values.
+
+SYNOPSIS
+
+        void PerfCounters::Stop();
+
+DESCRIPTION
+
+        This function disables all counters first and then reads them, so that reading one does not
+        count against the others.  If the kernel had to multiplex the counters because there were not
+        enough hardware registers, each value is scaled up by the fraction of the time it was
+        actually counting.  The value of an event is the sum over the threads counted, or -1 if it
+        was counted on none of them.  The counters are closed afterwards.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void PerfCounters::Stop()
+{
+#ifdef __linux__
+    for (int fd : m_fds) {
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int ev = 0; ev < EV_Count; ev++) {
+        m_values[ev] = -1;
+    }
+    for (size_t i = 0; i < m_fds.size(); i++) {
+        int ev = (int)(i % EV_Count);
+        if (m_fds[i] < 0) continue;
+
+        // The value, then the time enabled and the time running.
+        unsigned long long data[3];
+        if (read(m_fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0) continue;
+        long long value = (long long)data[0];
+        if (data[2] < data[1]) value = (long long)((double)data[0] * data[1] / data[2]);
+        m_values[ev] = max(m_values[ev], 0LL) + value;
+    }
+#endif
+    Close();
+}
+/* void PerfCounters::Stop() */
+
+/**/
+/*
+NAME
+
+        PerfCounters::Name - returns the name an event is reported under.
+
+SYNOPSIS
+
+        const char *PerfCounters::Name(Event a_event);
+            a_event     --> the event.
+
+RETURNS
+
+        Returns the name of the event.
+
+*/
+/**/
+const char *PerfCounters::Name(Event a_event)
+{
+    static const char *names[EV_Count] = {
+        "host_cycles", "host_instructions", "branch_misses", "l1d_read_misses", "llc_misses"
+    };
+    return names[a_event];
+}
+/* const char *PerfCounters::Name(Event a_event) */
+
+/**/
+/*
+NAME
+
+        PerfCounters::Close - closes any counters that are open.
+
+SYNOPSIS
+
+        void PerfCounters::Close();
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void PerfCounters::Close()
+{
+#ifdef __linux__
+    for (int fd : m_fds) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+    m_fds.clear();
+}
+/* void PerfCounters::Close() */
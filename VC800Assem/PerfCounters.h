@@ -0,0 +1,53 @@
+//
+// Class to read the host CPU's hardware performance counters around a phase.  Counters are read
+// through perf_event_open, so they are only available on Linux; elsewhere, or when the kernel
+// does not allow it, every counter is reported as unavailable.  A phase is counted on the thread
+// that runs it and on the threads it names, such as the workers of the thread pool, and the counts
+// of all of them are added together.
+//
+#pragma once
+
+#include <vector>
+
+class PerfCounters {
+
+public:
+
+    // The hardware events that are counted.
+    enum Event {
+        EV_Cycles,              // CPU cycles.
+        EV_Instructions,        // Instructions retired.
+        EV_BranchMisses,        // Mispredicted branches.
+        EV_L1DMisses,           // Level 1 data cache read misses.
+        EV_LLCMisses,           // Last level cache misses.
+        EV_Count                // Number of events; not an event.
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    // The counters own file descriptors, so they cannot be copied.
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Opens and starts the counters, for the calling thread and the threads whose kernel ids are in
+    // a_threads.  Returns false if none of them could be opened.
+    bool Start(const vector<int> &a_threads = vector<int>());
+
+    // Stops the counters and records their values.
+    void Stop();
+
+    // Returns the value counted for an event, or -1 if it could not be counted.
+    long long Get(Event a_event) const { return m_values[a_event]; }
+
+    // Returns the name an event is reported under.
+    static const char *Name(Event a_event);
+
+private:
+
+    vector<int> m_fds;                  // The counter file descriptors, EV_Count for each thread counted.
+    long long m_values[EV_Count];       // The values read by Stop, or -1 if not counted.
+
+    // Closes any counters that are open.
+    void Close();
+};
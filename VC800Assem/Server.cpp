@@ -0,0 +1,601 @@
+//
+//      Implementation of the assembly server.
+//
+#include "stdafx.h"
+#include "Server.h"
+
+#include <thread>
+
+#include "Assembler.h"
+#include "AssemblyCache.h"
+#include "Emulator.h"
+#include "Instrument.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef __linux__
+#include <fcntl.h>
+#endif
+#endif
+
+namespace {
+
+    // The first line of a job, and of its reply.
+    const char JobHeader[] = "VC8000 job 1";
+    const char ReplyHeader[] = "VC8000 result 1";
+
+    // The longest line other than a field's bytes.
+    const size_t MaxLineBytes = 256;
+
+    // The fields of a job that are kept.  Any others are read past.
+    const char *const JobFields[] = { "source", "key", "name", "input", "run", "instructions", "output" };
+
+    // Returns true if a field is one of those kept.
+    bool IsJobField( const string &a_name )
+    {
+        for( const char *field : JobFields ) {
+            if( a_name == field ) return true;
+        }
+        return false;
+    }
+
+    // Reads a number that is all digits.  Returns false if there is not one.
+    bool ParseCount( string_view a_text, size_t &a_count )
+    {
+        if( a_text.empty() || a_text.size() > 18 ) return false;
+        a_count = 0;
+        for( char ch : a_text ) {
+            if( ch < '0' || ch > '9' ) return false;
+            a_count = a_count * 10 + ( ch - '0' );
+        }
+        return true;
+    }
+
+    // Adds a field to a job or a reply.
+    void WriteField( string &a_out, const string &a_name, string_view a_value )
+    {
+        a_out += a_name;
+        a_out += ' ';
+        a_out += to_string( a_value.size() );
+        a_out += '\n';
+        a_out += a_value;
+        a_out += '\n';
+    }
+
+    // Finds a field of a job.  Returns null if it was not sent.
+    const string *FindField( const map<string, string> &a_job, const char *a_name )
+    {
+        auto field = a_job.find( a_name );
+        return field == a_job.end() ? nullptr : &field->second;
+    }
+
+    // Lowers a limit to what a job asks for, if it asks for less.  Returns false if it is not a number.
+    template <typename T>
+    bool LowerLimit( const map<string, string> &a_job, const char *a_name, T &a_limit )
+    {
+        const string *value = FindField( a_job, a_name );
+        size_t asked;
+        if( value == nullptr ) return true;
+        if( !ParseCount( *value, asked ) ) return false;
+        if( asked > 0 && ( a_limit == 0 || asked < (size_t)a_limit ) ) a_limit = (T)asked;
+        return true;
+    }
+
+#ifndef _WIN32
+    // Opens a Unix domain socket that is closed in any program the server starts.  Returns -1 if it could not
+    // be opened.  Only Linux can do this as the socket is made.
+    int OpenSocket( )
+    {
+#ifdef __linux__
+        return socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+#else
+        int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+        if( fd >= 0 ) fcntl( fd, F_SETFD, FD_CLOEXEC );
+        return fd;
+#endif
+    }
+
+    // Takes a connection from a listening socket, closed in any program the server starts as OpenSocket's
+    // are.  Returns -1, with errno set, if there was none.
+    int AcceptConnection( int a_listener )
+    {
+#ifdef __linux__
+        return accept4( a_listener, nullptr, nullptr, SOCK_CLOEXEC );
+#else
+        int fd = accept( a_listener, nullptr, nullptr );
+        if( fd >= 0 ) fcntl( fd, F_SETFD, FD_CLOEXEC );
+        return fd;
+#endif
+    }
+
+    // Reads what a client sends, a line or a number of bytes at a time, through a buffer.
+    class SocketReader {
+
+    public:
+
+        explicit SocketReader( int a_socket ) : m_socket( a_socket ) { }
+
+        // Reads a line, without its newline.  Returns false if the connection ended, or the line is longer
+        // than a_max.
+        bool ReadLine( string &a_line, size_t a_max ) {
+            a_line.clear();
+            for( ;; ) {
+                if( m_pos == m_end && !Fill() ) return false;
+                const char *start = m_buffer + m_pos;
+                const char *newline = (const char *)memchr( start, '\n', m_end - m_pos );
+                size_t count = newline == nullptr ? m_end - m_pos : newline - start;
+                if( a_line.size() + count > a_max ) return false;
+                a_line.append( start, count );
+                m_pos += count;
+                if( newline != nullptr ) {
+                    m_pos++;
+                    return true;
+                }
+            }
+        }
+
+        // Reads a number of bytes.  Returns false if the connection ended first.
+        bool Read( size_t a_count, string &a_bytes ) {
+            a_bytes.clear();
+            a_bytes.reserve( a_count );
+            while( a_bytes.size() < a_count ) {
+                if( m_pos == m_end && !Fill() ) return false;
+                size_t count = min( a_count - a_bytes.size(), m_end - m_pos );
+                a_bytes.append( m_buffer + m_pos, count );
+                m_pos += count;
+            }
+            return true;
+        }
+
+        // Reads past a number of bytes without keeping them.  Returns false if the connection ended first.
+        bool Skip( size_t a_count ) {
+            while( a_count > 0 ) {
+                if( m_pos == m_end && !Fill() ) return false;
+                size_t count = min( a_count, m_end - m_pos );
+                m_pos += count;
+                a_count -= count;
+            }
+            return true;
+        }
+
+    private:
+
+        // Reads what has arrived into the empty buffer, waiting for something if need be.  Returns false if
+        // the connection ended, or nothing arrived in time.
+        bool Fill( ) {
+            ssize_t count;
+            do count = recv( m_socket, m_buffer, sizeof m_buffer, 0 );
+            while( count < 0 && errno == EINTR );
+            if( count <= 0 ) return false;
+            m_pos = 0;
+            m_end = (size_t)count;
+            return true;
+        }
+
+        int m_socket;                   // The connection.
+        char m_buffer[65536];           // What has arrived and not been read.
+        size_t m_pos = 0;               // The first byte of the buffer not read.
+        size_t m_end = 0;               // The end of what has arrived.
+    };
+
+    // Sends the whole of a reply.  Returns false if the connection ended.
+    bool SendAll( int a_socket, string_view a_text )
+    {
+        while( !a_text.empty() ) {
+            ssize_t count = send( a_socket, a_text.data(), a_text.size(), 0 );
+            if( count < 0 && errno == EINTR ) continue;
+            if( count <= 0 ) return false;
+            a_text.remove_prefix( (size_t)count );
+        }
+        return true;
+    }
+#endif
+}
+
+/**/
+/*
+NAME
+
+        AssemblyServer::AssemblyServer - listens on a socket.
+
+SYNOPSIS
+
+        AssemblyServer::AssemblyServer( const string &a_path, unsigned a_workers, const Limits &a_limits );
+            a_path      --> the path of the socket.
+            a_workers   --> the number of jobs run at once, or 0 for one per core.
+            a_limits    --> the most any job may do.
+
+DESCRIPTION
+
+        A socket already at the path that no server answers on was left by one that stopped without removing
+        it, and is replaced; one that a server answers on is left alone, and so is anything that is not a
+        socket.  The server is not listening if the socket could not be made, which IsListening tells.
+        Unix domain sockets are not used on Windows, so a server there never listens.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+AssemblyServer::AssemblyServer( const string &a_path, unsigned a_workers, const Limits &a_limits )
+    : m_path( a_path ), m_workers( a_workers ), m_limits( a_limits )
+{
+    if( m_workers == 0 ) m_workers = max( 1u, thread::hardware_concurrency() );
+#ifndef _WIN32
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if( m_path.empty() || m_path.size() >= sizeof address.sun_path ) return;
+    memcpy( address.sun_path, m_path.c_str(), m_path.size() );
+
+    struct stat status;
+    if( lstat( m_path.c_str(), &status ) == 0 ) {
+        if( !S_ISSOCK( status.st_mode ) ) return;
+        int probe = OpenSocket();
+        bool answered = probe >= 0 && connect( probe, (sockaddr *)&address, sizeof address ) == 0;
+        bool stale = !answered && errno == ECONNREFUSED;
+        if( probe >= 0 ) close( probe );
+        if( !stale ) return;
+        unlink( m_path.c_str() );
+    }
+
+    m_listener = OpenSocket();
+    if( m_listener < 0 ) return;
+    if( ::bind( m_listener, (sockaddr *)&address, sizeof address ) != 0 || listen( m_listener, SOMAXCONN ) != 0 ) {
+        close( m_listener );
+        m_listener = -1;
+    }
+#endif
+}
+
+// Stops listening and removes the socket, so that a client finds no server rather than one that does not answer.
+AssemblyServer::~AssemblyServer()
+{
+#ifndef _WIN32
+    if( m_listener < 0 ) return;
+    close( m_listener );
+    unlink( m_path.c_str() );
+#endif
+}
+
+// Serves jobs on as many threads as there are workers, this one among them, until the socket fails.  A
+// client that goes away before its reply is sent must not stop the server, so SIGPIPE is ignored.
+void AssemblyServer::Serve( )
+{
+#ifndef _WIN32
+    if( !IsListening() ) return;
+    signal( SIGPIPE, SIG_IGN );
+
+    vector<thread> workers;
+    for( unsigned i = 1; i < m_workers; i++ ) workers.emplace_back( [this] { Work(); } );
+    Work();
+    for( thread &worker : workers ) worker.join();
+#endif
+}
+
+/**/
+/*
+NAME
+
+        AssemblyServer::Work - takes connections and serves their jobs.
+
+SYNOPSIS
+
+        void AssemblyServer::Work( );
+
+DESCRIPTION
+
+        Each worker makes its emulator once and runs every program it is sent on it, so that the memory of
+        the VC8000 is only filled when the worker starts.  The workers wait in accept() together and the
+        kernel hands each connection to one of them.  A connection that sends nothing for IdleSeconds is
+        closed, so that a client that stops halfway cannot hold a worker.  Running out of descriptors or
+        memory for a moment is waited out.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void AssemblyServer::Work( )
+{
+#ifndef _WIN32
+    emulator emul;
+    for( ;; ) {
+        int connection = AcceptConnection( m_listener );
+        if( connection < 0 ) {
+            if( errno == EINTR || errno == ECONNABORTED ) continue;
+            if( errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM ) {
+                this_thread::sleep_for( chrono::milliseconds( 100 ) );
+                continue;
+            }
+            return;
+        }
+        timeval timeout = { IdleSeconds, 0 };
+        setsockopt( connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout );
+        setsockopt( connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout );
+        ServeConnection( connection, emul );
+        close( connection );
+    }
+#endif
+}
+
+/**/
+/*
+NAME
+
+        AssemblyServer::ServeConnection - serves the jobs of a connection.
+
+SYNOPSIS
+
+        void AssemblyServer::ServeConnection( int a_socket, emulator &a_emul );
+            a_socket    --> the connection.
+            a_emul      --> the emulator of the worker.
+
+DESCRIPTION
+
+        Jobs are read and answered one after another until the client closes the connection.  A job that
+        cannot be done, such as one naming a program that is not kept, gets a reply with status "error" and
+        the connection goes on.  A field that is not one of a job's is read past and dropped.  Something
+        that is not a job, a field larger than MaxFieldBytes, or fields that together are larger than
+        MaxJobBytes, gets the same reply, but the connection is then closed, since where the next job
+        starts is not known.
+        The phases each job records are dropped once it is answered, so that a server that runs for a long
+        time does not grow.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void AssemblyServer::ServeConnection( int a_socket, emulator &a_emul )
+{
+#ifndef _WIN32
+    SocketReader in( a_socket );
+    string line;
+    while( in.ReadLine( line, MaxLineBytes ) ) {
+        map<string, string> job;
+        size_t jobBytes = 0;
+        string reason;
+        bool framed = line == JobHeader;
+        if( !framed ) reason = "expected \"" + string( JobHeader ) + "\"";
+
+        while( framed ) {
+            if( !in.ReadLine( line, MaxLineBytes ) ) return;
+            if( line == "end" ) break;
+            size_t space = line.find( ' ' ), size;
+            string name = line.substr( 0, space );
+            if( space == string::npos || !ParseCount( string_view( line ).substr( space + 1 ), size ) ) {
+                reason = "expected a field or \"end\", not \"" + line + "\"";
+                framed = false;
+            }
+            else if( size > MaxFieldBytes ) {
+                reason = "the " + name + " field is larger than the " + to_string( MaxFieldBytes ) + " bytes allowed";
+                framed = false;
+            }
+            else if( size > MaxJobBytes - jobBytes ) {
+                reason = "the fields of the job are larger than the " + to_string( MaxJobBytes ) + " bytes allowed";
+                framed = false;
+            }
+            else {
+                jobBytes += size;
+                bool read = IsJobField( name ) ? in.Read( size, job[name] ) : in.Skip( size );
+                if( !read || !in.ReadLine( line, 0 ) ) return;
+            }
+        }
+
+        Fields reply;
+        string out = ReplyHeader;
+        out += '\n';
+        if( framed && RunJob( job, a_emul, reply, reason ) ) {
+            WriteField( out, "status", "ok" );
+            for( const auto &field : reply ) WriteField( out, field.first, field.second );
+        }
+        else {
+            WriteField( out, "status", "error" );
+            WriteField( out, "message", reason );
+        }
+        out += "end\n";
+        Instrument::ClearPhases();
+        if( !SendAll( a_socket, out ) || !framed ) return;
+    }
+#endif
+}
+
+/**/
+/*
+NAME
+
+        AssemblyServer::RunJob - does a job.
+
+SYNOPSIS
+
+        bool AssemblyServer::RunJob( const map<string, string> &a_job, emulator &a_emul, Fields &a_reply,
+            string &a_reason );
+            a_job       --> the fields of the job, by name.
+            a_emul      --> the emulator of the worker.
+            a_reply     --> what the job did, added to as it is done.
+            a_reason    --> set to why the job could not be done, if it could not.
+
+DESCRIPTION
+
+        The program is assembled from its source, unless it is kept already, or found by its key, and then
+        run unless the job asks only to assemble it.  As from the command line, a program with errors is
+        run all the same.  It reads its input from the job and writes its output to the reply, and it is
+        stopped if it runs past the limits of the job, which are the server's unless the job asks for lower
+        ones.  Fields the server does not know are ignored, so that clients can send more than it uses.
+
+RETURNS
+
+        Returns true if the job was done, and false if it was not.
+
+*/
+/**/
+bool AssemblyServer::RunJob( const map<string, string> &a_job, emulator &a_emul, Fields &a_reply,
+    string &a_reason )
+{
+    Limits limits = m_limits;
+    if( !LowerLimit( a_job, "instructions", limits.instructions ) || !LowerLimit( a_job, "output", limits.output ) ) {
+        a_reason = "a limit must be a number";
+        return false;
+    }
+    const string *source = FindField( a_job, "source" );
+    const string *key = FindField( a_job, "key" );
+    const string *name = FindField( a_job, "name" );
+    const string *input = FindField( a_job, "input" );
+    const string *run = FindField( a_job, "run" );
+
+    shared_ptr<const Program> program;
+    if( source != nullptr ) {
+        double start = Instrument::ElapsedUs();
+        string programKey;
+        bool kept;
+        program = Assemble( *source, name != nullptr ? *name : "job", programKey, kept );
+        a_reply.push_back( { "key", programKey } );
+        a_reply.push_back( { "kept", kept ? "1" : "0" } );
+        a_reply.push_back( { "errors", to_string( program->errors ) } );
+        a_reply.push_back( { "listing", program->listing } );
+        a_reply.push_back( { "symbols", program->symbols } );
+        a_reply.push_back( { "diagnostics", program->diagnostics } );
+        a_reply.push_back( { "assemble_us", to_string( (long long)( Instrument::ElapsedUs() - start ) ) } );
+    }
+    else if( key != nullptr ) {
+        program = FindProgram( *key );
+        if( !program ) {
+            a_reason = "no program is kept under the key " + *key;
+            return false;
+        }
+        a_reply.push_back( { "key", *key } );
+        a_reply.push_back( { "errors", to_string( program->errors ) } );
+    }
+    else {
+        a_reason = "a job needs a source or a key";
+        return false;
+    }
+    if( run != nullptr && *run == "0" ) return true;
+
+    double start = Instrument::ElapsedUs();
+    istringstream in( input != nullptr ? *input : string() );
+    ostringstream out;
+    a_emul.setStreams( in, out );
+    a_emul.setLimits( limits.instructions, limits.output );
+    bool halted = a_emul.loadImage( program->image ) && a_emul.runLoadedProgram();
+    a_emul.setStreams( cin, cout );
+
+    const DiagnosticLog &diags = a_emul.getDiagnostics();
+    if( halted ) a_reply.push_back( { "exit", "halted" } );
+    else {
+        a_reply.push_back( { "exit", Diagnostics::GetName( diags.GetDiagnostics().front().code ) } );
+        ostringstream message;
+        diags.Display( message );
+        a_reply.push_back( { "message", message.str() } );
+    }
+    a_reply.push_back( { "output", out.str() } );
+    a_reply.push_back( { "instructions", to_string( a_emul.getInstructionCount() ) } );
+    a_reply.push_back( { "run_us", to_string( (long long)( Instrument::ElapsedUs() - start ) ) } );
+    return true;
+}
+/* bool AssemblyServer::RunJob( const map<string, string> &a_job, emulator &a_emul, Fields &a_reply,
+    string &a_reason ) */
+
+/**/
+/*
+NAME
+
+        AssemblyServer::Assemble - assembles a source, or finds it among the programs kept.
+
+SYNOPSIS
+
+        shared_ptr<const Program> AssemblyServer::Assemble( const string &a_source, const string &a_name,
+            string &a_key, bool &a_kept );
+            a_source    --> the text of the program.
+            a_name      --> the name of the source in its diagnostics.
+            a_key       --> set to the key the program is kept under.
+            a_kept      --> set to true if the program was kept already, so it was not assembled.
+
+DESCRIPTION
+
+        The key is made from the source and its name, as the assembly cache makes its keys.  A source that is
+        not kept is assembled by Pass I and Pass II, on the shared thread pool, and its listings and
+        diagnostics are kept with the memory image, so that they can be sent again without assembling it.
+
+RETURNS
+
+        Returns the program.
+
+*/
+/**/
+shared_ptr<const AssemblyServer::Program> AssemblyServer::Assemble( const string &a_source, const string &a_name,
+    string &a_key, bool &a_kept )
+{
+    a_key = AssemblyCache::MakeKey( a_source, "server " + a_name );
+    shared_ptr<const Program> kept = FindProgram( a_key );
+    a_kept = kept != nullptr;
+    if( a_kept ) return kept;
+
+    Assembler assem( a_name, a_source );
+    assem.PassI();
+    assem.PassII();
+
+    shared_ptr<Program> program = make_shared<Program>();
+    program->image = assem.GetImage();
+    program->errors = assem.GetErrorCount();
+    {
+        ListingWriter listing;
+        assem.ListTranslation( listing );
+        program->listing = listing.GetText();
+    }
+    {
+        ListingWriter symbols;
+        assem.ListSymbolTable( symbols );
+        program->symbols = symbols.GetText();
+    }
+    ostringstream diagnostics;
+    assem.WriteDiagnostics( diagnostics );
+    program->diagnostics = diagnostics.str();
+    program->bytes = sizeof( Program ) + a_key.size() + program->image.GetExtent() * sizeof( long long )
+        + program->listing.size() + program->symbols.size() + program->diagnostics.size();
+
+    KeepProgram( a_key, program );
+    return program;
+}
+/* shared_ptr<const Program> AssemblyServer::Assemble( const string &a_source, const string &a_name,
+    string &a_key, bool &a_kept ) */
+
+// Finds the program kept under a key, marking it as used now.
+shared_ptr<const AssemblyServer::Program> AssemblyServer::FindProgram( const string &a_key )
+{
+    lock_guard<mutex> guard( m_programsLock );
+    auto found = m_programs.find( a_key );
+    if( found == m_programs.end() ) return nullptr;
+    found->second->lastUse = ++m_jobs;
+    return found->second;
+}
+
+// Keeps a program under a key, replacing any kept under it, and removes the programs used least recently,
+// other than this one, until the rest fit in ProgramCapacity.
+void AssemblyServer::KeepProgram( const string &a_key, const shared_ptr<Program> &a_program )
+{
+    lock_guard<mutex> guard( m_programsLock );
+    a_program->lastUse = ++m_jobs;
+    shared_ptr<Program> &slot = m_programs[a_key];
+    if( slot ) m_programBytes -= slot->bytes;
+    slot = a_program;
+    m_programBytes += a_program->bytes;
+
+    while( m_programBytes > ProgramCapacity && m_programs.size() > 1 ) {
+        auto oldest = m_programs.end();
+        for( auto it = m_programs.begin(); it != m_programs.end(); ++it ) {
+            if( it->second == a_program ) continue;
+            if( oldest == m_programs.end() || it->second->lastUse < oldest->second->lastUse ) oldest = it;
+        }
+        m_programBytes -= oldest->second->bytes;
+        m_programs.erase( oldest );
+    }
+}
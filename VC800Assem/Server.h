@@ -0,0 +1,127 @@
+//
+//		Assembly server, which assembles and runs the programs sent to it over a local socket.
+//
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MemoryImage.h"
+
+class emulator;
+
+// A resident assembler for a grader or an editor that would otherwise start the assembler, and fill the
+// emulator's memory, for each program.  Clients connect to a Unix domain socket and send jobs, one after
+// another on a connection.  A job is a line "VC8000 job 1", then fields, each a line with its name and
+// size followed by that many bytes and a newline, and then a line "end".  Its fields are these, and any
+// others are read past:
+//
+//      source          the text of a program to assemble
+//      key             the key of a program assembled before, to run it again without the source
+//      name            the name of the source in its diagnostics ("job" if not given)
+//      input           what the program reads, a number to a line
+//      run             0 to only assemble the program (1 if not given)
+//      instructions    the most instructions the program may execute, within the server's limit
+//      output          the most bytes the program may write, within the server's limit
+//
+// The reply is a line "VC8000 result 1" and fields in the same form, then "end".  status is "ok", or
+// "error" with the reason in message for a job that could not be done.  An assembled program has its key,
+// kept (1 if it was kept already, so it was not assembled again), errors, listing, symbols and diagnostics
+// (as JSON); one that is run has its exit ("halted", or the name of the error that stopped it), message,
+// output and instructions.  assemble_us and run_us are how long each took, in microseconds.
+//
+// Each worker thread takes connections in turn and keeps an emulator of its own, which only clears the
+// memory the last program could have written.  Programs are kept by key, the most recently used up to
+// ProgramCapacity bytes, so that a program run on many inputs, or sent again unchanged, is not assembled
+// again.
+class AssemblyServer {
+
+public:
+
+    // The most a job may do, unless it asks for less.  Zero is no limit.
+    struct Limits {
+        long long instructions = 0;     // The most instructions a program may execute.
+        size_t output = 0;              // The most bytes a program may write.
+    };
+
+    // The limits of a server when none are given.
+    static const long long DefaultInstructions = 100'000'000;
+    static const size_t DefaultOutput = 1 << 20;
+
+    // The most bytes one field of a job may hold.
+    static const size_t MaxFieldBytes = 64 << 20;
+
+    // The most bytes all the fields of a job may hold together, those read past included.
+    static const size_t MaxJobBytes = 128 << 20;
+
+    // The most bytes of assembled programs kept for jobs that name them by key.
+    static const size_t ProgramCapacity = 256 << 20;
+
+    // How long a connection may wait between the parts of a job, in seconds, before it is closed.
+    static const int IdleSeconds = 30;
+
+    // Listens on a socket at a_path, replacing one left by a server that is no longer running.  a_workers is
+    // the number of jobs run at once, or 0 for one per core.
+    AssemblyServer( const string &a_path, unsigned a_workers, const Limits &a_limits );
+
+    // Stops listening, and removes the socket.
+    ~AssemblyServer();
+
+    AssemblyServer( const AssemblyServer & ) = delete;
+    AssemblyServer &operator=( const AssemblyServer & ) = delete;
+
+    // Returns true if the server is listening.
+    bool IsListening( ) const { return m_listener >= 0; }
+
+    // Serves jobs until the socket can no longer be listened on.
+    void Serve( );
+
+private:
+
+    // The fields of a job or of its reply, in order.
+    typedef vector<pair<string, string>> Fields;
+
+    // An assembled program, as it is kept to be run again.
+    struct Program {
+        MemoryImage image;              // The program.
+        size_t errors = 0;              // The number of errors found assembling it.
+        string listing;                 // The translation listing.
+        string symbols;                 // The symbol table.
+        string diagnostics;             // The diagnostics, as JSON.
+        unsigned long long lastUse = 0; // When it was last used, in jobs served.
+        size_t bytes = 0;               // The memory it takes.
+    };
+
+    // Takes connections and serves their jobs, with an emulator of its own, until the socket fails.
+    void Work( );
+
+    // Serves the jobs of a connection until it is closed or sends something that is not a job.
+    void ServeConnection( int a_socket, emulator &a_emul );
+
+    // Does a job, adding what it did to a_reply.  Returns false, with the reason, if it could not be done.
+    bool RunJob( const map<string, string> &a_job, emulator &a_emul, Fields &a_reply, string &a_reason );
+
+    // Assembles a source, or finds it among the programs kept.
+    shared_ptr<const Program> Assemble( const string &a_source, const string &a_name, string &a_key,
+        bool &a_kept );
+
+    // Finds the program kept under a key.  Returns null if there is none.
+    shared_ptr<const Program> FindProgram( const string &a_key );
+
+    // Keeps a program under a key, removing those used least recently if there is no room for it.
+    void KeepProgram( const string &a_key, const shared_ptr<Program> &a_program );
+
+    string m_path;                      // The path of the socket.
+    int m_listener = -1;                // The socket connections are taken from, or -1.
+    unsigned m_workers;                 // The number of worker threads.
+    Limits m_limits;                    // The most any job may do.
+
+    mutex m_programsLock;               // Guards the members below.
+    map<string, shared_ptr<Program>> m_programs;    // The programs kept, by key.
+    size_t m_programBytes = 0;          // The memory they take.
+    unsigned long long m_jobs = 0;      // The number of jobs that found or kept a program.
+};
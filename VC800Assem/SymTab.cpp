@@ -3,6 +3,7 @@
 //
 #include "stdafx.h"
 #include "SymTab.h"
+#include "ListingWriter.h"
 
 /**/
 /*
@@ -12,30 +13,23 @@ NAME
 
 SYNOPSIS
 
-    void AddSymbol( const string &a_symbol, int a_loc );
+    void AddSymbol( string_view a_symbol, int a_loc );
     	a_symbol	-> The name of the symbol to be added to the symbol table.
     	a_loc		-> the location to be associated with the symbol.
 
 DESCRIPTION
 
     This function will place the symbol "a_symbol" and its location "a_loc"
-    in the symbol table.
+    in the symbol table.  If the symbol is already defined, it is recorded as
+    multiply defined.
 */
 /**/
 void 
-SymbolTable::AddSymbol( const string &a_symbol, int a_loc )
+SymbolTable::AddSymbol( string_view a_symbol, int a_loc )
 {
-    // If the symbol is already in the symbol table, record it as multiply defined.
-    map<string, int>::iterator st = m_symbolTable.find( a_symbol );
-    if( st != m_symbolTable.end() ) {
-
-        st->second = multiplyDefinedSymbol;
-        return;
-    }
-    // Record a the location in the symbol table.
-    m_symbolTable[a_symbol] = a_loc;
+    DefineSymbol( InternSymbol( a_symbol ), a_loc );
 }
-/* void SymbolTable::AddSymbol( const string &a_symbol, int a_loc ) */
+/* void SymbolTable::AddSymbol( string_view a_symbol, int a_loc ) */
 
 /**/
 /*
@@ -45,13 +39,13 @@ NAME
 
 SYNOPSIS
 
-    void AddSymbol( const string &a_symbol, int a_loc );
-        a_symbol	-> The name of the symbol to be added to the symbol table.
-        a_loc		-> the location to be associated with the symbol.
+    void SymbolTable::DisplaySymbolTable( ListingWriter &a_out );
+        a_out		-> the listing to write the table to.
 
 DESCRIPTION
 
-    This function will display all symbols and locations recorded in the symbol table.
+    This function will display all symbols and locations recorded in the symbol table,
+    sorted by name.
 
 RETURNS
 
@@ -60,21 +54,35 @@ RETURNS
 */
 /**/
 void
-SymbolTable::DisplaySymbolTable()
+SymbolTable::DisplaySymbolTable( ListingWriter &a_out )
 {
     // Print header
-    cout << setw(10) << "Symbol #" << setw(15) << "Symbol" << setw(15) << "Location" << endl;
+    a_out.WriteRight( "Symbol #", 10 );
+    a_out.WriteRight( "Symbol", 15 );
+    a_out.WriteRight( "Location", 15 );
+    a_out.EndLine();
 
-    // Iterate through the map and print each entry
+    // The table is not kept in order, so sort the defined symbols by name only now.
+    vector<int> sorted;
+    sorted.reserve( m_symbols.size() );
+    for( int id = 0; id < (int)m_symbols.size(); id++ ) {
+        if( m_symbols[id].defined ) sorted.push_back( id );
+    }
+    sort( sorted.begin(), sorted.end(), [this]( int a, int b ) {
+        return Name( m_symbols[a] ) < Name( m_symbols[b] );
+    } );
+
+    // Print each entry
     int index = 0;
-    for (const auto& pair : m_symbolTable) {
-        cout << setw(10) << index++
-            << setw(15) << pair.first
-            << setw(15) << pair.second << endl;
+    for( int id : sorted ) {
+        a_out.WriteRight( index++, 10 );
+        a_out.WriteRight( Name( m_symbols[id] ), 15 );
+        a_out.WriteRight( m_symbols[id].loc, 15 );
+        a_out.EndLine();
     }
 
 }
-/* void SymbolTable::DisplaySymbolTable() */
+/* void SymbolTable::DisplaySymbolTable( ListingWriter &a_out ) */
 
 /**/
 /*
@@ -84,7 +92,7 @@ NAME
 
 SYNOPSIS
 
-    bool SymbolTable::LookupSymbol( const string& a_symbol, int& a_loc );
+    bool SymbolTable::LookupSymbol( string_view a_symbol, int& a_loc ) const;
         a_symbol	-> the name of the symbol to look up.
         a_loc		-> the location to record the symbol value to.
 
@@ -98,14 +106,376 @@ RETURN
 
 */
 /**/
-bool SymbolTable::LookupSymbol(const string& a_symbol, int& a_loc)
+bool SymbolTable::LookupSymbol(string_view a_symbol, int& a_loc) const
+{
+    if (m_slots.empty()) return false;
+
+    int id = m_slots[FindSlot(a_symbol, Hash(a_symbol))]; // Check if the symbol exists in the table
+    return id >= 0 && LookupSymbol(id, a_loc);
+
+}
+/* bool SymbolTable::LookupSymbol(string_view a_symbol, int& a_loc) const */
+/**/
+/*
+NAME
+
+    SymbolTable::InternSymbol - gets the id of a symbol.
+
+SYNOPSIS
+
+    int SymbolTable::InternSymbol( string_view a_symbol );
+        a_symbol	-> the name of the symbol.
+
+DESCRIPTION
+
+    This function finds the symbol in the table.  If it is not there, its name is copied to the
+    end of the names and it is added as a symbol that is not yet defined.  Ids are given out in
+    order from zero, so they can index arrays kept alongside the table.
+
+RETURN
+
+    This function returns the id of the symbol.
+
+*/
+/**/
+int SymbolTable::InternSymbol( string_view a_symbol )
+{
+    // Keep the table at most half full, so that searches are short.
+    if( ( m_symbols.size() + 1 ) * 2 > m_slots.size() ) Rehash( ( m_symbols.size() + 1 ) * 2 );
+
+    unsigned hash = Hash( a_symbol );
+    size_t slot = FindSlot( a_symbol, hash );
+    if( m_slots[slot] >= 0 ) return m_slots[slot];
+
+    // Add the name to the end of the names and the symbol to the end of the symbols.
+    int id = (int)m_symbols.size();
+    m_symbols.push_back( { hash, (unsigned)m_names.size(), (unsigned)a_symbol.size(), 0, false, false, false } );
+    m_names.append( a_symbol );
+    m_slots[slot] = id;
+    return id;
+}
+/* int SymbolTable::InternSymbol( string_view a_symbol ) */
+
+/**/
+/*
+NAME
+
+    SymbolTable::DefineSymbol - adds a new symbol to the symbol table by its id.
+
+SYNOPSIS
+
+    void SymbolTable::DefineSymbol( int a_id, int a_loc );
+        a_id		-> the id of the symbol, from InternSymbol.
+        a_loc		-> the location to be associated with the symbol.
+
+DESCRIPTION
+
+    This function records the location of the symbol.  If the symbol is already defined, or is
+    imported, it is recorded as multiply defined instead.
+
+RETURN
+
+    This function does not return any value.
+
+*/
+/**/
+void SymbolTable::DefineSymbol( int a_id, int a_loc )
+{
+    Symbol &symbol = m_symbols[a_id];
+    symbol.loc = ( symbol.defined || symbol.imported ) ? multiplyDefinedSymbol : a_loc;
+    symbol.defined = true;
+}
+/* void SymbolTable::DefineSymbol( int a_id, int a_loc ) */
+
+/**/
+/*
+NAME
+
+    SymbolTable::ImportSymbol - records that a symbol is defined in another module.
+
+SYNOPSIS
+
+    void SymbolTable::ImportSymbol( int a_id );
+        a_id		-> the id of the symbol, from InternSymbol.
+
+DESCRIPTION
+
+    This function marks the symbol as imported, so that references to it are left for the linker.
+    An imported symbol is not defined, so LookupSymbol does not find it.  If the symbol is already
+    defined, it is recorded as multiply defined.  Importing a symbol twice is not an error.
+
+RETURN
+
+    This function does not return any value.
+
+*/
+/**/
+void SymbolTable::ImportSymbol( int a_id )
+{
+    Symbol &symbol = m_symbols[a_id];
+    if( symbol.defined ) symbol.loc = multiplyDefinedSymbol;
+    if( !symbol.imported ) m_importCount++;
+    symbol.imported = true;
+}
+/* void SymbolTable::ImportSymbol( int a_id ) */
+
+// Remove all the symbols, keeping the memory for the next ones, for a program assembled again.
+void SymbolTable::Clear( )
+{
+    m_names.clear();
+    m_symbols.clear();
+    fill( m_slots.begin(), m_slots.end(), -1 );
+    m_importCount = 0;
+}
+
+// Record that a symbol can be referred to from other modules.  Whether it is defined is only known
+// once the symbol table is final.
+void SymbolTable::ExportSymbol( int a_id )
+{
+    m_symbols[a_id].exported = true;
+}
+
+// Return true if a symbol is imported.
+bool SymbolTable::IsImported( string_view a_symbol ) const
+{
+    if( m_importCount == 0 ) return false;
+
+    int id = m_slots[FindSlot( a_symbol, Hash( a_symbol ) )];
+    return id >= 0 && m_symbols[id].imported;
+}
+
+/**/
+/*
+NAME
+
+    SymbolTable::GetImportedSymbols - gets the symbols the linker must supply.
+
+SYNOPSIS
+
+    vector<string_view> SymbolTable::GetImportedSymbols( ) const;
+
+DESCRIPTION
+
+    This function lists the symbols that are imported and not also defined here, sorted by name.
+    The names are views of the table, so they last as long as it does.
+
+RETURN
+
+    This function returns the names of the symbols.
+
+*/
+/**/
+vector<string_view> SymbolTable::GetImportedSymbols( ) const
+{
+    vector<string_view> names;
+    for( const Symbol &symbol : m_symbols ) {
+        if( symbol.imported && !symbol.defined ) names.push_back( Name( symbol ) );
+    }
+    sort( names.begin(), names.end() );
+    return names;
+}
+/* vector<string_view> SymbolTable::GetImportedSymbols( ) const */
+
+/**/
+/*
+NAME
+
+    SymbolTable::GetExportedSymbols - gets the symbols other modules can refer to.
+
+SYNOPSIS
+
+    vector<pair<string_view, int>> SymbolTable::GetExportedSymbols( ) const;
+
+DESCRIPTION
+
+    This function lists the symbols that are exported and defined exactly once, with their
+    locations, sorted by name.  An export of a symbol that is not defined, or is multiply defined,
+    is an error in the statement that exports it, so it is left out here.
+
+RETURN
+
+    This function returns the names and locations of the symbols.
+
+*/
+/**/
+vector<pair<string_view, int>> SymbolTable::GetExportedSymbols( ) const
+{
+    vector<pair<string_view, int>> exports;
+    for( const Symbol &symbol : m_symbols ) {
+        if( symbol.exported && symbol.defined && symbol.loc != multiplyDefinedSymbol ) {
+            exports.push_back( { Name( symbol ), symbol.loc } );
+        }
+    }
+    sort( exports.begin(), exports.end() );
+    return exports;
+}
+/* vector<pair<string_view, int>> SymbolTable::GetExportedSymbols( ) const */
+
+/**/
+/*
+NAME
+
+    SymbolTable::LookupSymbol - gets the location of a symbol by its id.
+
+SYNOPSIS
+
+    bool SymbolTable::LookupSymbol( int a_id, int& a_loc ) const;
+        a_id		-> the id of the symbol, from InternSymbol.
+        a_loc		-> the location to record the symbol value to.
+
+DESCRIPTION
+
+    This function assigns the location of the symbol to a_loc if the symbol is defined.
+
+RETURN
+
+    This function returns true if the symbol is defined, and false if it is not.
+
+*/
+/**/
+bool SymbolTable::LookupSymbol( int a_id, int& a_loc ) const
+{
+    const Symbol &symbol = m_symbols[a_id];
+    if( !symbol.defined ) return false;
+
+    a_loc = symbol.loc;
+    return true;
+}
+/* bool SymbolTable::LookupSymbol( int a_id, int& a_loc ) const */
+
+/**/
+/*
+NAME
+
+    SymbolTable::Reserve - makes room for the symbols expected.
+
+SYNOPSIS
+
+    void SymbolTable::Reserve( size_t a_symbols );
+        a_symbols	-> the number of symbols expected.
+
+DESCRIPTION
+
+    This function makes room for a_symbols symbols and their names, so that the table does not
+    have to grow while that many are added.  It is only an estimate: the table still grows past
+    it if more are added, so a guess on the low side costs a rehash or two, where one on the
+    high side costs memory that is never used.
+
+RETURN
+
+    This function does not return any value.
+
+*/
+/**/
+void SymbolTable::Reserve( size_t a_symbols )
+{
+    m_symbols.reserve( a_symbols );
+    m_names.reserve( a_symbols * 8 );
+    if( a_symbols * 2 > m_slots.size() ) Rehash( a_symbols * 2 );
+}
+/* void SymbolTable::Reserve( size_t a_symbols ) */
+
+/**/
+/*
+NAME
+
+    SymbolTable::Hash - computes the hash of the name of a symbol.
+
+SYNOPSIS
+
+    unsigned SymbolTable::Hash( string_view a_symbol );
+        a_symbol	-> the name of the symbol.
+
+DESCRIPTION
+
+    This function computes the 32 bit FNV-1a hash of the name.
+
+RETURN
+
+    This function returns the hash.
+
+*/
+/**/
+unsigned SymbolTable::Hash( string_view a_symbol )
 {
-    auto it = m_symbolTable.find(a_symbol); // Check if the symbol exists in the map
-    if (it != m_symbolTable.end()) { // Symbol found
-        a_loc = it->second; // Assign the location to a_loc
-        return true; // Return true to indicate success
+    unsigned hash = 2166136261u;
+    for( unsigned char c : a_symbol ) {
+        hash = ( hash ^ c ) * 16777619u;
     }
-    return false;
+    return hash;
+}
+/* unsigned SymbolTable::Hash( string_view a_symbol ) */
+
+/**/
+/*
+NAME
+
+    SymbolTable::FindSlot - finds the slot of a symbol.
+
+SYNOPSIS
+
+    size_t SymbolTable::FindSlot( string_view a_symbol, unsigned a_hash ) const;
+        a_symbol	-> the name of the symbol.
+        a_hash		-> the hash of the name.
+
+DESCRIPTION
+
+    This function probes the slots one after another, starting at the one given by the hash, until
+    it finds the symbol or an empty slot.  Names are only compared when their hashes are the same.
+    There is always an empty slot, since the table is never more than half full.
+
+RETURN
+
+    This function returns the slot holding the symbol, or the empty slot where it would be added.
 
+*/
+/**/
+size_t SymbolTable::FindSlot( string_view a_symbol, unsigned a_hash ) const
+{
+    size_t mask = m_slots.size() - 1;
+    for( size_t slot = a_hash & mask; ; slot = ( slot + 1 ) & mask ) {
+        int id = m_slots[slot];
+        if( id < 0 ) return slot;
+
+        const Symbol &symbol = m_symbols[id];
+        if( symbol.hash == a_hash && Name( symbol ) == a_symbol ) return slot;
+    }
+}
+/* size_t SymbolTable::FindSlot( string_view a_symbol, unsigned a_hash ) const */
+
+/**/
+/*
+NAME
+
+    SymbolTable::Rehash - rebuilds the slots of the table.
+
+SYNOPSIS
+
+    void SymbolTable::Rehash( size_t a_slots );
+        a_slots		-> the least number of slots needed.
+
+DESCRIPTION
+
+    This function replaces the slots with a power of two number of them, at least a_slots and at
+    least double the number there were, and puts every symbol back using its saved hash.
+
+RETURN
+
+    This function does not return any value.
+
+*/
+/**/
+void SymbolTable::Rehash( size_t a_slots )
+{
+    size_t size = m_slots.empty() ? 64 : m_slots.size() * 2;
+    while( size < a_slots ) size *= 2;
+
+    m_slots.assign( size, -1 );
+    size_t mask = size - 1;
+    for( int id = 0; id < (int)m_symbols.size(); id++ ) {
+        size_t slot = m_symbols[id].hash & mask;
+        while( m_slots[slot] >= 0 ) slot = ( slot + 1 ) & mask;
+        m_slots[slot] = id;
+    }
 }
-/* bool SymbolTable::LookupSymbol(const string& a_symbol, int& a_loc) */
\ No newline at end of file
+/* void SymbolTable::Rehash( size_t a_slots ) */
@@ -3,26 +3,94 @@
 //
 #pragma once
 
+class ListingWriter;    // Forward declaration
 
-
-// This class is our symbol table.
+// This class is our symbol table.  It is an open addressing hash table.  The names of the symbols are
+// kept one after another in a single string, and each symbol is known by its index, its interned id,
+// so that a label can be referred to before it is defined without keeping a copy of its name.
 class SymbolTable {
 
 public:
-    
+
     const int multiplyDefinedSymbol = -999;
 
+    // Make room for about a_symbols symbols, so that the table does not need to grow.
+    void Reserve( size_t a_symbols );
+
     // Add a new symbol to the symbol table.
-    void AddSymbol( const string &a_symbol, int a_loc );
+    void AddSymbol( string_view a_symbol, int a_loc );
 
     // Display the symbol table.
-    void DisplaySymbolTable();
+    void DisplaySymbolTable( ListingWriter &a_out );
 
     // Lookup a symbol in the symbol table.
-    bool LookupSymbol(const string& a_symbol, int& a_loc);
+    bool LookupSymbol(string_view a_symbol, int& a_loc) const;
+
+    // Get the id of a symbol, adding it as not yet defined if it is not in the table.
+    int InternSymbol( string_view a_symbol );
+
+    // Add a new symbol to the symbol table by its id.
+    void DefineSymbol( int a_id, int a_loc );
+
+    // Lookup a symbol in the symbol table by its id.
+    bool LookupSymbol( int a_id, int& a_loc ) const;
+
+    // Record that a symbol is defined in another module.  A symbol both imported and defined is multiply defined.
+    void ImportSymbol( int a_id );
+
+    // Record that a symbol can be referred to from other modules.
+    void ExportSymbol( int a_id );
+
+    // Return true if a symbol is imported.  An imported symbol is not defined unless it is multiply defined.
+    bool IsImported( string_view a_symbol ) const;
+    bool IsImported( int a_id ) const { return m_symbols[a_id].imported; }
+
+    // Return true if any symbol is imported.
+    bool HasImports() const { return m_importCount > 0; }
+
+    // Get the names of the symbols that are imported and not defined, sorted by name.
+    vector<string_view> GetImportedSymbols() const;
+
+    // Get the names and locations of the symbols that are exported and defined once, sorted by name.
+    vector<pair<string_view, int>> GetExportedSymbols() const;
+
+    // Get the number of ids given out.
+    int GetSymbolCount() const { return (int)m_symbols.size(); }
+
+    // Get the name of a symbol by its id.
+    string_view GetName( int a_id ) const { return Name( m_symbols[a_id] ); }
+
+    // Remove all the symbols, keeping the memory for the next ones.
+    void Clear( );
 
 private:
 
-    // This is the actual symbol table.  The symbol is the key to the map.  The value is the location.
-    map<string, int> m_symbolTable;
+    // A symbol.  The hash of its name is kept so that it need not be recomputed when the table grows,
+    // and so that most names that do not match are rejected without comparing them.
+    struct Symbol {
+        unsigned hash;      // The hash of the name.
+        unsigned offset;    // The offset of the name in m_names.
+        unsigned length;    // The length of the name.
+        int loc;            // The location of the symbol, or multiplyDefinedSymbol.
+        bool defined;       // == true once the symbol is defined.
+        bool imported;      // == true if the symbol is imported from another module.
+        bool exported;      // == true if the symbol is exported to other modules.
+    };
+
+    // Computes the hash of a name.
+    static unsigned Hash( string_view a_symbol );
+
+    // Gets the name of a symbol.
+    string_view Name( const Symbol &a_symbol ) const { return string_view( m_names.data() + a_symbol.offset, a_symbol.length ); }
+
+    // Finds the slot holding a symbol, or the empty slot where it belongs.
+    size_t FindSlot( string_view a_symbol, unsigned a_hash ) const;
+
+    // Rebuilds the slots with room for at least a_slots entries.
+    void Rehash( size_t a_slots );
+
+    string m_names;             // The names of the symbols, one after another.
+    vector<Symbol> m_symbols;   // The symbols, by id.
+    vector<int> m_slots;        // The id of the symbol in each slot, or -1 if it is empty.
+    int m_importCount = 0;      // The number of symbols imported.
 };
@@ -0,0 +1,171 @@
+//
+//      Implementation of the thread pool.
+//
+#include "stdafx.h"
+#include "ThreadPool.h"
+#include "Instrument.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// == true on a thread that is running part of a job.  A job started from inside another job runs in
+// place, since the workers it would need are busy with the outer one.
+static thread_local bool t_inJob = false;
+
+/**/
+/*
+NAME
+
+        ThreadPool::ThreadPool - starts the worker threads.
+
+SYNOPSIS
+
+        ThreadPool::ThreadPool( unsigned a_threads );
+            a_threads   --> the number of threads to run jobs on, or 0 for one per core.
+
+DESCRIPTION
+
+        The thread that starts a job is one of the threads that runs it, so one less worker is started
+        than the number of threads asked for.  The pool is ready once each worker has given its kernel
+        id, so that the ids can be had as soon as it is made.
+
+*/
+/**/
+ThreadPool::ThreadPool( unsigned a_threads )
+{
+    if( a_threads == 0 ) a_threads = thread::hardware_concurrency();
+    m_workerIds.assign( a_threads > 1 ? a_threads - 1 : 0, -1 );
+    for( unsigned i = 1; i < a_threads; i++ ) {
+        m_workers.emplace_back( &ThreadPool::WorkerLoop, this, i );
+    }
+    unique_lock<mutex> lock( m_lock );
+    m_done.wait( lock, [this] { return m_started == m_workers.size(); } );
+}
+/* ThreadPool::ThreadPool( unsigned a_threads ) */
+
+// Stops the workers and waits for them to exit.
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock( m_lock );
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for( thread &worker : m_workers ) worker.join();
+}
+
+/**/
+/*
+NAME
+
+        ThreadPool::ParallelFor - runs a job on all the threads of the pool.
+
+SYNOPSIS
+
+        void ThreadPool::ParallelFor( size_t a_count, const function<void( size_t, unsigned )> &a_body );
+            a_count     --> the number of indexes to run the body for.
+            a_body      --> the body, which is given an index and the number of the thread running it.
+
+DESCRIPTION
+
+        This function wakes the workers and takes part in the job itself as thread 0.  Each thread takes
+        the next index until there are none left, so threads that get quick indexes take more of them.
+        The function returns once every worker has finished its part.  A job with only one index, a pool
+        without workers and a job started from inside another job are run in place.
+
+RETURNS
+
+        This function does not return any value.
+
+*/
+/**/
+void ThreadPool::ParallelFor( size_t a_count, const function<void( size_t, unsigned )> &a_body )
+{
+    if( a_count == 0 ) return;
+    if( m_workers.empty() || a_count == 1 || t_inJob ) {
+        for( size_t i = 0; i < a_count; i++ ) a_body( i, 0 );
+        return;
+    }
+
+    lock_guard<mutex> job( m_jobLock );
+    {
+        lock_guard<mutex> lock( m_lock );
+        m_body = &a_body;
+        m_count = a_count;
+        m_next = 0;
+        m_active = (unsigned)m_workers.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    RunJob( 0 );
+
+    // Wait for the workers, since a_body may refer to the caller's variables.
+    unique_lock<mutex> lock( m_lock );
+    m_done.wait( lock, [this] { return m_active == 0; } );
+    m_body = nullptr;
+}
+/* void ThreadPool::ParallelFor( size_t a_count, const function<void( size_t, unsigned )> &a_body ) */
+
+// Runs indexes of the current job until there are none left.
+void ThreadPool::RunJob( unsigned a_thread )
+{
+    t_inJob = true;
+    for( size_t i = m_next.fetch_add( 1 ); i < m_count; i = m_next.fetch_add( 1 ) ) {
+        ( *m_body )( i, a_thread );
+    }
+    t_inJob = false;
+}
+
+// The loop each worker runs: wait for a job, run part of it, and report when done.
+void ThreadPool::WorkerLoop( unsigned a_thread )
+{
+    unsigned long long seen = 0;
+    unique_lock<mutex> lock( m_lock );
+#ifdef __linux__
+    m_workerIds[a_thread - 1] = (int)syscall( SYS_gettid );
+#endif
+    if( ++m_started == m_workerIds.size() ) m_done.notify_all();
+    for( ; ; ) {
+        m_wake.wait( lock, [&] { return m_stop || m_generation != seen; } );
+        if( m_stop ) return;
+        seen = m_generation;
+
+        lock.unlock();
+        RunJob( a_thread );
+        lock.lock();
+
+        if( --m_active == 0 ) m_done.notify_one();
+    }
+}
+
+/**/
+/*
+NAME
+
+        ThreadPool::Shared - returns the pool shared by the assembler.
+
+SYNOPSIS
+
+        ThreadPool &ThreadPool::Shared();
+
+DESCRIPTION
+
+        The pool is started the first time it is needed.  It has one thread per core unless the
+        VC8000_THREADS environment variable gives another number; VC8000_THREADS=1 runs everything on
+        the calling thread.
+
+RETURNS
+
+        Returns the shared pool.
+
+*/
+/**/
+ThreadPool &ThreadPool::Shared()
+{
+    static ThreadPool pool( (unsigned)max( 0, atoi( Instrument::GetEnvironment( "VC8000_THREADS" ).c_str() ) ) );
+    return pool;
+}
+/* ThreadPool &ThreadPool::Shared() */
@@ -0,0 +1,65 @@
+//
+//		Thread pool, for running the parts of a job on several cores.
+//
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run the parts of one job at a time.  The thread that starts a
+// job takes part in it too, so a pool of one thread has no workers and runs everything in place.
+class ThreadPool {
+
+public:
+
+    // Starts the workers.  A count of zero means one thread per core.
+    explicit ThreadPool( unsigned a_threads = 0 );
+
+    // Stops the workers.
+    ~ThreadPool();
+
+    ThreadPool( const ThreadPool & ) = delete;
+    ThreadPool &operator=( const ThreadPool & ) = delete;
+
+    // Runs a_body( index, thread ) for every index from 0 to a_count - 1, and returns once they are
+    // all done.  thread is below GetThreadCount(), and no two calls at the same time share one, so
+    // it can pick per thread state.  Indexes are handed out in order as threads become free.
+    void ParallelFor( size_t a_count, const function<void( size_t, unsigned )> &a_body );
+
+    // Get the number of threads that run a job, counting the one that starts it.
+    unsigned GetThreadCount() const { return (unsigned)m_workers.size() + 1; }
+
+    // Get the kernel ids of the workers, so that their hardware events can be counted with the thread that
+    // starts a job.  An id is -1 where it is not known.
+    const vector<int> &GetWorkerIds() const { return m_workerIds; }
+
+    // Get the pool shared by the assembler.  VC8000_THREADS sets its number of threads.
+    static ThreadPool &Shared();
+
+private:
+
+    // Runs indexes of the current job until there are none left.
+    void RunJob( unsigned a_thread );
+
+    // The loop each worker runs until the pool is destroyed.
+    void WorkerLoop( unsigned a_thread );
+
+    vector<thread> m_workers;               // The worker threads.
+    vector<int> m_workerIds;                // The kernel id of each worker, set as it starts.
+    unsigned m_started = 0;                 // The number of workers that have set their ids.
+    mutex m_jobLock;                        // Held while a job runs, so that jobs run one at a time.
+    mutex m_lock;                           // Guards the members below.
+    condition_variable m_wake;              // Signalled when a job starts or the pool stops.
+    condition_variable m_done;              // Signalled when the last worker finishes its part of a job.
+    unsigned long long m_generation = 0;    // Counts the jobs started, so workers can tell a new one.
+    unsigned m_active = 0;                  // The number of workers still running the current job.
+    bool m_stop = false;                    // == true when the workers should exit.
+
+    const function<void( size_t, unsigned )> *m_body = nullptr;   // The body of the current job.
+    size_t m_count = 0;                     // The number of indexes in the current job.
+    atomic<size_t> m_next{ 0 };             // The next index of the current job to hand out.
+};
@@ -0,0 +1,122 @@
+//
+// Class to hold the parsed statements of a program between the passes.
+//
+#pragma once
+
+#include "Instruction.h"
+
+// Pass I parses every line once and keeps what it found here, with the location of the line, so that
+// Pass II can translate the lines without parsing them again.  Each field is kept in an array of its
+// own, indexed by line, so that a line takes about 30 bytes rather than a whole Instruction object.
+class TokenCache {
+
+public:
+
+	// Make room for the lines of a program.  Any lines kept before are forgotten.
+	inline void Resize(size_t a_lines) {
+		m_OpCodes.assign(a_lines, (unsigned char)Instruction::SymbolicOpCode::OC_COMM);
+		m_Flags.assign(a_lines, 0);
+		m_Locs.assign(a_lines, 0);
+		m_Values1.assign(a_lines, 0);
+		m_Values2.assign(a_lines, 0);
+		m_Operand1Starts.assign(a_lines, 0);
+		m_Operand1Lengths.assign(a_lines, 0);
+		m_Operand2Starts.assign(a_lines, 0);
+		m_Operand2Lengths.assign(a_lines, 0);
+	}
+
+	// Replace a_oldCount lines from a_first on with room for a_newCount lines, for a source that has changed
+	// there.  The lines after them move along with their fields.
+	inline void Replace(size_t a_first, size_t a_oldCount, size_t a_newCount) {
+		Splice(m_OpCodes, a_first, a_oldCount, a_newCount);
+		Splice(m_Flags, a_first, a_oldCount, a_newCount);
+		Splice(m_Locs, a_first, a_oldCount, a_newCount);
+		Splice(m_Values1, a_first, a_oldCount, a_newCount);
+		Splice(m_Values2, a_first, a_oldCount, a_newCount);
+		Splice(m_Operand1Starts, a_first, a_oldCount, a_newCount);
+		Splice(m_Operand1Lengths, a_first, a_oldCount, a_newCount);
+		Splice(m_Operand2Starts, a_first, a_oldCount, a_newCount);
+		Splice(m_Operand2Lengths, a_first, a_oldCount, a_newCount);
+	}
+
+	// Get the number of lines there is room for.
+	inline size_t GetLineCount() const {
+		return m_OpCodes.size();
+	}
+
+	// Keep the parsed fields of a line and its location.
+	inline void Store(size_t a_line, const Instruction::Tokens &a_tokens, int a_loc) {
+		m_OpCodes[a_line] = (unsigned char)a_tokens.opCode;
+		m_Flags[a_line] = (unsigned char)((a_tokens.formatError ? F_FormatError : 0)
+			| (a_tokens.isNumeric1 ? F_Numeric1 : 0) | (a_tokens.isNumeric2 ? F_Numeric2 : 0));
+		m_Locs[a_line] = a_loc;
+		m_Values1[a_line] = a_tokens.value1;
+		m_Values2[a_line] = a_tokens.value2;
+		m_Operand1Starts[a_line] = a_tokens.operand1Start;
+		m_Operand1Lengths[a_line] = a_tokens.operand1Length;
+		m_Operand2Starts[a_line] = a_tokens.operand2Start;
+		m_Operand2Lengths[a_line] = a_tokens.operand2Length;
+	}
+
+	// Get the parsed fields of a line.
+	inline Instruction::Tokens Load(size_t a_line) const {
+		Instruction::Tokens tokens;
+		tokens.opCode = (Instruction::SymbolicOpCode)m_OpCodes[a_line];
+		tokens.formatError = (m_Flags[a_line] & F_FormatError) != 0;
+		tokens.isNumeric1 = (m_Flags[a_line] & F_Numeric1) != 0;
+		tokens.isNumeric2 = (m_Flags[a_line] & F_Numeric2) != 0;
+		tokens.value1 = m_Values1[a_line];
+		tokens.value2 = m_Values2[a_line];
+		tokens.operand1Start = m_Operand1Starts[a_line];
+		tokens.operand1Length = m_Operand1Lengths[a_line];
+		tokens.operand2Start = m_Operand2Starts[a_line];
+		tokens.operand2Length = m_Operand2Lengths[a_line];
+		return tokens;
+	}
+
+	// Get the op code of a line.
+	inline Instruction::SymbolicOpCode GetOpCode(size_t a_line) const {
+		return (Instruction::SymbolicOpCode)m_OpCodes[a_line];
+	}
+
+	// Get the location of a line.
+	inline int GetLocation(size_t a_line) const {
+		return m_Locs[a_line];
+	}
+
+	// Add an amount to the locations of a range of lines, once the location they are relative to is known.
+	inline void OffsetLocations(size_t a_first, size_t a_last, int a_offset) {
+		for (size_t i = a_first; i < a_last; i++) m_Locs[i] += a_offset;
+	}
+
+private:
+
+	// Replace a_oldCount elements of a field from a_first on with a_newCount empty ones.
+	template <typename T>
+	static void Splice(vector<T> &a_field, size_t a_first, size_t a_oldCount, size_t a_newCount) {
+		size_t common = min(a_oldCount, a_newCount);
+		if (a_oldCount > common) {
+			a_field.erase(a_field.begin() + a_first + common, a_field.begin() + a_first + a_oldCount);
+		}
+		else {
+			a_field.insert(a_field.begin() + a_first + common, a_newCount - common, T());
+		}
+	}
+
+	// The flag bits of a line.
+	enum : unsigned char {
+		F_FormatError = 1,		// The line has extra fields.
+		F_Numeric1 = 2,			// Operand 1 is a number.
+		F_Numeric2 = 4			// Operand 2 is a number.
+	};
+
+	vector<unsigned char> m_OpCodes;		// The op code of each line.
+	vector<unsigned char> m_Flags;			// The flags of each line.
+	vector<int> m_Locs;						// The location of each line.
+	vector<int> m_Values1;					// The value of operand 1 of each line.
+	vector<int> m_Values2;					// The value of operand 2 of each line.
+	vector<unsigned> m_Operand1Starts;		// The offset of operand 1 in each line.
+	vector<unsigned> m_Operand1Lengths;		// The length of operand 1 of each line.
+	vector<unsigned> m_Operand2Starts;		// The offset of operand 2 in each line.
+	vector<unsigned> m_Operand2Lengths;		// The length of operand 2 of each line.
+};
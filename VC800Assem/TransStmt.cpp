@@ -2,66 +2,125 @@
 
 #include "TransStmt.h"
 #include "Instruction.h"
+#include "Isa.h"
 
 /**/
 /*
 NAME
 
-	TransStmt::GetNumContents - returns the contents as long long (numeric format).
+	TransStmt::TransStmt - constructs a translated statement.
 
 SYNOPSIS
 
-	long long TransStmt::GetNumContents( );
+	TransStmt::TransStmt(Instruction::SymbolicOpCode a_oc, int a_loc, size_t a_line, int a_reg1, int a_reg2,
+		int a_addr, int a_val, unsigned char a_errorFlags);
+		a_oc			--> the op code of the statement.
+		a_loc			--> the location of the statement.
+		a_line			--> the index of the line of the original statement.
+		a_reg1			--> the first register, or -1.
+		a_reg2			--> the second register, or -1.
+		a_addr			--> the address, or -1 if it is not known yet.
+		a_val			--> the constant value, or -1.
+		a_errorFlags	--> the parts of the statement that have errors.
 
 DESCRIPTION
 
-	This function gets the contents of this translated statement as pure machine code.
-	It takes the string format of contents, which may include '?' characters to indicate
-	errors, and converts it into numeric format for use in emulation.
+	This function records the statement and encodes its machine word.
 
 RETURN
 
-	This function returns the machine code for this statement, or -1 if this statement
-	has an error.
+	This function does not return any value.
 
 */
 /**/
-long long 
-TransStmt::GetNumContents() const {
+TransStmt::TransStmt(Instruction::SymbolicOpCode a_oc, int a_loc, size_t a_line, int a_reg1, int a_reg2,
+	int a_addr, int a_val, unsigned char a_errorFlags)
+	: m_Loc(a_loc), m_Line((unsigned)a_line), m_OpCode((unsigned char)a_oc), m_Flags(a_errorFlags),
+	m_Reg1((signed char)((a_errorFlags & F_InvalidReg1) ? 0 : a_reg1))
+{
+	Encode(a_reg2, a_addr, a_val);
+}
+/* TransStmt::TransStmt(Instruction::SymbolicOpCode a_oc, int a_loc, size_t a_line, int a_reg1, int a_reg2, int a_addr, int a_val, unsigned char a_errorFlags) */
 
-	// Get the contents as a string.
-	string str = m_Contents.GetContents();
+/**/
+/*
+NAME
 
-	// If empty, the contents should be 0.
-	if (str.empty()) return 0;
+	TransStmt::Encode - encodes the machine word of the statement.
 
-	// Look for ? characters. If any exist, this indicates an error, so return -1.
-	// Note: Could also return -1 if this was a defined constant, but this would not
-	// be used as an instruction, so it's not a problem.
-	size_t foundErr = str.find('?');
-	if (foundErr != string::npos) return -1;
+SYNOPSIS
+
+	void TransStmt::Encode(int a_reg2, int a_addr, int a_val);
+		a_reg2		--> the second register, or -1.
+		a_addr		--> the address, or -1 if it is not known yet.
+		a_val		--> the constant value.
+
+DESCRIPTION
 
-	// Otherwise, convert the string to long long format.
-	else return stoll(str);
+	This function sets the word to the number the digits of the listing's contents make, with each part
+	that has an error encoded as zeros.  The layout of each statement comes from its encoding in the
+	instruction set table: an op code of two digits and a register, followed by an address of six digits
+	or a second register and five zeros.  An address that does not fit in six digits takes as many as it
+	needs, and one that is not known yet takes none, just as the listing shows them.
+
+RETURN
+
+	This function does not return any value.
+
+*/
+/**/
+void TransStmt::Encode(int a_reg2, int a_addr, int a_val)
+{
+	m_Word = 0;
+	const Isa::OpDesc *op = Isa::ByOpCode(m_OpCode);
+	if (op == nullptr || (m_Flags & (F_InvalidOpCode | F_InvalidValue)) != 0) return;
+
+	// The op code and the first register.
+	long long word = m_OpCode * 10LL + m_Reg1;
+
+	switch (op->encoding) {
+
+		case Isa::Encoding::RegAddr:
+			if (m_Flags & F_InvalidAddr) a_addr = 0;
+			else if (a_addr < 0) break;
+			word *= 1'000'000;
+			for (int rest = a_addr / 1'000'000; rest > 0; rest /= 10) word *= 10;
+			word += a_addr;
+			break;
+
+		case Isa::Encoding::RegReg:
+			if (m_Flags & F_InvalidReg2) a_reg2 = 0;
+			else if (a_reg2 < 0) break;
+			word = word * 1'000'000 + a_reg2 * 100'000LL;
+			break;
+
+		case Isa::Encoding::Constant:
+			word = a_val;
+			break;
+
+		case Isa::Encoding::NoContents:
+			word = 0;
+			break;
+	}
+	m_Word = word;
 }
-/* bool TransStmt::GetNumContents() */
+/* void TransStmt::Encode(int a_reg2, int a_addr, int a_val) */
 
 /**/
 /*
 NAME
 
-	TransStmt::DisplayStatement - displays the current statement, along with any errors.
+	TransStmt::SetAddress - sets the address of the statement and marks it valid.
 
 SYNOPSIS
 
-	void TransStmt::DisplayStatement( );
+	void TransStmt::SetAddress(int a_addr);
+		a_addr		--> the address.
 
 DESCRIPTION
 
-	This function prints out the location, contents, and original statement for this
-	translated statement. All printed contents are formatted to fit tabularly within the
-	translation table. It concludes by immediately printing errors associated with the 
-	statement afterwards.
+	This function is used when a label that the statement refers to is defined after the statement was
+	translated.  The machine word is encoded again with the address.
 
 RETURN
 
@@ -69,88 +128,84 @@ RETURN
 
 */
 /**/
-void TransStmt::DisplayStatement() {
-
-	// In the cases where only the original statement should be printed.
-	if (m_pOrig) cout << left << setw(26) << "" << m_OrigStmt << endl;
-
-	// Otherwise, print the location, contents, and original statement.
-	else
-	{
-		// Get the contents of the instruction and add a blank space for alignment if necessary.
-		string content_string = m_Contents.GetContents();
-		if (content_string.size() > 0 && content_string[0] != '-') {
-			content_string = " " + content_string;
-		}
-		// Print the line.
-		cout << left
-			<< setw(10) << m_Loc
-			<< setw(16) << content_string
-			<< m_OrigStmt << endl;
-	}
-
-	// Print out any error messages directly after.
-	if (!m_ErrorMsg.empty()) cout << m_ErrorMsg;
-};
-/* void TransStmt::DisplayStatement() */
+void TransStmt::SetAddress(int a_addr)
+{
+	m_Flags &= ~F_InvalidAddr;
+	Encode(-1, a_addr, 0);
+}
+/* void TransStmt::SetAddress(int a_addr) */
 
 /**/
 /*
 NAME
 
-	TransStmt::Contents::GetContents - return the contents as one string (a sequence of decimal digits).
+	TransStmt::SetInvalidAddress - marks the address of the statement as invalid.
 
 SYNOPSIS
 
-	string TransStmt::Contents::GetContents( );
+	void TransStmt::SetInvalidAddress();
 
 DESCRIPTION
 
-	This function returns the contents in string format, as a sequence of decimal digits.
-	It handles cases where certain values are invalid by using '?' in place of the bad value.
-	It also ensures negative values are printed properly with the negative sign at the start
-	of the string.
+	This function is used when a label that the statement refers to turns out to be undefined or multiply
+	defined after the statement was translated.
 
 RETURN
 
-	This function returns the string representation of the contents.
+	This function does not return any value.
 
 */
 /**/
-string TransStmt::Contents::GetContents() const
+void TransStmt::SetInvalidAddress()
 {
-	ostringstream oss;		// String stream to add machine code to.
+	m_Flags |= F_InvalidAddr;
+	Encode(-1, 0, 0);
+}
+/* void TransStmt::SetInvalidAddress() */
 
-	// If the opcode or constant value is invalid, we cannot translate the instruction at all.
-	if (m_InvalidOpCode || m_InvalidValue) {
-		oss << "?????????";
-		return oss.str();
-	}
+/**/
+/*
+NAME
 
-	// If the operation defines a constant, output that value.
-	if (m_OpCode == Instruction::SymbolicOpCode::OC_DC) {
-		// Add the negative sign to the front if the constant is negative.
-		string negSign = (m_Val < 0) ? "-" : "";
-		oss << negSign << setw(9) << setfill('0') << abs(m_Val);
-	}
-	// If the operation can be converted to machine language:
-	if (m_OpCode <= Instruction::SymbolicOpCode::OC_HALT) {
-		// Add the opcode to the beginning
-		oss << setw(2) << setfill('0') << (int)m_OpCode;
-
-		// Add the register 1 value, or ? if it is invalid.
-		if (m_InvalidReg1) oss << "?";
-		else oss << m_Reg1;
-
-		// Add register 2 value if it exists, or ? if invalid.
-		if (m_InvalidReg2) oss << "?" << "00000";
-		else if (m_Reg2 >= 0) oss << m_Reg2 << "00000";
-
-		// Add the address value if it exists, or series of ? if invalid.
-		if (m_InvalidAddr) oss << "??????";
-		else if (m_Addr >= 0) oss << setw(6) << setfill('0') << m_Addr;
-	}
-	return oss.str();
+	TransStmt::GetNumContents - returns the contents as long long (numeric format).
+
+SYNOPSIS
+
+	long long TransStmt::GetNumContents( );
 
+DESCRIPTION
+
+	This function gets the contents of this translated statement as pure machine code, for use in
+	emulation.  A statement with an error in a part of its machine word cannot be run.
+
+RETURN
+
+	This function returns the machine code for this statement, 0 if it has no contents, or -1 if this
+	statement has an error.
+
+*/
+/**/
+long long 
+TransStmt::GetNumContents() const {
+
+	// If the opcode or constant value is invalid, none of the statement can be used.
+	if (m_Flags & (F_InvalidOpCode | F_InvalidValue)) return -1;
+
+	// Comments and statements that do not generate a word have no contents.
+	const Isa::OpDesc *op = Isa::ByOpCode(m_OpCode);
+	if (op == nullptr) return 0;
+
+	// Look for the parts with errors that the encoding uses.
+	switch (op->encoding) {
+		case Isa::Encoding::RegAddr:
+			if (m_Flags & (F_InvalidReg1 | F_InvalidAddr)) return -1;
+			break;
+		case Isa::Encoding::RegReg:
+			if (m_Flags & (F_InvalidReg1 | F_InvalidReg2)) return -1;
+			break;
+		default:
+			break;
+	}
+	return m_Word;
 }
-/* void TransStmt::Contents::GetContents() */
+/* bool TransStmt::GetNumContents() */
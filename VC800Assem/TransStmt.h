@@ -5,79 +5,83 @@
 
 #include "Instruction.h"
 
+// A translated statement.  It is kept small, since there is one for every line of the source: the machine
+// word the statement generates is encoded as soon as it is translated, the original statement is referred
+// to by its line number, and its diagnostics, if any, by where they are in the translation.  The text of
+// the listing is only formatted when the listing is written.
 class TransStmt {
 
 public:
 
-	// Constructor for a translated statement.
-	TransStmt
-	(Instruction::SymbolicOpCode a_oc, int a_loc, string a_origStmt, int a_reg1, int a_reg2, int a_addr, int a_val)
-		: m_Loc(a_loc), m_OrigStmt(a_origStmt), m_Contents(a_oc, a_reg1, a_reg2, a_addr, a_val)
-	{
-		// If the instruction is a comment or end statement, make sure only the original statement is printed.
-		if ((a_oc == Instruction::SymbolicOpCode::OC_COMM) || (a_oc == Instruction::SymbolicOpCode::OC_END))
-			m_pOrig = true;
-	}
+	// The parts of the machine word that have errors, which the listing shows as '?'.
+	enum : unsigned char {
+		F_InvalidOpCode = 1,		// The op code is invalid.
+		F_InvalidReg1 = 2,			// The first register is invalid.
+		F_InvalidReg2 = 4,			// The second register is invalid.
+		F_InvalidAddr = 8,			// The address label is invalid.
+		F_InvalidValue = 16			// The constant value is invalid.
+	};
+
+	// Constructor for a translated statement.  a_errorFlags says which parts of it have errors.
+	TransStmt(Instruction::SymbolicOpCode a_oc, int a_loc, size_t a_line, int a_reg1, int a_reg2, int a_addr,
+		int a_val, unsigned char a_errorFlags);
 
 	// Get the location of this instruction.
 	inline int GetLocation() const { return m_Loc; };
 
-	// Add an error message to this translated statement.
-	inline void SetErrorMsg(string a_error) {
-		m_ErrorMsg = a_error;
-	}
+	// Get the index of the line of the original statement.
+	inline size_t GetLine() const { return m_Line; };
 
-	// Set the error codes for each portion of the machine language instruction.
-	inline void SetErrorCodes(bool a_opcode, bool a_reg1, bool a_reg2, bool a_addr, bool a_val) {
-		m_Contents.SetErrorCodes(a_opcode, a_reg1, a_reg2, a_addr, a_val);
-	}
+	// Get the op code of this statement.
+	inline Instruction::SymbolicOpCode GetOpCode() const { return (Instruction::SymbolicOpCode)m_OpCode; };
+
+	// Get the flags for the parts of the machine word that have errors.
+	inline unsigned char GetErrorFlags() const { return m_Flags; };
+
+	// Get the encoded machine word.  The parts with errors are encoded as zeros.
+	inline long long GetWord() const { return m_Word; };
+
+	// Get the index of the statement's first diagnostic in the translation.
+	inline int GetFirstDiagnostic() const { return m_FirstDiag; };
+
+	// Get the number of diagnostics the statement has.
+	inline int GetDiagnosticCount() const { return m_DiagCount; };
+
+	// Set where the statement's diagnostics are in the translation.
+	inline void SetDiagnostics(int a_first, int a_count) {
+		m_FirstDiag = a_first;
+		m_DiagCount = (unsigned char)a_count;
+	};
+
+	// Set the index of the line of the original statement, once lines before it are added or removed.
+	inline void SetLine(size_t a_line) { m_Line = (unsigned)a_line; };
+
+	// Set the address, once a label referred to before its definition is resolved.
+	void SetAddress(int a_addr);
+
+	// Mark the address as invalid.
+	void SetInvalidAddress();
 
 	// Return the contents as long long (numeric format).
 	long long GetNumContents() const;
 
-	// Display this translated line, along with any errors.
-	void DisplayStatement();
-
-	// Nested "contents" class for the actual machine code contents.
-	class Contents {
-	
-	public:
-
-		// Constructor for contents.
-		Contents(Instruction::SymbolicOpCode oc, int reg1, int reg2, int addr, int val)
-			: m_OpCode(oc), m_Reg1(reg1), m_Reg2(reg2), m_Addr(addr), m_Val(val) {}
-
-		// Set the error codes for each portion of the machine language instruction.
-		inline void SetErrorCodes(bool a_opcode, bool a_reg1, bool a_reg2, bool a_addr, bool a_val) {
-			m_InvalidOpCode = a_opcode;
-			m_InvalidReg1 = a_reg1;
-			m_InvalidReg2 = a_reg2;
-			m_InvalidAddr = a_addr;
-			m_InvalidValue = a_val;
-		}
-
-		// Return the contents as one string (a sequence of decimal digits).
-		string GetContents() const;
-
-	private:
-		Instruction::SymbolicOpCode m_OpCode;		// The OpCode of the instruction.
-		int m_Reg1 = 0;								// The first register.
-		int m_Reg2 = -1;							// The second register.
-		int m_Addr = -1;							// The address of the instruction.
-		int m_Val = -1;								// The value stored at this memory location.
-
-		// Flags for invalid values.
-		bool m_InvalidOpCode = false;       // == true if the opcode is invalid.
-		bool m_InvalidReg1 = false;         // == true if the first register value is invalid.
-		bool m_InvalidReg2 = false;         // == true if the second register value is invalid.
-		bool m_InvalidAddr = false;         // == true if the address label is invalid.
-		bool m_InvalidValue = false;        // == true if the constant value is invalid.
-	};
+	// Return true if only the original statement is listed, for comments and end statements.
+	inline bool IsOriginalOnly() const {
+		return m_OpCode == (unsigned char)Instruction::SymbolicOpCode::OC_COMM
+			|| m_OpCode == (unsigned char)Instruction::SymbolicOpCode::OC_END;
+	}
 
 private:
-	int m_Loc = 0;			// The location of the instruction.
-	Contents m_Contents;	// The machine code contents of this statement.
-	string m_OrigStmt;		// The original, untranslated assembly code.
-	bool m_pOrig = false;	// Boolean that tracks whether to print only the original statement (for "End" or comments).
-	string m_ErrorMsg;		// String that contains error messages associated with this statement.
+
+	// Encode the machine word from its parts.
+	void Encode(int a_reg2, int a_addr, int a_val);
+
+	long long m_Word = 0;		// The machine word, as the decimal digits of the listing read as a number.
+	int m_Loc = 0;				// The location of the instruction.
+	unsigned m_Line = 0;		// The index of the line of the original statement.
+	int m_FirstDiag = 0;		// The index of the statement's first diagnostic in the translation.
+	unsigned char m_OpCode;		// The op code of the instruction.
+	unsigned char m_Flags;		// The parts of the machine word that have errors.
+	signed char m_Reg1;			// The first register, kept so that the word can be encoded again.
+	unsigned char m_DiagCount = 0;	// The number of diagnostics the statement has.
 };
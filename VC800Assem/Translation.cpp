@@ -1,3 +1,450 @@
 #include "stdafx.h"
 
-#include "Translation.h"
\ No newline at end of file
+#include "Translation.h"
+#include "Isa.h"
+#include "ListingWriter.h"
+#include "ThreadPool.h"
+
+/**/
+/*
+NAME
+
+	FormatContents - formats the contents of a statement for the listing.
+
+SYNOPSIS
+
+	static size_t FormatContents(const TransStmt &a_stmt, char *a_out);
+		a_stmt		--> the statement.
+		a_out		<-- where the contents are put.  It must have room for MaxContentsLength characters.
+
+DESCRIPTION
+
+	This function turns the machine word of a statement back into the sequence of decimal digits the
+	listing shows.  The layout of each statement comes from its encoding in the instruction set table.
+	The parts of the word that have errors are shown as '?'.  A constant shows at least nine digits, with
+	the negative sign at the start of the string.  An instruction shows its word with the leading zero of
+	an op code below 10, which gives nine digits unless its address is out of the usual range.
+
+RETURN
+
+	This function returns the number of characters, or 0 if the statement has no contents.
+
+*/
+/**/
+static const size_t MaxContentsLength = ListingWriter::MaxIntegerLength + 1;
+static size_t FormatContents(const TransStmt &a_stmt, char *a_out)
+{
+	unsigned char flags = a_stmt.GetErrorFlags();
+
+	// If the opcode or constant value is invalid, we cannot translate the instruction at all.
+	if (flags & (TransStmt::F_InvalidOpCode | TransStmt::F_InvalidValue)) {
+		memset(a_out, '?', 9);
+		return 9;
+	}
+
+	// Comments and statements that do not generate a word have no contents.
+	const Isa::OpDesc *op = Isa::ByOpCode(a_stmt.GetOpCode());
+	if (op == nullptr || op->encoding == Isa::Encoding::NoContents) return 0;
+
+	// If the operation defines a constant, output that value with at least nine digits after the sign.
+	long long word = a_stmt.GetWord();
+	if (op->encoding == Isa::Encoding::Constant) {
+		char digits[ListingWriter::MaxIntegerLength];
+		size_t count = ListingWriter::FormatInteger(word < 0 ? -word : word, digits);
+		size_t length = 0;
+		if (word < 0) a_out[length++] = '-';
+		for (; count + length < 9 + (word < 0); length++) a_out[length] = '0';
+		memcpy(a_out + length, digits, count);
+		return length + count;
+	}
+
+	// Otherwise it is machine language.  Only the op code can have a leading zero.
+	size_t length = 0;
+	if ((int)a_stmt.GetOpCode() < 10) a_out[length++] = '0';
+	length += ListingWriter::FormatInteger(word, a_out + length);
+
+	// Mark the registers and the address that have errors.  An address with an error always shows six
+	// '?', even when the word has no digits for it.
+	if (flags & TransStmt::F_InvalidReg1) a_out[2] = '?';
+	if (op->encoding == Isa::Encoding::RegReg) {
+		if (flags & TransStmt::F_InvalidReg2) a_out[3] = '?';
+	}
+	else if (flags & TransStmt::F_InvalidAddr) {
+		memset(a_out + 3, '?', 6);
+		length = max<size_t>(length, 9);
+	}
+	return length;
+}
+/* static size_t FormatContents(const TransStmt &a_stmt, char *a_out) */
+
+/**/
+/*
+NAME
+
+	Translation::DisplayTranslation - displays all translated lines.
+
+SYNOPSIS
+
+	void Translation::DisplayTranslation(ListingWriter &a_out, const FileAccess &a_facc, size_t a_maxErrors) const;
+		a_out		--> the listing to write the lines to.
+		a_facc		--> the source file, which holds the original statements.
+		a_maxErrors	--> the most diagnostics to list, or 0 to list them all.
+
+DESCRIPTION
+
+	This function prints out the location, contents, and original statement for each translated
+	statement. All printed contents are formatted to fit tabularly within the translation table.
+	The errors associated with a statement are printed immediately after it.  Comments and end
+	statements only show the original statement.
+
+	Once a_maxErrors errors have been listed, the rest are only counted, and the number left out is
+	printed after the table.
+
+	A long translation is formatted in chunks on the shared thread pool.  Each chunk is formatted into
+	a listing of its own in memory, starting from the number of errors the chunks before it list, which
+	a first pass counts.  The chunks are formatted a few per thread at a time, and each group is written
+	out in order before the next is formatted, so only a few chunks are ever held in memory.
+
+RETURN
+
+	This function does not return any value.
+
+*/
+/**/
+void Translation::DisplayTranslation(ListingWriter &a_out, const FileAccess &a_facc, size_t a_maxErrors) const
+{
+	DisplayHeader(a_out);
+
+	// The original statement of a statement is the line it came from.
+	auto getLine = [&a_facc, this](size_t a_stmt) { return a_facc.GetLine(m_Stmts[a_stmt].GetLine()); };
+
+	ThreadPool &pool = ThreadPool::Shared();
+	size_t chunkCount = (m_Stmts.size() + ChunkStatements - 1) / ChunkStatements;
+	size_t errorCount = 0;
+
+	// A short translation, or one with a single thread to format it, is formatted straight into the listing.
+	if (chunkCount <= 1 || pool.GetThreadCount() == 1) {
+		errorCount = FormatStatements(a_out, getLine, 0, m_Stmts.size(), 0, a_maxErrors);
+	}
+	else {
+		// Count the errors in each chunk, then turn the counts into the number before each chunk.
+		vector<size_t> errorsBefore(chunkCount + 1, 0);
+		pool.ParallelFor(chunkCount, [&](size_t a_chunk, unsigned) {
+			size_t last = min(m_Stmts.size(), (a_chunk + 1) * ChunkStatements);
+			size_t count = 0;
+			for (size_t i = a_chunk * ChunkStatements; i < last; i++) count += m_Stmts[i].GetDiagnosticCount();
+			errorsBefore[a_chunk + 1] = count;
+		});
+		for (size_t chunk = 0; chunk < chunkCount; chunk++) errorsBefore[chunk + 1] += errorsBefore[chunk];
+		errorCount = errorsBefore[chunkCount];
+
+		// Format the chunks a group at a time, each into its own listing, and write each group out in order.
+		vector<ListingWriter> parts(2 * pool.GetThreadCount());
+		for (size_t first = 0; first < chunkCount; first += parts.size()) {
+			size_t count = min(parts.size(), chunkCount - first);
+			pool.ParallelFor(count, [&](size_t a_part, unsigned) {
+				size_t chunk = first + a_part;
+				parts[a_part].Clear();
+				FormatStatements(parts[a_part], getLine, chunk * ChunkStatements,
+					min(m_Stmts.size(), (chunk + 1) * ChunkStatements), errorsBefore[chunk], a_maxErrors);
+			});
+			a_out.WriteInOrder(parts.data(), count);
+		}
+	}
+
+	DisplayOmitted(a_out, errorCount, a_maxErrors);
+}
+/* void Translation::DisplayTranslation(ListingWriter &a_out, const FileAccess &a_facc, size_t a_maxErrors) const */
+
+// Display the heading of the listing.
+void Translation::DisplayHeader(ListingWriter &a_out)
+{
+	a_out.WriteLeft("Location", 11);
+	a_out.WriteLeft("Contents", 15);
+	a_out.Write("Original Statement");
+	a_out.EndLine();
+}
+
+/**/
+/*
+NAME
+
+	Translation::DisplayStatements - displays the translated lines, for a listing written a part at a time.
+
+SYNOPSIS
+
+	size_t Translation::DisplayStatements(ListingWriter &a_out, const string_view *a_lines, size_t a_errorsBefore,
+		size_t a_maxErrors) const;
+		a_out			--> the listing to write the lines to.
+		a_lines			--> the original statement of each translated statement, in order.
+		a_errorsBefore	--> the number of errors listed or left out of the parts of the listing before this one.
+		a_maxErrors		--> the most diagnostics to list in the whole listing, or 0 to list them all.
+
+DESCRIPTION
+
+	This function writes the lines of all the statements as DisplayTranslation does, but without the heading
+	or the number of errors left out, so that a translation can be listed and cleared a batch of statements
+	at a time.  The original statements are given by the caller, so that the source need not keep the
+	start of every line.
+
+RETURN
+
+	This function returns the number of errors of the statements, listed or not.
+
+*/
+/**/
+size_t Translation::DisplayStatements(ListingWriter &a_out, const string_view *a_lines, size_t a_errorsBefore,
+	size_t a_maxErrors) const
+{
+	return FormatStatements(a_out, [a_lines](size_t a_stmt) { return a_lines[a_stmt]; }, 0, m_Stmts.size(),
+		a_errorsBefore, a_maxErrors);
+}
+/* size_t Translation::DisplayStatements(ListingWriter &a_out, const string_view *a_lines, size_t a_errorsBefore, size_t a_maxErrors) const */
+
+// Display the number of errors left out of a listing, if any were.
+void Translation::DisplayOmitted(ListingWriter &a_out, size_t a_errorCount, size_t a_maxErrors)
+{
+	if (a_maxErrors != 0 && a_errorCount > a_maxErrors) {
+		a_out.WriteLeft((long long)(a_errorCount - a_maxErrors), 0);
+		a_out.Write(" more errors were not listed.");
+		a_out.EndLine();
+	}
+}
+
+/**/
+/*
+NAME
+
+	Translation::FormatStatements - formats the listing of a range of statements.
+
+SYNOPSIS
+
+	template <typename GetLine>
+	size_t Translation::FormatStatements(ListingWriter &a_out, GetLine a_getLine, size_t a_first,
+		size_t a_last, size_t a_errorsBefore, size_t a_maxErrors) const;
+		a_out			--> the listing to write the lines to.
+		a_getLine		--> gives the original statement of a statement from its index.
+		a_first			--> the index of the first statement.
+		a_last			--> the index of the statement after the last one.
+		a_errorsBefore	--> the number of errors of the statements before a_first.
+		a_maxErrors		--> the most diagnostics to list, or 0 to list them all.
+
+DESCRIPTION
+
+	This function writes the lines of the statements, each followed by its errors, for DisplayTranslation
+	and DisplayStatements.
+	It only reads the translation and the source, so ranges can be formatted on several threads at once.
+
+RETURN
+
+	This function returns the number of errors of the statements, listed or not.
+
+*/
+/**/
+template <typename GetLine>
+size_t Translation::FormatStatements(ListingWriter &a_out, GetLine a_getLine, size_t a_first,
+	size_t a_last, size_t a_errorsBefore, size_t a_maxErrors) const
+{
+	size_t errors = a_errorsBefore;		// The number of errors so far, listed or not.
+
+	for (size_t istmt = a_first; istmt < a_last; istmt++) {
+		const TransStmt &stmt = m_Stmts[istmt];
+
+		// In the cases where only the original statement should be printed.
+		if (stmt.IsOriginalOnly()) a_out.WriteSpaces(26);
+
+		// Otherwise, print the location and contents before the original statement.
+		else
+		{
+			// Get the contents of the instruction, after a blank space for alignment if necessary.
+			char contents[MaxContentsLength + 1];
+			size_t length = FormatContents(stmt, contents + 1);
+			bool pad = length > 0 && contents[1] != '-';
+			if (pad) contents[0] = ' ';
+
+			a_out.WriteLeft(stmt.GetLocation(), 10);
+			a_out.WriteLeft(string_view(contents + !pad, length + pad), 16);
+		}
+		a_out.Write(a_getLine(istmt));
+		a_out.EndLine();
+
+		// Print out any error messages directly after, up to the limit.
+		for (int i = 0; i < stmt.GetDiagnosticCount(); i++, errors++) {
+			if (a_maxErrors != 0 && errors >= a_maxErrors) continue;
+			Diagnostics::Render(a_out, m_Diags[stmt.GetFirstDiagnostic() + i]);
+			a_out.EndLine();
+		}
+	}
+	return errors - a_errorsBefore;
+}
+/* size_t Translation::FormatStatements(ListingWriter &a_out, GetLine a_getLine, size_t a_first, size_t a_last, size_t a_errorsBefore, size_t a_maxErrors) const */
+
+/**/
+/*
+NAME
+
+	Translation::AddStatements - adds the statements of another translation to this one.
+
+SYNOPSIS
+
+	void Translation::AddStatements(Translation &a_trans);
+		a_trans		--> the translation whose statements are added.  It is left empty, with its memory released.
+
+DESCRIPTION
+
+	This function is used to put together a translation made in chunks.  The statements are added in
+	order with their diagnostics, so the statements are changed to say where their diagnostics now are.
+
+RETURN
+
+	This function does not return any value.
+
+*/
+/**/
+void Translation::AddStatements(Translation &a_trans)
+{
+	int firstDiag = (int)m_Diags.size();
+	for (TransStmt &stmt : a_trans.m_Stmts) {
+		stmt.SetDiagnostics(firstDiag + stmt.GetFirstDiagnostic(), stmt.GetDiagnosticCount());
+	}
+	m_Stmts.insert(m_Stmts.end(), a_trans.m_Stmts.begin(), a_trans.m_Stmts.end());
+	m_Diags.insert(m_Diags.end(), a_trans.m_Diags.begin(), a_trans.m_Diags.end());
+	a_trans = Translation();
+}
+/* void Translation::AddStatements(Translation &a_trans) */
+
+// Add a copy of a statement of another translation, with its diagnostics, as the statement of a line.
+void Translation::CopyStatement(const Translation &a_trans, size_t a_stmt, size_t a_line)
+{
+	TransStmt stmt = a_trans.m_Stmts[a_stmt];
+	int first = stmt.GetFirstDiagnostic(), count = stmt.GetDiagnosticCount();
+	stmt.SetLine(a_line);
+	stmt.SetDiagnostics((int)m_Diags.size(), count);
+	m_Stmts.push_back(stmt);
+	for (int i = 0; i < count; i++) {
+		m_Diags.push_back(a_trans.m_Diags[first + i]);
+		m_Diags.back().line = (unsigned)a_line;
+	}
+}
+
+/**/
+/*
+NAME
+
+	Translation::AddDiagnostics - adds diagnostics to the latest translated statement.
+
+SYNOPSIS
+
+	void Translation::AddDiagnostics(const DiagnosticBuffer &a_diags);
+		a_diags		--> the diagnostics recorded while the statement was translated.
+
+DESCRIPTION
+
+	This function adds the diagnostics to the end of those of the translation, with the line of the
+	statement, and records where they are in the statement.  It is called once for each statement,
+	straight after the statement is added.
+
+RETURN
+
+	This function does not return any value.
+
+*/
+/**/
+void Translation::AddDiagnostics(const DiagnosticBuffer &a_diags)
+{
+	if (a_diags.GetCount() == 0) return;
+
+	TransStmt &lastStatement = m_Stmts.back();
+	lastStatement.SetDiagnostics((int)m_Diags.size(), a_diags.GetCount());
+	for (int i = 0; i < a_diags.GetCount(); i++) {
+		m_Diags.push_back(a_diags.Get(i));
+		m_Diags.back().line = (unsigned)lastStatement.GetLine();
+	}
+}
+/* void Translation::AddDiagnostics(const DiagnosticBuffer &a_diags) */
+
+/**/
+/*
+NAME
+
+	Translation::InvalidateAddress - marks the address of a statement as invalid and records the error.
+
+SYNOPSIS
+
+	void Translation::InvalidateAddress(size_t a_stmt, int a_diagIndex, const Diagnostic &a_diag);
+		a_stmt		--> the index of the statement.
+		a_diagIndex	--> the position among the statement's diagnostics to insert the new one at.
+		a_diag		--> the diagnostic, whose code and span are used.
+
+DESCRIPTION
+
+	This function is used when a label that the statement refers to turns out to be undefined or
+	multiply defined after the statement was translated.  The diagnostic is inserted where it would
+	have been recorded had the label been looked up during translation, so that the listing is the
+	same.  If the statement's diagnostics are not the last in the translation, they are moved to the
+	end first, which leaves their old place unused.
+
+RETURN
+
+	This function does not return any value.
+
+*/
+/**/
+void Translation::InvalidateAddress(size_t a_stmt, int a_diagIndex, const Diagnostic &a_diag)
+{
+	TransStmt &stmt = m_Stmts[a_stmt];
+	stmt.SetInvalidAddress();
+
+	int first = stmt.GetFirstDiagnostic();
+	int count = stmt.GetDiagnosticCount();
+	if (count == 0 || first + count != (int)m_Diags.size()) {
+		int moved = (int)m_Diags.size();
+		for (int i = 0; i < count; i++) m_Diags.push_back(m_Diags[first + i]);
+		first = moved;
+	}
+	Diagnostic diag = a_diag;
+	diag.line = (unsigned)stmt.GetLine();
+	m_Diags.insert(m_Diags.begin() + first + min(a_diagIndex, count), diag);
+	stmt.SetDiagnostics(first, count + 1);
+}
+/* void Translation::InvalidateAddress(size_t a_stmt, int a_diagIndex, const Diagnostic &a_diag) */
+
+// Get the number of diagnostics of all the statements.  Some of the diagnostics kept may have been moved,
+// so they are counted by statement.
+size_t Translation::GetDiagnosticCount() const
+{
+	size_t count = 0;
+	for (const TransStmt &stmt : m_Stmts) count += stmt.GetDiagnosticCount();
+	return count;
+}
+
+/**/
+/*
+NAME
+
+	Translation::GetDiagnostics - gets the diagnostics of all the statements.
+
+SYNOPSIS
+
+	vector<Diagnostic> Translation::GetDiagnostics() const;
+
+DESCRIPTION
+
+	This function collects the diagnostics of the statements in the order the listing shows them.
+
+RETURN
+
+	This function returns the diagnostics.
+
+*/
+/**/
+vector<Diagnostic> Translation::GetDiagnostics() const
+{
+	vector<Diagnostic> diags;
+	for (const TransStmt &stmt : m_Stmts) {
+		diags.insert(diags.end(), m_Diags.begin() + stmt.GetFirstDiagnostic(),
+			m_Diags.begin() + stmt.GetFirstDiagnostic() + stmt.GetDiagnosticCount());
+	}
+	return diags;
+}
+/* vector<Diagnostic> Translation::GetDiagnostics() const */
@@ -4,39 +4,96 @@
 #pragma once
 
 #include "TransStmt.h"
+#include "FileAccess.h"
+#include "Diagnostics.h"
+#include "ListingWriter.h"
 
 class Translation {
 
 public:
 
-	// Display all translated lines.
-	inline void DisplayTranslation() const {
-		// Print header
-		cout << left << setw(11) << "Location" << setw(15) << "Contents" << "Original Statement" << endl;
+	// Display all translated lines, with the original statements from the source file.  At most
+	// a_maxErrors diagnostics are listed, if it is not zero.
+	void DisplayTranslation(ListingWriter &a_out, const FileAccess &a_facc, size_t a_maxErrors) const;
 
-		// Display each line of the translation.
-		for (TransStmt stmt : m_Stmts) {
-			stmt.DisplayStatement();
-		}
-	};
+	// Display the heading of the listing.
+	static void DisplayHeader(ListingWriter &a_out);
+
+	// Display the translated lines without the heading, for a listing written a part at a time.  The
+	// original statement of statement i is a_lines[i], and its errors follow a_errorsBefore others.  Returns
+	// the number of errors of the statements, listed or not.
+	size_t DisplayStatements(ListingWriter &a_out, const string_view *a_lines, size_t a_errorsBefore,
+		size_t a_maxErrors) const;
+
+	// Display the number of errors left out of a listing, if any were.
+	static void DisplayOmitted(ListingWriter &a_out, size_t a_errorCount, size_t a_maxErrors);
 
 	// Add a new translated statement to the vector.
-	inline void AddStatement(TransStmt a_stmt) {
+	inline void AddStatement(const TransStmt &a_stmt) {
 		m_Stmts.push_back(a_stmt);
 	}
 
+	// Add the statements of another translation to the end of this one, in order, with their diagnostics.
+	// The other translation is left empty, with its memory released.
+	void AddStatements(Translation &a_trans);
+
+	// Remove all the statements and their diagnostics, keeping the memory for the next ones.
+	inline void Clear() {
+		m_Stmts.clear();
+		m_Diags.clear();
+	}
+
+	// Make room for a number of statements.
+	inline void Reserve(size_t a_count) {
+		m_Stmts.reserve(a_count);
+	}
+
 	// Get the vector of translated statements.
 	inline const vector<TransStmt>& GetStatements() const {
 		return m_Stmts;
 	}
 
-	// Add an error message to the latest translated statement.
-	inline void AddError(string a_error) {
-		TransStmt &lastStatement = m_Stmts.back();
-		lastStatement.SetErrorMsg(a_error);
+	// Get a translated statement so that it can be patched.
+	inline TransStmt &GetStatement(size_t a_index) {
+		return m_Stmts[a_index];
+	}
+
+	// Get the number of translated statements.
+	inline size_t GetStatementCount() const {
+		return m_Stmts.size();
 	}
 
+	// Add a copy of a statement of another translation, with its diagnostics, as the statement of line a_line,
+	// so that a statement that has not changed need not be translated again.
+	void CopyStatement(const Translation &a_trans, size_t a_stmt, size_t a_line);
+
+	// Add the diagnostics recorded for the latest translated statement.
+	void AddDiagnostics(const DiagnosticBuffer &a_diags);
+
+	// Mark the address of a statement as invalid and insert the diagnostic explaining why among its
+	// diagnostics.  Only the code and span of a_diag are used.
+	void InvalidateAddress(size_t a_stmt, int a_diagIndex, const Diagnostic &a_diag);
+
+	// Get the number of diagnostics of all the statements.
+	size_t GetDiagnosticCount() const;
+
+	// Get the diagnostics of all the statements, in the order of the statements.
+	vector<Diagnostic> GetDiagnostics() const;
+
 private:
+	// The number of statements in each chunk of the listing that is formatted on its own.
+	static const size_t ChunkStatements = 8192;
+
+	// Format the listing of the statements from a_first up to a_last, whose errors follow a_errorsBefore
+	// others, and return the number of errors they have.  a_getLine(i) gives the original statement of
+	// statement i.
+	template <typename GetLine>
+	size_t FormatStatements(ListingWriter &a_out, GetLine a_getLine, size_t a_first, size_t a_last,
+		size_t a_errorsBefore, size_t a_maxErrors) const;
+
 	// Vector to hold all of the translated statements, in order.
 	vector<TransStmt> m_Stmts;
-};
\ No newline at end of file
+
+	// The diagnostics of the statements.  Those of each statement are together, where the statement says.
+	vector<Diagnostic> m_Diags;
+};
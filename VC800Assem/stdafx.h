@@ -16,6 +16,7 @@
 #include <sstream>
 #include <stdlib.h>
 #include <string>
+#include <string_view>
 #include <windows.h>
 #include <map>
 #include <vector>